@@ -0,0 +1,132 @@
+#include "analysisworker.h"
+#include "parser.h"
+#include "semantics.h"
+#include "tokenstream.h"
+
+AnalysisWorker::AnalysisWorker(QObject *parent) : QObject(parent), context(new QObject) {
+    context->moveToThread(&thread);
+    connect(&thread, &QThread::finished, context, &QObject::deleteLater);
+    thread.start();
+}
+
+AnalysisWorker::~AnalysisWorker() {
+    cancel();
+    thread.quit();
+    thread.wait();
+}
+
+quint64 AnalysisWorker::submit(AnalysisResult::Kind kind, const QString &text) {
+    cancel();
+    current = std::make_shared<std::atomic<bool>>(false);
+    currentKind = kind;
+    currentText = text;
+
+    auto result = std::make_shared<AnalysisResult>();
+    result->kind = kind;
+    result->generation = ++generation;
+
+    // Queued jobs that were superseded before they started see their flag set and return at once
+    std::shared_ptr<std::atomic<bool>> cancelled = current;
+    QString output = tokenOutput;
+    TokenFormat format = tokenFormat;
+    QMetaObject::invokeMethod(context, [this, result, text, output, format, cancelled] {
+        run(result, text, output, format, cancelled);
+    }, Qt::QueuedConnection);
+    return result->generation;
+}
+
+void AnalysisWorker::setTokenOutput(const QString &path, TokenFormat format) {
+    tokenOutput = path;
+    tokenFormat = format;
+}
+
+void AnalysisWorker::cancel() {
+    if (current) {
+        current->store(true);
+        current.reset();
+        currentText.clear();
+    }
+}
+
+bool AnalysisWorker::isPending(AnalysisResult::Kind kind, const QString &text) const {
+    return current && currentKind == kind && currentText == text;
+}
+
+// Runs on the worker thread
+void AnalysisWorker::run(std::shared_ptr<AnalysisResult> result, QString text,
+                         QString output, TokenFormat format,
+                         std::shared_ptr<std::atomic<bool>> cancelled) {
+    if (*cancelled) {
+        return;
+    }
+
+    try {
+        // Both jobs work on the UTF-8 bytes; diagnostics and token offsets are byte offsets
+        result->source = text.toUtf8();
+        result->diagnostics.setSource(result->source.constData(), result->source.size());
+
+        PipelineStats &stats = result->stats;
+        if (result->kind == AnalysisResult::Kind::Scan) {
+            PhaseTimer scanTimer(&stats, "scan");
+            QList<CompactToken> tokens = tokenizeCompact(result->source.constData(), result->source.size(),
+                                                         &result->diagnostics);
+            scanTimer.stop();
+            result->tokenCount = tokens.size();
+            stats.addTokens(tokens);
+            if (*cancelled) {
+                return;
+            }
+            PhaseTimer writeTimer(&stats, "write");
+            result->outputWritten = exportTokens(output, format, tokens, result->source.constData());
+        } else {
+            // Scan on demand; a cancelled parse sees the end of input and unwinds.
+            // The parse phase includes the scanning.
+            PhaseTimer parseTimer(&stats, "parse");
+            LexerTokenSource lexer(result->source.constData(), result->source.size(), &result->diagnostics);
+            CancellableTokenSource tokens(lexer, *cancelled);
+            Parser parser(tokens, result->arena);
+            parser.setStrategy(Parser::Strategy::ExplicitStack);
+            parser.setDiagnostics(&result->diagnostics);
+            FlatAst ast;
+            SymbolTable symbols;
+            parser.setSymbols(&symbols);
+            parser.parse(ast);
+            parseTimer.stop();
+            if (*cancelled) {
+                return;
+            }
+            stats.tokensScanned += parser.tokenCount();
+            stats.addAst(ast);
+
+            PhaseTimer checkTimer(&stats, "check");
+            checkUseBeforeAssign(ast, symbols, result->diagnostics); // Shown as warnings
+            checkTimer.stop();
+
+            PhaseTimer treeTimer(&stats, "tree");
+            result->tree = ast.toSyntaxTree(result->arena);
+            treeTimer.stop();
+            stats.addTree(result->arena);
+
+            // Lay the whole tree out here so the GUI thread only builds the scene
+            PhaseTimer layoutTimer(&stats, "layout");
+            result->layout.compute(result->tree, TreeLayout::DefaultXSpacing, TreeLayout::DefaultYSpacing);
+            layoutTimer.stop();
+            stats.addLayout(result->layout);
+        }
+    } catch (const std::exception &e) {
+        result->error = e.what();
+    }
+
+    if (*cancelled) {
+        return;
+    }
+
+    // Hand over on the GUI thread, unless a newer request came in meanwhile
+    QMetaObject::invokeMethod(this, [this, result, cancelled] {
+        if (!*cancelled) {
+            current.reset();
+            currentText.clear();
+            emit finished(result);
+        }
+    }, Qt::QueuedConnection);
+}
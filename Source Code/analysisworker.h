@@ -0,0 +1,68 @@
+#ifndef ANALYSISWORKER_H
+#define ANALYSISWORKER_H
+
+#include "diagnostics.h"
+#include "pipelinestats.h"
+#include "tokenexport.h"
+#include "syntaxtree.h"
+#include "treelayout.h"
+#include <QObject>
+#include <QThread>
+#include <atomic>
+#include <memory>
+
+// Everything one scan or parse produced off the GUI thread. The GUI keeps the
+// result alive while the scene draws from its tree and layout.
+struct AnalysisResult {
+    enum class Kind { Scan, Parse };
+
+    Kind kind;
+    quint64 generation;     // Which request this answers
+    QByteArray source;      // UTF-8 input; diagnostics are byte offsets into it
+    Diagnostics diagnostics;
+    qsizetype tokenCount = 0;
+    bool outputWritten = false; // Scan: the token file was written
+    SyntaxTreeArena arena;
+    SyntaxTreeNode *tree = nullptr;
+    TreeLayout layout;
+    PipelineStats stats;    // The GUI adds the time it spends building the scene
+    QString error;          // Set if the job failed outright
+};
+
+// Runs scans and parses (including tree layout) on one background thread.
+// Only the newest request matters: submitting cancels the one in flight,
+// and finished() is only emitted, on the GUI thread, for a request that
+// wasn't superseded.
+class AnalysisWorker : public QObject {
+    Q_OBJECT
+
+public:
+    explicit AnalysisWorker(QObject *parent = nullptr);
+    ~AnalysisWorker();
+
+    quint64 submit(AnalysisResult::Kind kind, const QString &text);
+    void cancel();                          // Drop the current request, if any
+    bool isPending(AnalysisResult::Kind kind, const QString &text) const; // That request is in flight
+
+    // Where scans export their tokens ("-" for stdout); applies to later requests
+    void setTokenOutput(const QString &path, TokenFormat format);
+
+signals:
+    void finished(std::shared_ptr<AnalysisResult> result);
+
+private:
+    void run(std::shared_ptr<AnalysisResult> result, QString text,
+             QString output, TokenFormat format,
+             std::shared_ptr<std::atomic<bool>> cancelled);
+
+    QThread thread;
+    QObject *context;                       // Lives on thread; jobs are queued to it
+    quint64 generation = 0;
+    QString tokenOutput = "output.txt";
+    TokenFormat tokenFormat = TokenFormat::Text;
+    std::shared_ptr<std::atomic<bool>> current; // Cancel flag of the newest request
+    AnalysisResult::Kind currentKind = AnalysisResult::Kind::Scan;
+    QString currentText;                    // Input of the newest request while it is in flight
+};
+
+#endif // ANALYSISWORKER_H
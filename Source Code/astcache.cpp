@@ -0,0 +1,193 @@
+#include "astcache.h"
+#include <QCryptographicHash>
+#include <QDir>
+#include <QSaveFile>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+const char ImageMagic[8] = {'T', 'I', 'N', 'Y', 'A', 'S', 'T', 0};
+const quint32 ByteOrderMark = 0x01020304;
+
+// The operators the parser builds Op nodes for; display names index by them
+bool isBinaryOperator(TokenType op) {
+    switch (op) {
+    case TokenType::PLUS:
+    case TokenType::MINUS:
+    case TokenType::MULT:
+    case TokenType::DIV:
+    case TokenType::LESSTHAN:
+    case TokenType::EQUAL:
+        return true;
+    default:
+        return false;
+    }
+}
+
+template <class T>
+void appendRaw(QByteArray &out, const T *items, qsizetype count) {
+    out.append(reinterpret_cast<const char *>(items), count * qsizetype(sizeof(T)));
+}
+
+} // namespace
+
+QByteArray AstImage::build(const FlatAst &ast) {
+    QByteArray text;
+    QList<quint32> ends;
+    for (const StringInterner *table : {&ast.identifiers, &ast.literals}) {
+        for (qsizetype id = 0; id < table->size(); ++id) {
+            text.append(table->text(quint32(id)).toUtf8());
+            ends.append(quint32(text.size()));
+        }
+    }
+
+    Header header;
+    std::memcpy(header.magic, ImageMagic, sizeof(header.magic));
+    header.byteOrder = ByteOrderMark;
+    header.version = Version;
+    header.nodeCount = quint32(ast.nodes.size());
+    header.root = ast.root;
+    header.identifierCount = quint32(ast.identifiers.size());
+    header.literalCount = quint32(ast.literals.size());
+    header.textSize = quint32(text.size());
+    header.reserved = 0;
+
+    QByteArray image;
+    image.reserve(sizeof(Header) + ast.nodes.size() * sizeof(AstNode) + ends.size() * sizeof(quint32) + text.size());
+    appendRaw(image, &header, 1);
+    appendRaw(image, ast.nodes.constData(), ast.nodes.size());
+    appendRaw(image, ends.constData(), ends.size());
+    image.append(text);
+    return image;
+}
+
+bool AstImage::attach(const char *data, qsizetype size) {
+    header = nullptr;
+    if (size < qsizetype(sizeof(Header))) {
+        return false;
+    }
+    const Header *h = reinterpret_cast<const Header *>(data);
+    if (std::memcmp(h->magic, ImageMagic, sizeof(ImageMagic)) != 0 || h->byteOrder != ByteOrderMark
+        || h->version != Version) {
+        return false;
+    }
+    quint64 stringCount = quint64(h->identifierCount) + h->literalCount;
+    quint64 expected = sizeof(Header) + quint64(h->nodeCount) * sizeof(AstNode)
+                       + stringCount * sizeof(quint32) + h->textSize;
+    if (expected != quint64(size)) {
+        return false;
+    }
+
+    const AstNode *n = reinterpret_cast<const AstNode *>(data + sizeof(Header));
+    const quint32 *e = reinterpret_cast<const quint32 *>(n + h->nodeCount);
+
+    // Check every index once, so walking the image later can't run off it.
+    // A parsed tree links each node from at most one parent or predecessor,
+    // and the root from none, so a walk from the root can't loop either.
+    std::vector<bool> linked(h->nodeCount, false);
+    auto validLink = [&](quint32 index) {
+        if (index == FlatAst::NoNode) {
+            return true;
+        }
+        if (index >= h->nodeCount || linked[index]) {
+            return false;
+        }
+        linked[index] = true;
+        return true;
+    };
+    if (!validLink(h->root)) {
+        return false;
+    }
+    for (quint32 i = 0; i < h->nodeCount; ++i) {
+        const AstNode &node = n[i];
+        if (node.kind > NodeKind::Id || node.childCount > 3 || !validLink(node.sibling)
+            || (node.kind == NodeKind::Op && !isBinaryOperator(node.op))) {
+            return false;
+        }
+        for (quint32 c = 0; c < node.childCount; ++c) {
+            if (!validLink(node.children[c])) {
+                return false;
+            }
+        }
+        quint32 limit = node.kind == NodeKind::Const ? h->literalCount
+                        : (node.kind == NodeKind::Assign || node.kind == NodeKind::Read || node.kind == NodeKind::Id)
+                            ? h->identifierCount : FlatAst::NoNode;
+        if (limit != FlatAst::NoNode && node.payload >= limit) {
+            return false;
+        }
+    }
+    quint32 previous = 0;
+    for (quint64 s = 0; s < stringCount; ++s) {
+        if (e[s] < previous || e[s] > h->textSize) {
+            return false;
+        }
+        previous = e[s];
+    }
+
+    header = h;
+    nodes = n;
+    stringEnds = e;
+    text = reinterpret_cast<const char *>(e + stringCount);
+    return true;
+}
+
+QString AstImage::string(quint32 index) const {
+    quint32 begin = index == 0 ? 0 : stringEnds[index - 1];
+    return QString::fromUtf8(text + begin, stringEnds[index] - begin);
+}
+
+QString AstImage::displayName(quint32 index) const {
+    const AstNode &n = nodes[index];
+    switch (n.kind) {
+    case NodeKind::Assign:
+    case NodeKind::Read:
+    case NodeKind::Id: return nodeDisplayName(n, identifier(n.payload));
+    case NodeKind::Const: return nodeDisplayName(n, literal(n.payload));
+    default: return nodeDisplayName(n, QString());
+    }
+}
+
+AstCache::AstCache(const QString &directory, const QString &toolVersion) : directory(directory) {
+    salt = QString("tinyast %1 %2\n").arg(AstImage::Version).arg(toolVersion).toUtf8();
+}
+
+QString AstCache::key(const char *source, qsizetype size) const {
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    hash.addData(salt);
+    hash.addData(QByteArrayView(source, size));
+    return QString::fromLatin1(hash.result().toHex());
+}
+
+QString AstCache::entryPath(const QString &key) const {
+    return directory + '/' + key + ".ast";
+}
+
+std::unique_ptr<CachedAst> AstCache::find(const QString &key) const {
+    QString path = entryPath(key);
+    if (!QFile::exists(path)) {
+        return nullptr;
+    }
+    try {
+        auto entry = std::make_unique<CachedAst>(path);
+        if (entry->isValid()) {
+            return entry;
+        }
+    } catch (const std::runtime_error &) {
+        // Unreadable entries count as misses and get rewritten
+    }
+    return nullptr;
+}
+
+bool AstCache::store(const QString &key, const FlatAst &ast) const {
+    if (!QDir().mkpath(directory)) {
+        return false;
+    }
+    QSaveFile file(entryPath(key));
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    QByteArray image = AstImage::build(ast);
+    return file.write(image) == image.size() && file.commit();
+}
@@ -0,0 +1,94 @@
+#ifndef ASTCACHE_H
+#define ASTCACHE_H
+
+#include "flatast.h"
+#include "sourcebuffer.h"
+#include <QByteArray>
+#include <QString>
+#include <memory>
+
+// A FlatAst frozen into one position-independent block of bytes that is
+// walked in place, e.g. straight out of a memory-mapped cache file.
+//
+// Layout, in the writer's byte order (the header records it):
+//   Header
+//   AstNode nodes[nodeCount]
+//   quint32 stringEnds[identifierCount + literalCount]  end of each string in text
+//   char text[textSize]                                 identifiers, then literals (UTF-8)
+class AstImage {
+public:
+    static constexpr quint32 Version = 1;
+
+    static QByteArray build(const FlatAst &ast);
+
+    // View an image; false (and nothing attached) if the bytes aren't a
+    // well-formed image of this version: indices in range, no node linked
+    // twice or back to the root, and known operators. Checked in one pass, so
+    // untrusted cache files are safe to walk. data must stay valid while
+    // attached.
+    bool attach(const char *data, qsizetype size);
+
+    quint32 root() const { return header->root; }
+    quint32 nodeCount() const { return header->nodeCount; }
+    const AstNode &node(quint32 index) const { return nodes[index]; }
+    QString identifier(quint32 id) const { return string(id); }
+    QString literal(quint32 id) const { return string(header->identifierCount + id); }
+
+    QString displayName(quint32 index) const;   // Same as FlatAst::displayName
+    void dump(QTextStream &out) const { dumpAstTree(*this, root(), out); }
+
+private:
+    struct Header {
+        char magic[8];          // "TINYAST\0"
+        quint32 byteOrder;      // 0x01020304 as written
+        quint32 version;
+        quint32 nodeCount;
+        quint32 root;
+        quint32 identifierCount;
+        quint32 literalCount;
+        quint32 textSize;
+        quint32 reserved;
+    };
+    static_assert(sizeof(Header) % alignof(AstNode) == 0, "nodes must stay aligned");
+
+    QString string(quint32 index) const;
+
+    const Header *header = nullptr;
+    const AstNode *nodes = nullptr;
+    const quint32 *stringEnds = nullptr;
+    const char *text = nullptr;
+};
+
+// A cache entry, mapped for as long as this object lives
+class CachedAst {
+public:
+    explicit CachedAst(const QString &path) : file(path) {} // Throws std::runtime_error if unreadable
+
+    bool isValid() { return image.attach(file.data(), file.size()); }
+    const AstImage &ast() const { return image; }
+
+private:
+    SourceBuffer file;
+    AstImage image;
+};
+
+// Directory of AstImages keyed by a hash of the source bytes and the tool
+// version, so unchanged inputs skip scanning and parsing altogether. Entries
+// are written atomically, so concurrent jobs can share a directory.
+class AstCache {
+public:
+    AstCache(const QString &directory, const QString &toolVersion);
+
+    QString key(const char *source, qsizetype size) const;
+
+    std::unique_ptr<CachedAst> find(const QString &key) const; // Null on a miss or a damaged entry
+    bool store(const QString &key, const FlatAst &ast) const;
+
+private:
+    QString entryPath(const QString &key) const;
+
+    QString directory;
+    QByteArray salt;    // Tool and format version, hashed in front of the source
+};
+
+#endif // ASTCACHE_H
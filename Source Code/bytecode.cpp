@@ -0,0 +1,269 @@
+#include "bytecode.h"
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+class Compiler {
+public:
+    Compiler(const FlatAst &ast, BytecodeProgram &program) : ast(ast), program(program) {
+        program.variableCount = quint32(ast.identifiers.size());
+        program.constantBase = program.variableCount;
+        for (qsizetype id = 0; id < ast.literals.size(); ++id) {
+            bool ok = false;
+            qint64 value = ast.literals.text(quint32(id)).toLongLong(&ok);
+            if (!ok) {
+                QString errorMsg = QString("Constant out of range: '%1'").arg(ast.literals.text(quint32(id)));
+                throw std::runtime_error(errorMsg.toStdString());
+            }
+            program.constants.append(value);
+        }
+        for (qsizetype id = 0; id < ast.identifiers.size(); ++id) {
+            program.variableNames.append(ast.identifiers.text(quint32(id)));
+        }
+        tempBase = program.constantBase + quint32(program.constants.size());
+        nextTemp = tempBase;
+        program.frameSize = tempBase;
+    }
+
+    void sequence(quint32 index);
+
+private:
+    quint32 append(Opcode op, quint32 a = 0, quint32 b = 0, quint32 c = 0) {
+        program.code.append(Instruction{op, a, b, c});
+        return quint32(program.code.size() - 1);
+    }
+    quint32 here() const { return quint32(program.code.size()); }
+    void patch(quint32 at, quint32 target);
+
+    quint32 allocateTemp() {
+        quint32 slot = nextTemp++;
+        program.frameSize = std::max(program.frameSize, nextTemp);
+        return slot;
+    }
+
+    quint32 expression(quint32 index, quint32 target);
+    quint32 branchIfFalse(quint32 condition); // Returns the jump to patch
+
+    const FlatAst &ast;
+    BytecodeProgram &program;
+    quint32 tempBase;
+    quint32 nextTemp;
+
+    // Working stacks of expression(), reused between expressions
+    struct Pending {
+        quint32 index;
+        quint32 mark;       // nextTemp before the operands were evaluated
+        bool expanded;      // Operands already pushed
+    };
+    std::vector<Pending> pending;
+    std::vector<quint32> operands;  // Slots of the operands evaluated so far
+
+    // Statement work still to do, with the jumps waiting for their targets
+    struct Step {
+        enum Kind : quint8 { Sequence, ElseBranch, PatchEnd, RepeatCondition } kind;
+        quint32 index;      // First statement of a sequence, or the if/repeat to finish
+        quint32 at;         // Jump to patch, or the start of a repeat's body
+    };
+    std::vector<Step> steps;
+};
+
+// Point the jump at index "at" to target
+void Compiler::patch(quint32 at, quint32 target) {
+    Instruction &jump = program.code[at];
+    switch (jump.op) {
+    case Opcode::Jump: jump.a = target; break;
+    case Opcode::JumpIfZero: jump.b = target; break;
+    default: jump.c = target; break;
+    }
+}
+
+// Evaluate an expression into target (a slot, or NoNode for "any slot") and
+// return the slot holding the value. Leaves need no code at all. Post-order
+// with an explicit stack, so long operator chains can't exhaust the stack.
+quint32 Compiler::expression(quint32 index, quint32 target) {
+    pending.push_back({index, 0, false});
+    while (!pending.empty()) {
+        Pending &item = pending.back();
+        const AstNode &n = ast.node(item.index);
+        if (n.kind == NodeKind::Id || n.kind == NodeKind::Const) {
+            operands.push_back(n.kind == NodeKind::Id ? n.payload : program.constantBase + n.payload);
+            pending.pop_back();
+            continue;
+        }
+        if (!item.expanded) {
+            item.expanded = true;
+            item.mark = nextTemp;
+            pending.push_back({n.children[1], 0, false});
+            pending.push_back({n.children[0], 0, false});
+            continue;
+        }
+
+        // Op, with both operands evaluated
+        quint32 right = operands.back();
+        operands.pop_back();
+        quint32 left = operands.back();
+        operands.pop_back();
+        nextTemp = item.mark;   // Operands are read before the result is written, so their temps can be reused
+        bool outermost = pending.size() == 1;
+        pending.pop_back();
+        quint32 result = outermost && target != FlatAst::NoNode ? target : allocateTemp();
+        Opcode op;
+        switch (n.op) {
+        case TokenType::PLUS: op = Opcode::Add; break;
+        case TokenType::MINUS: op = Opcode::Sub; break;
+        case TokenType::MULT: op = Opcode::Mul; break;
+        case TokenType::DIV: op = Opcode::Div; break;
+        case TokenType::LESSTHAN: op = Opcode::Less; break;
+        default: op = Opcode::Equal; break;
+        }
+        append(op, result, left, right);
+        operands.push_back(result);
+    }
+
+    quint32 slot = operands.back();
+    operands.pop_back();
+    if (target != FlatAst::NoNode && target != slot) {
+        append(Opcode::Move, target, slot);
+        return target;
+    }
+    return slot;
+}
+
+quint32 Compiler::branchIfFalse(quint32 condition) {
+    const AstNode &n = ast.node(condition);
+    quint32 mark = nextTemp;
+    quint32 jump;
+    if (n.kind == NodeKind::Op && (n.op == TokenType::LESSTHAN || n.op == TokenType::EQUAL)) {
+        quint32 left = expression(n.children[0], FlatAst::NoNode);
+        quint32 right = expression(n.children[1], FlatAst::NoNode);
+        jump = append(n.op == TokenType::LESSTHAN ? Opcode::JumpUnlessLess : Opcode::JumpUnlessEqual, left, right);
+    } else {
+        jump = append(Opcode::JumpIfZero, expression(condition, FlatAst::NoNode));
+    }
+    nextTemp = mark;
+    return jump;
+}
+
+// Iterative, so deeply nested ifs and repeats can't exhaust the stack
+void Compiler::sequence(quint32 index) {
+    steps.push_back({Step::Sequence, index, 0});
+    while (!steps.empty()) {
+        Step step = steps.back();
+        steps.pop_back();
+        if (step.kind == Step::PatchEnd) {
+            patch(step.at, here());
+            continue;
+        }
+        if (step.index == FlatAst::NoNode) {
+            continue;   // End of a sequence
+        }
+        const AstNode &n = ast.node(step.index);
+        switch (step.kind) {
+        case Step::Sequence:
+            steps.push_back({Step::Sequence, n.sibling, 0});
+            switch (n.kind) {
+            case NodeKind::Assign:
+                expression(n.children[0], n.payload);
+                break;
+            case NodeKind::Read:
+                append(Opcode::Read, n.payload);
+                break;
+            case NodeKind::Write: {
+                quint32 mark = nextTemp;
+                append(Opcode::Write, expression(n.children[0], FlatAst::NoNode));
+                nextTemp = mark;
+                break;
+            }
+            case NodeKind::If:
+                steps.push_back({Step::ElseBranch, step.index, branchIfFalse(n.children[0])});
+                steps.push_back({Step::Sequence, n.childCount > 1 ? n.children[1] : FlatAst::NoNode, 0});
+                break;
+            case NodeKind::Repeat:
+                // repeat body until cond: loop back while cond is false
+                steps.push_back({Step::RepeatCondition, step.index, here()});
+                steps.push_back({Step::Sequence, n.children[0], 0});
+                break;
+            default:
+                break;
+            }
+            break;
+        case Step::ElseBranch:
+            if (n.childCount > 2) {
+                quint32 toEnd = append(Opcode::Jump);
+                patch(step.at, here());
+                steps.push_back({Step::PatchEnd, step.index, toEnd});
+                steps.push_back({Step::Sequence, n.children[2], 0});
+            } else {
+                patch(step.at, here());
+            }
+            break;
+        case Step::RepeatCondition:
+            patch(branchIfFalse(n.children[1]), step.at);
+            break;
+        case Step::PatchEnd:
+            break;
+        }
+    }
+}
+
+const char *opcodeName(Opcode op) {
+    static const char *const names[] = {
+        "add", "sub", "mul", "div", "less", "equal", "move", "read", "write",
+        "jump", "jz", "jnlt", "jneq", "halt"
+    };
+    return names[int(op)];
+}
+
+} // namespace
+
+BytecodeProgram compileProgram(const FlatAst &ast) {
+    BytecodeProgram program;
+    Compiler compiler(ast, program);
+    compiler.sequence(ast.root);
+    program.code.append(Instruction{Opcode::Halt, 0, 0, 0});
+    return program;
+}
+
+QString BytecodeProgram::disassemble() const {
+    auto slotName = [&](quint32 slot) {
+        if (slot < variableCount) {
+            return variableNames[slot];
+        }
+        if (slot < constantBase + quint32(constants.size())) {
+            return QString::number(constants[slot - constantBase]);
+        }
+        return QString("t%1").arg(slot - constantBase - quint32(constants.size()));
+    };
+
+    QString text;
+    for (qsizetype pc = 0; pc < code.size(); ++pc) {
+        const Instruction &i = code[pc];
+        QString line = QString("%1  %2").arg(pc, 4).arg(opcodeName(i.op), -6);
+        switch (i.op) {
+        case Opcode::Add: case Opcode::Sub: case Opcode::Mul: case Opcode::Div:
+        case Opcode::Less: case Opcode::Equal:
+            line += QString("%1, %2, %3").arg(slotName(i.a), slotName(i.b), slotName(i.c));
+            break;
+        case Opcode::Move:
+            line += QString("%1, %2").arg(slotName(i.a), slotName(i.b));
+            break;
+        case Opcode::Read: case Opcode::Write:
+            line += slotName(i.a);
+            break;
+        case Opcode::Jump:
+            line += QString::number(i.a);
+            break;
+        case Opcode::JumpIfZero:
+            line += QString("%1, %2").arg(slotName(i.a)).arg(i.b);
+            break;
+        case Opcode::JumpUnlessLess: case Opcode::JumpUnlessEqual:
+            line += QString("%1, %2, %3").arg(slotName(i.a), slotName(i.b)).arg(i.c);
+            break;
+        case Opcode::Halt:
+            break;
+        }
+        text += line.trimmed() + '\n';
+    }
+    return text;
+}
@@ -0,0 +1,51 @@
+#ifndef BYTECODE_H
+#define BYTECODE_H
+
+#include "flatast.h"
+#include <QList>
+#include <QString>
+
+// Register bytecode for TINY. Every value lives in a numbered slot of one
+// frame: variables first (slot = identifier ID), then constants (preloaded),
+// then temporaries. Operands are slot numbers, so "x := y + 1" is a single
+// Add x, y, <slot of 1>.
+enum class Opcode : quint8 {
+    Add, Sub, Mul, Div,     // slot[a] = slot[b] op slot[c]
+    Less, Equal,            // slot[a] = slot[b] op slot[c] ? 1 : 0
+    Move,                   // slot[a] = slot[b]
+    Read,                   // slot[a] = next input
+    Write,                  // output slot[a]
+    Jump,                   // goto a
+    JumpIfZero,             // if (slot[a] == 0) goto b
+    JumpUnlessLess,         // if (!(slot[a] < slot[b])) goto c; fused compare-and-branch
+    JumpUnlessEqual,        // if (slot[a] != slot[b]) goto c
+    Halt
+};
+
+// TINY integers are 64-bit and wrap around on overflow, in every engine
+inline qint64 wrappingAdd(qint64 a, qint64 b) { return qint64(quint64(a) + quint64(b)); }
+inline qint64 wrappingSub(qint64 a, qint64 b) { return qint64(quint64(a) - quint64(b)); }
+inline qint64 wrappingMul(qint64 a, qint64 b) { return qint64(quint64(a) * quint64(b)); }
+inline qint64 wrappingDiv(qint64 a, qint64 b) { return b == -1 ? wrappingSub(0, a) : a / b; } // b != 0
+
+struct Instruction {
+    Opcode op;
+    quint32 a, b, c;
+};
+
+struct BytecodeProgram {
+    QList<Instruction> code;
+    QList<qint64> constants;    // Initial values of the constant slots
+    quint32 variableCount = 0;
+    quint32 constantBase = 0;   // First constant slot
+    quint32 frameSize = 0;      // Variables + constants + temporaries
+    QList<QString> variableNames;
+
+    QString disassemble() const;
+};
+
+// Compile a parsed program. Throws std::runtime_error if a constant doesn't
+// fit in 64 bits.
+BytecodeProgram compileProgram(const FlatAst &ast);
+
+#endif // BYTECODE_H
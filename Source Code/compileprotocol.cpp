@@ -0,0 +1,166 @@
+#include "compileprotocol.h"
+#include <cerrno>
+#include <cstdlib>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+namespace {
+
+// Larger frames are refused rather than allocated
+constexpr uint32_t MaxFrameBytes = 1u << 30;
+
+void putU32(std::string &out, uint32_t value) {
+    for (int shift = 0; shift < 32; shift += 8) {
+        out += char((value >> shift) & 0xFF);
+    }
+}
+
+bool getU32(const std::string &in, size_t &at, uint32_t &value) {
+    if (in.size() - at < 4) {
+        return false;
+    }
+    value = 0;
+    for (int i = 0; i < 4; ++i) {
+        value |= uint32_t(static_cast<unsigned char>(in[at + i])) << (8 * i);
+    }
+    at += 4;
+    return true;
+}
+
+void putSection(std::string &out, const std::string &section) {
+    putU32(out, uint32_t(section.size()));
+    out += section;
+}
+
+bool getSection(const std::string &in, size_t &at, std::string &section) {
+    uint32_t size;
+    if (!getU32(in, at, size) || in.size() - at < size) {
+        return false;
+    }
+    section.assign(in, at, size);
+    at += size;
+    return true;
+}
+
+bool readAll(int fd, char *data, size_t size) {
+    while (size > 0) {
+        ssize_t n = ::read(fd, data, size);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        size -= size_t(n);
+    }
+    return true;
+}
+
+bool writeAll(int fd, const char *data, size_t size) {
+    while (size > 0) {
+        ssize_t n = ::write(fd, data, size);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        size -= size_t(n);
+    }
+    return true;
+}
+
+} // namespace
+
+std::string encodeRequest(const CompileRequest &request) {
+    std::string frame;
+    frame.reserve(2 + request.payload.size());
+    frame += char(request.flags);
+    frame += char(request.tokenFormat);
+    frame += request.payload;
+    return frame;
+}
+
+bool decodeRequest(const std::string &frame, CompileRequest &request) {
+    if (frame.size() < 2) {
+        return false;
+    }
+    request.flags = uint8_t(frame[0]);
+    request.tokenFormat = uint8_t(frame[1]);
+    request.payload.assign(frame, 2, std::string::npos);
+    return true;
+}
+
+std::string encodeReply(const CompileReply &reply) {
+    std::string frame;
+    frame.reserve(17 + reply.tokens.size() + reply.tree.size() + reply.symbols.size() + reply.diagnostics.size());
+    frame += char(reply.status);
+    putSection(frame, reply.tokens);
+    putSection(frame, reply.tree);
+    putSection(frame, reply.symbols);
+    putSection(frame, reply.diagnostics);
+    return frame;
+}
+
+bool decodeReply(const std::string &frame, CompileReply &reply) {
+    if (frame.empty() || uint8_t(frame[0]) > uint8_t(CompileStatus::Failed)) {
+        return false;
+    }
+    reply.status = CompileStatus(frame[0]);
+    size_t at = 1;
+    return getSection(frame, at, reply.tokens) && getSection(frame, at, reply.tree) &&
+           getSection(frame, at, reply.symbols) && getSection(frame, at, reply.diagnostics) &&
+           at == frame.size();
+}
+
+bool readFrame(int fd, std::string &frame) {
+    char header[4];
+    if (!readAll(fd, header, sizeof header)) {
+        return false;
+    }
+    std::string bytes(header, sizeof header);
+    size_t at = 0;
+    uint32_t size;
+    getU32(bytes, at, size);
+    if (size > MaxFrameBytes) {
+        return false;
+    }
+    frame.resize(size);
+    return readAll(fd, &frame[0], size);
+}
+
+bool writeFrame(int fd, const std::string &frame) {
+    if (frame.size() > MaxFrameBytes) {
+        return false;
+    }
+    // One write for header and body, so small messages go out in one segment
+    std::string out;
+    out.reserve(4 + frame.size());
+    putU32(out, uint32_t(frame.size()));
+    out += frame;
+    return writeAll(fd, out.data(), out.size());
+}
+
+std::string defaultSocketPath() {
+    if (const char *path = std::getenv("TINYC_SOCKET")) {
+        return path;
+    }
+    const char *dir = std::getenv("XDG_RUNTIME_DIR");
+    std::string base = dir && *dir ? dir : "/tmp";
+    return base + "/tinyc-" + std::to_string(getuid()) + ".sock";
+}
+
+bool peerIsCurrentUser(int fd) {
+#ifdef __linux__
+    ucred credentials{};
+    socklen_t size = sizeof credentials;
+    return ::getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &credentials, &size) == 0 && credentials.uid == ::getuid();
+#else
+    uid_t uid;
+    gid_t gid;
+    return ::getpeereid(fd, &uid, &gid) == 0 && uid == ::getuid();
+#endif
+}
@@ -0,0 +1,64 @@
+#ifndef COMPILEPROTOCOL_H
+#define COMPILEPROTOCOL_H
+
+#include <cstdint>
+#include <string>
+
+// Messages between "tinyc --serve" and tinyclient over a Unix domain socket.
+// Plain C++ without Qt, so the client starts in well under a millisecond.
+//
+// Every message is a frame: a little-endian uint32 byte count, then the bytes.
+// A connection carries any number of request/reply pairs, in order.
+//
+//   request: uint8 flags; uint8 token format (TokenFormat: 0 text, 1 jsonl,
+//            2 binary); then the file path, or the source text with InlineSource
+//   reply:   uint8 status; then four sections, each a uint32 length and the
+//            bytes: tokens, syntax tree dump, symbol report, diagnostics
+//            ("line:column: error: message" lines)
+
+enum CompileFlag : uint8_t {
+    WantTokens = 1,     // Scan, and return the tokens
+    WantTree = 2,       // Parse, and return the syntax tree dump
+    WantSymbols = 4,    // Parse, and return the symbol report
+    Warnings = 8,       // Parse, and add use-before-assign warnings
+    InlineSource = 16   // The payload is source text, not a path
+};
+
+enum class CompileStatus : uint8_t {
+    Ok,             // Outputs are complete, no errors
+    SourceErrors,   // Outputs are complete as far as the errors allow
+    Failed          // Nothing was produced, e.g. the file couldn't be read
+};
+
+struct CompileRequest {
+    uint8_t flags = 0;
+    uint8_t tokenFormat = 0;
+    std::string payload;
+};
+
+struct CompileReply {
+    CompileStatus status = CompileStatus::Ok;
+    std::string tokens;
+    std::string tree;
+    std::string symbols;
+    std::string diagnostics;
+};
+
+std::string encodeRequest(const CompileRequest &request);
+bool decodeRequest(const std::string &frame, CompileRequest &request);
+std::string encodeReply(const CompileReply &reply);
+bool decodeReply(const std::string &frame, CompileReply &reply);
+
+// Blocking frame I/O on a socket; false on end of stream or any error
+bool readFrame(int fd, std::string &frame);
+bool writeFrame(int fd, const std::string &frame);
+
+// $TINYC_SOCKET, else tinyc-<uid>.sock in $XDG_RUNTIME_DIR or /tmp
+std::string defaultSocketPath();
+
+// Whether the process at the other end of a connected Unix domain socket runs
+// as this user. The default path is predictable, and not every system honours
+// the permissions of a socket file, so both ends check.
+bool peerIsCurrentUser(int fd);
+
+#endif // COMPILEPROTOCOL_H
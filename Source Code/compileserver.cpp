@@ -0,0 +1,283 @@
+#include "compileserver.h"
+#include "diagnostics.h"
+#include "flatast.h"
+#include "parser.h"
+#include "pipelinestats.h"
+#include "semantics.h"
+#include "sourcebuffer.h"
+#include "symboltable.h"
+#include "threadpool.h"
+#include "tokenexport.h"
+#include "tokenstream.h"
+#include "trace.h"
+#include <QBuffer>
+#include <QCryptographicHash>
+#include <QTextStream>
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <iterator>
+#include <memory>
+#include <pthread.h>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+volatile std::sig_atomic_t stopRequested = 0;
+
+void requestStop(int) {
+    stopRequested = 1;
+}
+
+std::string toStdString(const QByteArray &bytes) {
+    return std::string(bytes.constData(), size_t(bytes.size()));
+}
+
+} // namespace
+
+CompileReply CompileServer::handle(const CompileRequest &request) {
+    requests++;
+    PhaseTimer timer(nullptr, "request");
+    CompileReply reply;
+    if (request.tokenFormat > quint8(TokenFormat::Binary)) {
+        reply.status = CompileStatus::Failed;
+        reply.diagnostics = "unknown token format\n";
+        return reply;
+    }
+    TokenFormat format = TokenFormat(request.tokenFormat);
+
+    try {
+        std::unique_ptr<SourceBuffer> source;
+        if (request.flags & InlineSource) {
+            source = std::make_unique<SourceBuffer>(QByteArray(request.payload.data(), qsizetype(request.payload.size())));
+        } else {
+            source = std::make_unique<SourceBuffer>(QString::fromStdString(request.payload));
+        }
+
+        // The outputs depend on the flags, the format and the bytes, not on where they came from
+        QCryptographicHash hash(QCryptographicHash::Sha256);
+        char settings[2] = {char(request.flags & ~InlineSource), char(request.tokenFormat)};
+        hash.addData(QByteArrayView(settings, sizeof settings));
+        hash.addData(QByteArrayView(source->data(), source->size()));
+        QByteArray key = hash.result();
+        if (findCached(key, reply)) {
+            hits++;
+            return reply;
+        }
+
+        Diagnostics diagnostics;
+        diagnostics.setSource(source->data(), source->size());
+
+        QList<CompactToken> scanned;
+        bool scan = request.flags & WantTokens;
+        if (scan) {
+            scanned = tokenizeCompact(source->data(), source->size(), &diagnostics);
+            QBuffer buffer;
+            buffer.open(QIODevice::WriteOnly);
+            TokenWriter writer(buffer, format);
+            for (const CompactToken &token : scanned) {
+                writer.write(token, source->data());
+            }
+            writer.finish();
+            reply.tokens = toStdString(buffer.data());
+        }
+
+        bool needSymbols = request.flags & (WantSymbols | Warnings);
+        if (request.flags & (WantTree | WantSymbols | Warnings)) {
+            CompactTokenSource scannedTokens(scanned, source->data());
+            LexerTokenSource lexedTokens(source->data(), source->size(), &diagnostics);
+            TokenSource &tokens = scan ? static_cast<TokenSource &>(scannedTokens) : lexedTokens;
+
+            // Kept per worker, with their capacity, from one request to the next
+            thread_local FlatAst ast;
+            thread_local SymbolTable symbols;
+            Parser parser(tokens);
+            parser.setStrategy(Parser::Strategy::ExplicitStack);
+            parser.setDiagnostics(&diagnostics);
+            parser.setSymbols(needSymbols ? &symbols : nullptr);
+            parser.parse(ast);
+            if (request.flags & Warnings) {
+                checkUseBeforeAssign(ast, symbols, diagnostics);
+            }
+            if (request.flags & WantSymbols) {
+                reply.symbols = toStdString(symbolReport(ast, symbols, diagnostics).toUtf8());
+            }
+            if (request.flags & WantTree) {
+                QBuffer buffer;
+                buffer.open(QIODevice::WriteOnly);
+                QTextStream writer(&buffer);
+                ast.dump(writer);
+                writer.flush();
+                reply.tree = toStdString(buffer.data());
+            }
+        }
+
+        QByteArray report;
+        for (const Diagnostic &diagnostic : diagnostics.items()) {
+            report += diagnostic.toString().toUtf8();
+            report += '\n';
+        }
+        reply.diagnostics = toStdString(report);
+        reply.status = diagnostics.hasErrors() ? CompileStatus::SourceErrors : CompileStatus::Ok;
+        storeCached(key, reply);
+    } catch (const std::exception &e) {  // Including bad_alloc, which would end the server
+        reply = CompileReply();
+        reply.status = CompileStatus::Failed;
+        reply.diagnostics = std::string(e.what()) + '\n';
+    }
+    return reply;
+}
+
+bool CompileServer::findCached(const QByteArray &key, CompileReply &reply) {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    auto found = index.value(key, entries.end());
+    if (found == entries.end()) {
+        return false;
+    }
+    entries.splice(entries.end(), entries, found);   // Now the most recently used
+    reply = found->reply;
+    return true;
+}
+
+void CompileServer::storeCached(const QByteArray &key, const CompileReply &reply) {
+    qsizetype bytes = qsizetype(reply.tokens.size() + reply.tree.size() + reply.symbols.size() + reply.diagnostics.size());
+    if (bytes > cacheLimit / 4) {
+        return;     // One huge file shouldn't flush everything else
+    }
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    if (index.contains(key)) {
+        return;     // Another worker got there first
+    }
+    entries.push_back({key, reply, bytes});
+    index.insert(key, std::prev(entries.end()));
+    cachedBytes += bytes;
+    while (cachedBytes > cacheLimit) {
+        const Entry &oldest = entries.front();
+        cachedBytes -= oldest.bytes;
+        index.remove(oldest.key);
+        entries.pop_front();
+    }
+}
+
+void CompileServer::serveConnection(int fd) {
+    try {
+        std::string frame;
+        CompileRequest request;
+        while (readFrame(fd, frame)) {
+            CompileReply reply;
+            if (decodeRequest(frame, request)) {
+                reply = handle(request);
+            } else {
+                reply.status = CompileStatus::Failed;
+                reply.diagnostics = "malformed request\n";
+            }
+            if (!writeFrame(fd, encodeReply(reply))) {
+                break;
+            }
+        }
+    } catch (const std::exception &) {
+        // Out of memory for a frame: drop this client, not the server
+    }
+    {
+        std::lock_guard<std::mutex> lock(connectionMutex);
+        connections.remove(fd);
+    }
+    ::close(fd);
+}
+
+int CompileServer::serve(const QString &path, int threads) {
+    QByteArray name = path.toLocal8Bit();
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (name.size() >= qsizetype(sizeof address.sun_path)) {
+        std::fprintf(stderr, "tinyc: socket path too long: %s\n", name.constData());
+        return 2;
+    }
+    std::copy(name.constData(), name.constData() + name.size(), address.sun_path);
+
+    int listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) {
+        std::perror("tinyc: socket");
+        return 1;
+    }
+    // A socket left behind by a server that died is replaced; a live one is not
+    if (::connect(listener, reinterpret_cast<sockaddr *>(&address), sizeof address) == 0) {
+        std::fprintf(stderr, "tinyc: a server is already listening on %s\n", name.constData());
+        ::close(listener);
+        return 1;
+    }
+    ::close(listener);
+    ::unlink(name.constData());
+    // Created owner-only from the start, rather than chmod'ed after bind left it open
+    listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    mode_t oldMask = ::umask(S_IXUSR | S_IRWXG | S_IRWXO);
+    bool bound = listener >= 0 && ::bind(listener, reinterpret_cast<sockaddr *>(&address), sizeof address) == 0;
+    ::umask(oldMask);
+    if (!bound || ::listen(listener, SOMAXCONN) != 0) {
+        std::perror("tinyc: cannot listen");
+        if (listener >= 0) {
+            ::close(listener);
+        }
+        return 1;
+    }
+
+    // Workers never see the stop signals, so they interrupt accept() below;
+    // a client that hangs up mid-reply must not kill the server either
+    std::signal(SIGPIPE, SIG_IGN);
+    sigset_t stopSignals;
+    sigemptyset(&stopSignals);
+    sigaddset(&stopSignals, SIGINT);
+    sigaddset(&stopSignals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stopSignals, nullptr);
+    {
+        WorkStealingPool pool(threads);
+        pthread_sigmask(SIG_UNBLOCK, &stopSignals, nullptr);
+        struct sigaction action{};
+        action.sa_handler = requestStop;    // No SA_RESTART: accept() returns EINTR
+        sigaction(SIGINT, &action, nullptr);
+        sigaction(SIGTERM, &action, nullptr);
+
+        TINY_TRACE(TraceLevel::Phases) << "serving on" << path << "with" << pool.threadCount() << "threads";
+        while (!stopRequested) {
+            int client = ::accept(listener, nullptr, nullptr);
+            if (client < 0) {
+                if (errno == EINTR || errno == ECONNABORTED) {
+                    continue;
+                }
+                std::perror("tinyc: accept");
+                break;
+            }
+            if (!peerIsCurrentUser(client)) {
+                ::close(client);
+                continue;
+            }
+            // Reads and writes fail once the client stalls, which ends its connection
+            timeval idle{IdleTimeoutSeconds, 0};
+            ::setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &idle, sizeof idle);
+            ::setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &idle, sizeof idle);
+            {
+                std::lock_guard<std::mutex> lock(connectionMutex);
+                connections.insert(client);
+            }
+            pool.submit([this, client] { serveConnection(client); });
+        }
+        ::close(listener);
+        ::unlink(name.constData());
+        {
+            // Wakes the workers waiting on clients, queued connections end at once
+            std::lock_guard<std::mutex> lock(connectionMutex);
+            for (int fd : connections) {
+                ::shutdown(fd, SHUT_RDWR);
+            }
+        }
+        pool.wait();
+    }
+    TINY_TRACE(TraceLevel::Phases) << "served" << requests.load() << "requests," << hits.load() << "from cache";
+    return 0;
+}
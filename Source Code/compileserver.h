@@ -0,0 +1,63 @@
+#ifndef COMPILESERVER_H
+#define COMPILESERVER_H
+
+#include "compileprotocol.h"
+#include <QByteArray>
+#include <QHash>
+#include <QSet>
+#include <QString>
+#include <atomic>
+#include <list>
+#include <mutex>
+
+// Long-running "tinyc --serve": answers CompileRequests from tinyclient on a
+// Unix domain socket, so a build pays for process and Qt start-up once
+// instead of once per file. Connections are served on a work-stealing pool;
+// each worker keeps its syntax tree and symbol table (and their capacity)
+// from request to request, and replies are kept in a bounded in-memory
+// cache keyed by a hash of the request and the source bytes. A client that
+// stalls for IdleTimeoutSeconds is dropped, so it can't hold a worker, and
+// stopping shuts down the connections still open.
+class CompileServer {
+public:
+    static constexpr qsizetype DefaultCacheBytes = 64 << 20;
+    static constexpr int IdleTimeoutSeconds = 30;
+
+    explicit CompileServer(qsizetype cacheBytes = DefaultCacheBytes) : cacheLimit(cacheBytes) {}
+
+    // Listen on path until SIGINT/SIGTERM; threads = 0 for one per core.
+    // Returns the exit status for the process.
+    int serve(const QString &path, int threads);
+
+    CompileReply handle(const CompileRequest &request);
+
+    qint64 requestCount() const { return requests; }
+    qint64 cacheHitCount() const { return hits; }
+
+private:
+    void serveConnection(int fd);
+
+    bool findCached(const QByteArray &key, CompileReply &reply);
+    void storeCached(const QByteArray &key, const CompileReply &reply);
+
+    // Least recently used entry first
+    struct Entry {
+        QByteArray key;
+        CompileReply reply;
+        qsizetype bytes;
+    };
+    std::mutex cacheMutex;
+    std::list<Entry> entries;
+    QHash<QByteArray, std::list<Entry>::iterator> index;
+    qsizetype cachedBytes = 0;
+    qsizetype cacheLimit;
+
+    // Accepted and not yet closed
+    std::mutex connectionMutex;
+    QSet<int> connections;
+
+    std::atomic<qint64> requests{0};
+    std::atomic<qint64> hits{0};
+};
+
+#endif // COMPILESERVER_H
@@ -0,0 +1,89 @@
+#include "diagnostics.h"
+#include <algorithm>
+#include <cstring>
+
+QString Diagnostic::toString() const {
+    const char *kind = severity == Severity::Warning ? "warning" : "error";
+    if (line > 0) {
+        return QString("%1:%2: %3: %4").arg(line).arg(column).arg(kind).arg(message);
+    }
+    return QString("%1: %2").arg(kind).arg(message);
+}
+
+void Diagnostics::setSource(const char *utf8, qsizetype size) {
+    bytes = utf8;
+    byteCount = size;
+    text.clear();
+    lineStarts.clear();
+    indexed = false;
+}
+
+void Diagnostics::setSource(const QString &source) {
+    bytes = nullptr;
+    byteCount = 0;
+    text = source;
+    lineStarts.clear();
+    indexed = false;
+}
+
+void Diagnostics::error(qsizetype offset, const QString &message) {
+    add(offset, message, Diagnostic::Severity::Error);
+    errors++;
+}
+
+void Diagnostics::warning(qsizetype offset, const QString &message) {
+    add(offset, message, Diagnostic::Severity::Warning);
+}
+
+void Diagnostics::add(qsizetype offset, const QString &message, Diagnostic::Severity severity) {
+    // Tokens past the end have no offset; report those at the end of the source
+    if (offset < 0 && (bytes || !text.isEmpty())) {
+        offset = bytes ? byteCount : text.size();
+    }
+
+    Diagnostic diagnostic{offset, 0, 0, message, severity};
+    if (offset >= 0) {
+        locate(offset, diagnostic.line, diagnostic.column);
+    }
+
+    // Errors usually arrive in source order; the scanner may run a few tokens ahead
+    if (offset < 0) {
+        list.append(diagnostic);
+        return;
+    }
+    auto position = std::upper_bound(list.begin(), list.end(), offset,
+                                     [](qsizetype value, const Diagnostic &d) { return value < d.offset; });
+    list.insert(position, diagnostic);
+}
+
+void Diagnostics::clear() {
+    list.clear();
+    errors = 0;
+}
+
+void Diagnostics::locate(qsizetype offset, int &line, int &column) {
+    if (!bytes && text.isEmpty()) {
+        return;
+    }
+
+    if (!indexed) {
+        lineStarts.append(0);
+        if (bytes) {
+            const char *p = bytes;
+            const char *end = bytes + byteCount;
+            while (const void *newline = std::memchr(p, '\n', end - p)) {
+                p = static_cast<const char *>(newline) + 1;
+                lineStarts.append(p - bytes);
+            }
+        } else {
+            for (qsizetype i = text.indexOf('\n'); i >= 0; i = text.indexOf('\n', i + 1)) {
+                lineStarts.append(i + 1);
+            }
+        }
+        indexed = true;
+    }
+
+    auto next = std::upper_bound(lineStarts.begin(), lineStarts.end(), offset);
+    line = int(next - lineStarts.begin());
+    column = int(offset - *(next - 1)) + 1;
+}
@@ -0,0 +1,51 @@
+#ifndef DIAGNOSTICS_H
+#define DIAGNOSTICS_H
+
+#include <QList>
+#include <QString>
+
+// One located problem found while scanning, parsing or checking
+struct Diagnostic {
+    enum class Severity { Error, Warning };
+
+    qsizetype offset;   // Position in the source (bytes or QChars, matching the scanner), -1 if unknown
+    int line;           // 1-based; 0 when the source wasn't registered
+    int column;         // 1-based
+    QString message;
+    Severity severity = Severity::Error;
+
+    QString toString() const; // "line:column: error: message" (or "warning:")
+};
+
+// Collects errors instead of throwing or showing UI, so one pass over a
+// file can report every problem in it. Entries are kept ordered by offset.
+class Diagnostics {
+public:
+    // Register the text offsets refer to, for line/column lookup
+    void setSource(const char *utf8, qsizetype size);
+    void setSource(const QString &text);
+
+    void error(qsizetype offset, const QString &message);
+    void warning(qsizetype offset, const QString &message); // Doesn't count as an error
+
+    const QList<Diagnostic> &items() const { return list; }
+    bool hasErrors() const { return errors > 0; }
+    int errorCount() const { return errors; }
+    void clear();
+
+    // 1-based line and column of an offset; left unchanged without a source
+    void locate(qsizetype offset, int &line, int &column);
+
+private:
+    void add(qsizetype offset, const QString &message, Diagnostic::Severity severity);
+
+    const char *bytes = nullptr;
+    qsizetype byteCount = 0;
+    QString text;
+    QList<qsizetype> lineStarts;   // Built on the first error
+    bool indexed = false;
+    QList<Diagnostic> list;
+    int errors = 0;
+};
+
+#endif // DIAGNOSTICS_H
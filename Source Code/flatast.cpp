@@ -0,0 +1,89 @@
+#include "flatast.h"
+#include "syntaxtree.h"
+
+quint32 FlatAst::addNode(NodeKind kind, quint32 payload, TokenType op) {
+    quint32 index = quint32(nodes.size());
+    nodes.append(AstNode{kind, op, 0, payload, NoNode, {NoNode, NoNode, NoNode}});
+    return index;
+}
+
+void FlatAst::clear() {
+    nodes.resize(0);
+    identifiers.clear();
+    literals.clear();
+    root = NoNode;
+}
+
+qsizetype FlatAst::memoryUsage() const {
+    return nodes.capacity() * qsizetype(sizeof(AstNode)) + identifiers.memoryUsage() + literals.memoryUsage();
+}
+
+qint64 FlatAst::constantValue(quint32 index, bool *ok) const {
+    return literals.text(nodes[index].payload).toLongLong(ok);
+}
+
+QString nodeDisplayName(const AstNode &node, const QString &payloadText) {
+    switch (node.kind) {
+    case NodeKind::If: return "if";
+    case NodeKind::Repeat: return "repeat";
+    case NodeKind::Assign: return QString("assign (%1)").arg(payloadText);
+    case NodeKind::Read: return QString("read (%1)").arg(payloadText);
+    case NodeKind::Write: return "write";
+    case NodeKind::Op: return Token::fixedText(node.op);
+    case NodeKind::Const: return payloadText;
+    case NodeKind::Id: return payloadText;
+    }
+    return QString();
+}
+
+QString FlatAst::displayName(quint32 index) const {
+    const AstNode &n = nodes[index];
+    switch (n.kind) {
+    case NodeKind::Assign:
+    case NodeKind::Read:
+    case NodeKind::Id: return nodeDisplayName(n, identifiers.text(n.payload));
+    case NodeKind::Const: return nodeDisplayName(n, literals.text(n.payload));
+    default: return nodeDisplayName(n, QString());
+    }
+}
+
+SyntaxTreeNode* FlatAst::toSyntaxTree(SyntaxTreeArena &arena) const {
+    // Explicit work stack, like dumpAstTree, so long operator chains and deep
+    // nesting can't overflow the call stack. Each entry says where the new
+    // node's pointer goes: a child slot of its parent or the previous
+    // statement's sibling link.
+    struct Pending { quint32 index; SyntaxTreeNode **slot; };
+    SyntaxTreeNode* first = nullptr;
+    std::vector<Pending> stack;
+    if (root != NoNode) {
+        stack.push_back({root, &first});
+    }
+    while (!stack.empty()) {
+        Pending item = stack.back();
+        stack.pop_back();
+        const AstNode &n = nodes[item.index];
+        SyntaxTreeNode* treeNode = arena.create(displayName(item.index), n.kind);
+        *item.slot = treeNode;
+
+        if (n.sibling != NoNode) {
+            stack.push_back({n.sibling, &treeNode->sibling});
+        }
+        // Reserve every child slot first, so the slot addresses stay put
+        for (quint32 c = 0; c < n.childCount; ++c) {
+            if (n.children[c] != NoNode) { // Sequences emptied by error recovery
+                treeNode->children.append(nullptr);
+            }
+        }
+        qsizetype slot = treeNode->children.size();
+        for (quint32 c = n.childCount; c-- > 0;) {
+            if (n.children[c] != NoNode) {
+                stack.push_back({n.children[c], &treeNode->children[--slot]});
+            }
+        }
+    }
+    return first;
+}
+
+void FlatAst::dump(QTextStream &out) const {
+    dumpAstTree(*this, root, out);
+}
@@ -0,0 +1,106 @@
+#ifndef FLATAST_H
+#define FLATAST_H
+
+#include "token.h"
+#include "stringinterner.h"
+#include <QList>
+#include <QString>
+#include <QTextStream>
+#include <vector>
+
+class SyntaxTreeNode;
+class SyntaxTreeArena;
+
+// What a node is, instead of encoding it in its display string
+enum class NodeKind : quint8 {
+    If,       // children: condition, then-sequence [, else-sequence]
+    Repeat,   // children: body sequence, condition
+    Assign,   // payload: identifier ID; children: expression
+    Read,     // payload: identifier ID
+    Write,    // children: expression
+    Op,       // op: operator token; children: left, right
+    Const,    // payload: literal ID (spelling of the number)
+    Id        // payload: identifier ID
+};
+
+inline bool isStatementKind(NodeKind kind) { return kind <= NodeKind::Write; }
+
+// One node of the flat AST. Children and the next statement are indices into
+// FlatAst::nodes, so a whole tree is one contiguous array.
+struct AstNode {
+    NodeKind kind;
+    TokenType op;           // Operator for Op nodes, UNKNOWN otherwise
+    quint16 childCount;
+    quint32 payload;        // Identifier or literal ID, see NodeKind
+    quint32 sibling;        // Next statement in a sequence, or FlatAst::NoNode
+    quint32 children[3];
+};
+static_assert(sizeof(AstNode) == 24, "AstNode should stay at 24 bytes");
+
+// Display name of a node, given the identifier or literal its payload refers to
+QString nodeDisplayName(const AstNode &node, const QString &payloadText);
+
+// Indented text dump shared by FlatAst and the mapped AstImage: one display
+// name per line, children two spaces further in than their parent. Tree needs
+// node(index) and displayName(index).
+template <class Tree>
+void dumpAstTree(const Tree &tree, quint32 root, QTextStream &out);
+
+// Index-based syntax tree built by Parser. Identifiers and number spellings
+// are interned; the display names the GUI shows are derived on demand.
+class FlatAst {
+public:
+    static constexpr quint32 NoNode = 0xFFFFFFFFu;
+
+    QList<AstNode> nodes;
+    StringInterner identifiers;
+    StringInterner literals;
+    quint32 root = NoNode;     // First statement of the program
+
+    quint32 addNode(NodeKind kind, quint32 payload = 0, TokenType op = TokenType::UNKNOWN);
+    void addChild(quint32 parent, quint32 child) { AstNode &n = nodes[parent]; n.children[n.childCount++] = child; }
+    void clear();              // Keeps the node array's capacity
+    qsizetype memoryUsage() const; // Bytes held by the node array and interners
+
+    const AstNode &node(quint32 index) const { return nodes[index]; }
+    bool isStatement(quint32 index) const { return isStatementKind(nodes[index].kind); }
+    // Value of a Const node; *ok is false (and 0 returned) if it doesn't fit in 64 bits
+    qint64 constantValue(quint32 index, bool *ok) const;
+
+    // Same strings the parser used to store in SyntaxTreeNode::name
+    QString displayName(quint32 index) const;
+
+    // Build the pointer-based display tree for the scene
+    SyntaxTreeNode* toSyntaxTree(SyntaxTreeArena &arena) const;
+
+    // Write the tree as indented text, one display name per line (used by tinyc)
+    void dump(QTextStream &out) const;
+};
+
+template <class Tree>
+void dumpAstTree(const Tree &tree, quint32 root, QTextStream &out) {
+    // Pre-order walk with an explicit stack so deeply nested programs can't
+    // overflow the call stack. Siblings share the indent.
+    struct Pending { quint32 index; int indent; };
+    std::vector<Pending> stack;
+    if (root != FlatAst::NoNode) {
+        stack.push_back({root, 0});
+    }
+    while (!stack.empty()) {
+        Pending item = stack.back();
+        stack.pop_back();
+        const AstNode &n = tree.node(item.index);
+        out << QString(item.indent * 2, ' ') << tree.displayName(item.index) << '\n';
+
+        if (n.sibling != FlatAst::NoNode) {
+            stack.push_back({n.sibling, item.indent});
+        }
+        for (quint32 c = n.childCount; c-- > 0;) {
+            if (n.children[c] != FlatAst::NoNode) { // Sequences emptied by error recovery
+                stack.push_back({n.children[c], item.indent + 1});
+            }
+        }
+    }
+}
+
+#endif // FLATAST_H
@@ -0,0 +1,105 @@
+#include "keywords.h"
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+// Microbenchmark for classifying scanned words as keyword or identifier:
+// the QString == chain tokenize() used to run, a length-checked memcmp table,
+// and the compile-time perfect hash in keywords.h.
+
+namespace {
+
+TokenType stringChain(const QString &word) {
+    if (word == "if") return TokenType::IF;
+    else if (word == "then") return TokenType::THEN;
+    else if (word == "else") return TokenType::ELSE;
+    else if (word == "end") return TokenType::END;
+    else if (word == "repeat") return TokenType::REPEAT;
+    else if (word == "until") return TokenType::UNTIL;
+    else if (word == "read") return TokenType::READ;
+    else if (word == "write") return TokenType::WRITE;
+    return TokenType::IDENTIFIER;
+}
+
+TokenType linearTable(const char *word, qsizetype length) {
+    for (const keywords::Keyword &keyword : keywords::List) {
+        if (keyword.length == length && std::memcmp(keyword.text, word, size_t(length)) == 0) {
+            return keyword.type;
+        }
+    }
+    return TokenType::IDENTIFIER;
+}
+
+// Identifiers, including near misses that share a length and first letter with a keyword
+std::vector<std::string> makeWords(bool wantKeywords, int count) {
+    static const char *const nearMisses[] = {"in", "that", "exit", "eat", "retreat", "unity", "rend", "wrote", "x", "counter"};
+    std::mt19937 rng(42);
+    std::vector<std::string> words;
+    for (int i = 0; i < count; ++i) {
+        if (wantKeywords) {
+            words.push_back(keywords::List[rng() % keywords::Count].text);
+        } else if (rng() % 2) {
+            words.push_back(nearMisses[rng() % 10]);
+        } else {
+            std::string word(1 + rng() % 8, 'a');
+            for (char &c : word) {
+                c = char('a' + rng() % 26);
+            }
+            words.push_back(keywordType(word.data(), qsizetype(word.size())) == TokenType::IDENTIFIER ? word : "id");
+        }
+    }
+    return words;
+}
+
+// Nanoseconds per word; the checksum keeps the calls from being optimized away
+template <typename Classify>
+double measure(const std::vector<std::string> &words, int rounds, Classify classify, unsigned &checksum) {
+    QElapsedTimer timer;
+    timer.start();
+    for (int round = 0; round < rounds; ++round) {
+        for (const std::string &word : words) {
+            checksum += unsigned(classify(word));
+        }
+    }
+    return double(timer.nsecsElapsed()) / (double(words.size()) * rounds);
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    const int count = 100000;
+    const int rounds = 20;
+    QTextStream out(stdout);
+    unsigned checksum = 0;
+
+    out << "ns/word            QString ==   memcmp table   perfect hash\n";
+    for (bool wantKeywords : {true, false}) {
+        std::vector<std::string> words = makeWords(wantKeywords, count);
+        std::vector<QString> strings;
+        for (const std::string &word : words) {
+            strings.push_back(QString::fromStdString(word));
+        }
+        size_t next = 0;
+        double chain = measure(words, rounds, [&](const std::string &) {
+            TokenType type = stringChain(strings[next]);
+            next = next + 1 == strings.size() ? 0 : next + 1;
+            return type;
+        }, checksum);
+        double table = measure(words, rounds, [](const std::string &w) {
+            return linearTable(w.data(), qsizetype(w.size()));
+        }, checksum);
+        double hash = measure(words, rounds, [](const std::string &w) {
+            return keywordType(w.data(), qsizetype(w.size()));
+        }, checksum);
+        out << (wantKeywords ? "keywords      " : "identifiers   ")
+            << QString("%1 %2 %3\n").arg(chain, 14, 'f', 2).arg(table, 14, 'f', 2).arg(hash, 14, 'f', 2);
+    }
+    out << "(checksum " << checksum << ")\n";
+    return 0;
+}
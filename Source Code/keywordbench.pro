@@ -0,0 +1,15 @@
+QT = core
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TARGET = keywordbench
+
+INCLUDEPATH += $$PWD
+
+SOURCES += \
+    keywordbench.cpp
+
+HEADERS += \
+    keywords.h \
+    token.h
@@ -0,0 +1,99 @@
+#ifndef KEYWORDS_H
+#define KEYWORDS_H
+
+#include "token.h"
+#include <QChar>
+
+// Keyword recognition with a perfect hash built at compile time. A word's
+// slot depends only on its length and first and last characters; the
+// multiplier is searched for by the compiler so that the eight keywords land
+// in eight different slots. Classifying a word is one table load and at most
+// one comparison, whether it turns out to be a keyword or an identifier.
+namespace keywords {
+
+struct Keyword {
+    const char *text;
+    int length;
+    TokenType type;
+};
+
+constexpr Keyword List[] = {
+    {"if", 2, TokenType::IF}, {"then", 4, TokenType::THEN}, {"else", 4, TokenType::ELSE},
+    {"end", 3, TokenType::END}, {"repeat", 6, TokenType::REPEAT}, {"until", 5, TokenType::UNTIL},
+    {"read", 4, TokenType::READ}, {"write", 5, TokenType::WRITE},
+};
+constexpr int Count = sizeof(List) / sizeof(List[0]);
+constexpr int MinLength = 2;
+constexpr int MaxLength = 6;
+constexpr unsigned TableSize = 16;  // Power of two, so the modulo is a mask
+
+constexpr unsigned slot(unsigned multiplier, unsigned first, unsigned last, unsigned length) {
+    return (first * multiplier + last + length) & (TableSize - 1);
+}
+
+// Smallest multiplier without collisions, 0 if there is none
+constexpr unsigned findMultiplier() {
+    for (unsigned multiplier = 1; multiplier < 1024; ++multiplier) {
+        bool used[TableSize] = {};
+        bool collision = false;
+        for (const Keyword &keyword : List) {
+            unsigned s = slot(multiplier, unsigned(keyword.text[0]), unsigned(keyword.text[keyword.length - 1]),
+                              unsigned(keyword.length));
+            collision = collision || used[s];
+            used[s] = true;
+        }
+        if (!collision) {
+            return multiplier;
+        }
+    }
+    return 0;
+}
+
+constexpr unsigned Multiplier = findMultiplier();
+static_assert(Multiplier != 0, "No collision-free multiplier for the keyword table");
+
+// Index into List plus one per slot, 0 for empty slots
+struct Table {
+    quint8 entries[TableSize];
+    constexpr Table() : entries() {
+        for (int i = 0; i < Count; ++i) {
+            const Keyword &keyword = List[i];
+            entries[slot(Multiplier, unsigned(keyword.text[0]), unsigned(keyword.text[keyword.length - 1]),
+                         unsigned(keyword.length))] = quint8(i + 1);
+        }
+    }
+};
+constexpr Table table;
+
+inline unsigned code(char c) { return static_cast<unsigned char>(c); }
+inline unsigned code(QChar c) { return c.unicode(); }
+
+} // namespace keywords
+
+// Type of a scanned word: the keyword's type, or IDENTIFIER. Works on UTF-8
+// bytes straight from the source and on QString contents alike.
+template <typename Char>
+inline TokenType keywordType(const Char *word, qsizetype length) {
+    using namespace keywords;
+    if (length < MinLength || length > MaxLength) {
+        return TokenType::IDENTIFIER;
+    }
+    unsigned first = code(word[0]);
+    unsigned last = code(word[length - 1]);
+    int entry = table.entries[slot(Multiplier, first, last, unsigned(length))];
+    if (entry == 0) {
+        return TokenType::IDENTIFIER;
+    }
+    const Keyword &keyword = List[entry - 1];
+    if (keyword.length != length) {
+        return TokenType::IDENTIFIER;
+    }
+    for (qsizetype i = 0; i < length; ++i) {
+        if (code(word[i]) != unsigned(static_cast<unsigned char>(keyword.text[i]))) {
+            return TokenType::IDENTIFIER;
+        }
+    }
+    return keyword.type;
+}
+
+#endif // KEYWORDS_H
@@ -0,0 +1,361 @@
+#include "lspdocument.h"
+#include "parser.h"
+#include "tokenstream.h"
+#include "trace.h"
+#include <QHash>
+#include <algorithm>
+#include <cstring>
+
+const char *const LspDocument::SemanticTypeNames[SemanticTypeCount] = {"keyword", "variable", "number", "operator"};
+
+namespace {
+
+// UTF-16 code units in a run of UTF-8 bytes: one per lead byte, two for
+// characters outside the BMP
+int utf16Length(const char *text, qsizetype bytes) {
+    int units = 0;
+    for (qsizetype i = 0; i < bytes; ++i) {
+        unsigned char c = static_cast<unsigned char>(text[i]);
+        if ((c & 0xC0) != 0x80) {
+            units += c >= 0xF0 ? 2 : 1;
+        }
+    }
+    return units;
+}
+
+int utf8CharLength(unsigned char lead) {
+    if (lead < 0x80) return 1;
+    if (lead >= 0xF0) return 4;
+    if (lead >= 0xE0) return 3;
+    return 2;
+}
+
+// The scanner and parser name token indices and byte positions in their
+// messages; in an editor the range says where, and indices are per segment
+QString withoutPosition(const QString &message) {
+    static const QString marker = QStringLiteral(" at position ");
+    qsizetype at = message.indexOf(marker);
+    if (at < 0) {
+        return message;
+    }
+    qsizetype end = at + marker.size();
+    while (end < message.size() && message[end].isDigit()) {
+        end++;
+    }
+    return message.left(at) + message.mid(end);
+}
+
+LspDocument::SemanticType semanticType(TokenType type) {
+    switch (type) {
+    case TokenType::IF:
+    case TokenType::THEN:
+    case TokenType::ELSE:
+    case TokenType::END:
+    case TokenType::REPEAT:
+    case TokenType::UNTIL:
+    case TokenType::READ:
+    case TokenType::WRITE:
+        return LspDocument::KeywordToken;
+    case TokenType::IDENTIFIER:
+        return LspDocument::VariableToken;
+    case TokenType::NUMBER:
+        return LspDocument::NumberToken;
+    default:
+        return LspDocument::OperatorToken;
+    }
+}
+
+} // namespace
+
+LspDocument::LspDocument(const QByteArray &utf8) {
+    setText(utf8);
+}
+
+LspDocument::~LspDocument() = default;
+
+void LspDocument::setText(const QByteArray &utf8) {
+    source = utf8;
+    Diagnostics scanned;
+    tokenList = tokenizeCompact(source.constData(), source.size(), &scanned);
+    scanErrors.clear();
+    for (const Diagnostic &d : scanned.items()) {
+        scanErrors.append({d.offset, utf8CharLength(static_cast<unsigned char>(source[d.offset])), d.message});
+    }
+    segments.clear();
+    resegment(0, 0, 0);
+    indexLines();
+    rescanned = tokenList.size();
+}
+
+void LspDocument::replace(qsizetype offset, qsizetype removed, const QByteArray &inserted) {
+    offset = std::clamp<qsizetype>(offset, 0, source.size());
+    removed = std::clamp<qsizetype>(removed, 0, source.size() - offset);
+    qsizetype delta = inserted.size() - removed;
+    source.replace(offset, removed, inserted);
+
+    // Tokens ending before the edit keep their text and their end, so scanning
+    // restarts in code (not comment) state right after the last of them. The
+    // end is decided by the character after the token, up to 4 bytes of UTF-8.
+    auto firstTouched = std::lower_bound(tokenList.cbegin(), tokenList.cend(), offset,
+                                         [](const CompactToken &t, qsizetype at) { return t.offset + t.length + 3 < at; });
+    qsizetype first = firstTouched - tokenList.cbegin();
+    qsizetype restart = first > 0 ? tokenList[first - 1].offset + tokenList[first - 1].length : 0;
+
+    // Scan until a token starts where an old token past the edit now starts;
+    // the text from there on is unchanged, so so is everything it scans to
+    Diagnostics scanned;
+    Lexer lexer(source.constData(), source.size(), &scanned);
+    lexer.setRange(restart, source.size());
+    QList<CompactToken> fresh;
+    qsizetype old = first;      // Next old token that could be the resync point
+    qsizetype oldEnd = tokenList.size();
+    qsizetype settled = offset + inserted.size();
+    CompactToken token;
+    while (lexer.next(token)) {
+        if (token.offset >= settled) {
+            while (old < oldEnd && tokenList[old].offset + delta < token.offset) {
+                old++;
+            }
+            if (old < oldEnd && tokenList[old].offset + delta == token.offset) {
+                oldEnd = old;
+                break;
+            }
+        }
+        fresh.append(token);
+    }
+
+    // Scan errors: the re-scanned stretch reports afresh, later ones move
+    qsizetype scannedTo = oldEnd < tokenList.size() ? tokenList[oldEnd].offset : source.size() - delta;
+    QList<ScanError> errors;
+    for (const ScanError &e : scanErrors) {
+        if (e.offset < restart) {
+            errors.append(e);
+        }
+    }
+    for (const Diagnostic &d : scanned.items()) {
+        errors.append({d.offset, utf8CharLength(static_cast<unsigned char>(source[d.offset])), d.message});
+    }
+    for (const ScanError &e : scanErrors) {
+        if (e.offset >= scannedTo) {
+            errors.append({e.offset + delta, e.length, e.message});
+        }
+    }
+    scanErrors = errors;
+
+    // Splice the new tokens in and move the rest
+    qsizetype replaced = oldEnd - first;
+    if (replaced > fresh.size()) {
+        tokenList.remove(first, replaced - fresh.size());
+    } else if (replaced < fresh.size()) {
+        tokenList.insert(first, fresh.size() - replaced, CompactToken{});
+    }
+    std::copy(fresh.cbegin(), fresh.cend(), tokenList.begin() + first);
+    qsizetype stable = first + fresh.size();
+    for (qsizetype i = stable; i < tokenList.size(); ++i) {
+        tokenList[i].offset = quint32(tokenList[i].offset + delta);
+    }
+
+    // Re-parse from the segment holding the first new token, which also holds
+    // the edited bytes if no token changed at all
+    auto holder = std::upper_bound(segments.cbegin(), segments.cend(), first,
+                                   [](qsizetype at, const std::unique_ptr<Segment> &s) { return at < s->first; });
+    qsizetype from = std::max<qsizetype>(holder - segments.cbegin() - 1, 0);
+    resegment(from, stable, fresh.size() - replaced);
+    indexLines();
+    rescanned = fresh.size();
+}
+
+qsizetype LspDocument::segmentStart(const Segment &segment) const {
+    return segment.first < tokenList.size() ? qsizetype(tokenList[segment.first].offset) : source.size();
+}
+
+qsizetype LspDocument::segmentEnd(qsizetype first, qsizetype count) const {
+    qsizetype next = first + count;
+    return next < tokenList.size() ? qsizetype(tokenList[next].offset) : source.size();
+}
+
+std::unique_ptr<LspDocument::Segment> LspDocument::parseSegment(qsizetype first, qsizetype count) const {
+    auto segment = std::make_unique<Segment>();
+    segment->first = first;
+    segment->count = count;
+    segment->base = segmentStart(*segment);
+    CompactTokenSource stream(tokenList, source.constData(), first, first + count);
+    Parser parser(stream);
+    parser.setStrategy(Parser::Strategy::ExplicitStack);
+    parser.setDiagnostics(&segment->diagnostics);
+    parser.setSymbols(&segment->symbols);
+    parser.parse(segment->ast);
+    return segment;
+}
+
+void LspDocument::resegment(qsizetype from, qsizetype stable, qsizetype tokenDelta) {
+    qsizetype oldCount = qsizetype(segments.size());
+    qsizetype next = from + 1;  // Old segment that might start where a new one does
+    qsizetype start = from < oldCount ? segments[from]->first : 0;
+    std::vector<std::unique_ptr<Segment>> parsed;
+    int depth = 0;
+    qsizetype size = tokenList.size();
+    qsizetype i = start;
+    for (; i < size; ++i) {
+        switch (tokenList[i].type) {
+        case TokenType::IF:
+        case TokenType::REPEAT:
+            depth++;
+            continue;
+        case TokenType::END:
+        case TokenType::UNTIL:
+            depth = std::max(depth - 1, 0);  // A stray closer is the parser's to report
+            continue;
+        case TokenType::SEMICOLON:
+            break;
+        default:
+            continue;
+        }
+        if (depth != 0) {
+            continue;
+        }
+        parsed.push_back(parseSegment(start, i - start));
+        start = i + 1;
+        if (i < stable) {
+            continue;
+        }
+        // Past the edit: stop at the first separator the old split also had
+        while (next < oldCount && segments[next]->first + tokenDelta < start) {
+            next++;
+        }
+        if (next < oldCount && segments[next]->first + tokenDelta == start) {
+            break;
+        }
+    }
+    if (i == size) {
+        parsed.push_back(parseSegment(start, size - start));
+        next = oldCount;
+    }
+
+    for (qsizetype k = next; k < oldCount; ++k) {
+        segments[k]->first += tokenDelta;
+    }
+    reparsed = qsizetype(parsed.size());
+    from = std::min(from, oldCount);
+    segments.erase(segments.begin() + from, segments.begin() + next);
+    segments.insert(segments.begin() + from, std::make_move_iterator(parsed.begin()),
+                    std::make_move_iterator(parsed.end()));
+    TINY_TRACE(TraceLevel::Statements) << "re-parsed" << reparsed << "of" << segments.size() << "segments";
+}
+
+void LspDocument::indexLines() {
+    lineStarts.assign(1, 0);
+    const char *text = source.constData();
+    const char *end = text + source.size();
+    for (const char *p = text; (p = static_cast<const char *>(std::memchr(p, '\n', end - p))); ) {
+        lineStarts.push_back(++p - text);
+    }
+}
+
+qsizetype LspDocument::offsetAt(int line, int character) const {
+    if (line < 0) {
+        return 0;
+    }
+    if (line >= int(lineStarts.size())) {
+        return source.size();
+    }
+    const char *text = source.constData();
+    qsizetype at = lineStarts[line];
+    qsizetype end = line + 1 < int(lineStarts.size()) ? lineStarts[line + 1] - 1 : source.size();
+    if (end > at && text[end - 1] == '\r') {
+        end--;
+    }
+    for (int units = 0; at < end && units < character; ) {
+        int length = std::min<qsizetype>(utf8CharLength(static_cast<unsigned char>(text[at])), end - at);
+        units += utf16Length(text + at, length);
+        at += length;
+    }
+    return at;
+}
+
+void LspDocument::positionAt(qsizetype offset, int &line, int &character) const {
+    offset = std::clamp<qsizetype>(offset, 0, source.size());
+    line = int(std::upper_bound(lineStarts.begin(), lineStarts.end(), offset) - lineStarts.begin()) - 1;
+    character = utf16Length(source.constData() + lineStarts[line], offset - lineStarts[line]);
+}
+
+QList<LspDocument::Problem> LspDocument::problems() const {
+    QList<Problem> result;
+    for (const ScanError &e : scanErrors) {
+        result.append({e.offset, e.length, withoutPosition(e.message)});
+    }
+    for (const std::unique_ptr<Segment> &segment : segments) {
+        qsizetype shift = segmentStart(*segment) - segment->base;
+        for (const Diagnostic &d : segment->diagnostics.items()) {
+            // Offset -1 is the end of the segment's tokens: its separator or the end of the text
+            qsizetype at = d.offset < 0 ? segmentEnd(segment->first, segment->count) : d.offset + shift;
+            auto token = std::lower_bound(tokenList.cbegin(), tokenList.cend(), at,
+                                          [](const CompactToken &t, qsizetype offset) { return t.offset < offset; });
+            qsizetype length = token != tokenList.cend() && token->offset == at ? token->length : 1;
+            result.append({at, length, withoutPosition(d.message)});
+        }
+    }
+    std::stable_sort(result.begin(), result.end(), [](const Problem &a, const Problem &b) { return a.offset < b.offset; });
+    return result;
+}
+
+QList<LspDocument::Variable> LspDocument::variables() const {
+    QList<Variable> result;
+    QHash<QString, qsizetype> index;
+    for (const std::unique_ptr<Segment> &segment : segments) {
+        qsizetype shift = segmentStart(*segment) - segment->base;
+        for (qsizetype id = 0; id < segment->symbols.size(); ++id) {
+            const Symbol &symbol = segment->symbols.symbol(quint32(id));
+            const QString &name = segment->ast.identifiers.text(quint32(id));
+            qsizetype slot = index.value(name, -1);
+            if (slot < 0) {
+                slot = result.size();
+                index.insert(name, slot);
+                result.append({name, -1, -1, 0, 0});
+            }
+            Variable &variable = result[slot];
+            if (variable.firstDefinition < 0 && symbol.firstDefinition >= 0) {
+                variable.firstDefinition = symbol.firstDefinition + shift;
+            }
+            if (variable.firstUse < 0 && symbol.firstUse >= 0) {
+                variable.firstUse = symbol.firstUse + shift;
+            }
+            variable.definitions += symbol.definitions;
+            variable.uses += symbol.uses;
+        }
+    }
+    return result;
+}
+
+std::vector<quint32> LspDocument::semanticTokens() const {
+    std::vector<quint32> data;
+    data.reserve(size_t(tokenList.size()) * 5);
+    const char *text = source.constData();
+    size_t line = 0;
+    qsizetype lineStart = 0;
+    qsizetype previous = 0;     // Offset of the previous token, or the line start
+    quint32 column = 0;         // Its UTF-16 column
+    quint32 previousLine = 0;
+    quint32 previousColumn = 0;
+    for (const CompactToken &t : tokenList) {
+        if (line + 1 < lineStarts.size() && lineStarts[line + 1] <= qsizetype(t.offset)) {
+            line = size_t(std::upper_bound(lineStarts.begin() + line, lineStarts.end(), qsizetype(t.offset)) -
+                          lineStarts.begin()) - 1;
+            lineStart = lineStarts[line];
+            previous = lineStart;
+            column = 0;
+        }
+        column += quint32(utf16Length(text + previous, t.offset - previous));
+        previous = t.offset;
+
+        quint32 deltaLine = quint32(line) - previousLine;
+        data.push_back(deltaLine);
+        data.push_back(deltaLine == 0 ? column - previousColumn : column);
+        data.push_back(quint32(utf16Length(text + t.offset, t.length)));
+        data.push_back(semanticType(t.type));
+        data.push_back(0);
+        previousLine = quint32(line);
+        previousColumn = column;
+    }
+    return data;
+}
@@ -0,0 +1,109 @@
+#ifndef LSPDOCUMENT_H
+#define LSPDOCUMENT_H
+
+#include "diagnostics.h"
+#include "flatast.h"
+#include "symboltable.h"
+#include "token.h"
+#include <QByteArray>
+#include <QList>
+#include <memory>
+#include <vector>
+
+// One open editor document, kept scanned and parsed between edits.
+//
+// The token list covers the whole text. The program is split into segments:
+// runs of tokens between top-level ';' separators (those outside every
+// if...end and repeat...until), each parsed into its own FlatAst with its
+// own symbols and errors. An edit re-scans from the last token before it
+// until the new tokens line up with the old ones again, and re-parses only
+// the segments that overlap the re-scanned stretch; everything after just
+// moves. Results of untouched segments are reused as they are.
+//
+// Positions are UTF-8 byte offsets; offsetAt()/positionAt() convert to and
+// from LSP line/character positions, where characters are UTF-16 units.
+class LspDocument {
+public:
+    // Semantic token types, in the order of the legend the server announces
+    enum SemanticType { KeywordToken, VariableToken, NumberToken, OperatorToken, SemanticTypeCount };
+    static const char *const SemanticTypeNames[SemanticTypeCount];
+
+    struct Problem {
+        qsizetype offset;
+        qsizetype length;   // Bytes the problem covers, at least one character
+        QString message;
+    };
+
+    struct Variable {
+        QString name;
+        qsizetype firstDefinition;  // First assignment or read, -1 if never assigned
+        qsizetype firstUse;         // First use in an expression, -1 if never used
+        int definitions;
+        int uses;
+    };
+
+    explicit LspDocument(const QByteArray &utf8 = QByteArray());
+    ~LspDocument();
+
+    LspDocument(const LspDocument&) = delete;
+    LspDocument& operator=(const LspDocument&) = delete;
+
+    void setText(const QByteArray &utf8);  // Start over with new contents
+    // Replace removed bytes at offset with inserted, updating tokens and trees incrementally
+    void replace(qsizetype offset, qsizetype removed, const QByteArray &inserted);
+
+    const QByteArray &text() const { return source; }
+    const QList<CompactToken> &tokens() const { return tokenList; }
+    qsizetype segmentCount() const { return qsizetype(segments.size()); }
+
+    // LSP positions; out-of-range lines and characters are clamped
+    qsizetype offsetAt(int line, int character) const;
+    void positionAt(qsizetype offset, int &line, int &character) const;
+
+    QList<Problem> problems() const;    // Scan and syntax errors, in source order
+    QList<Variable> variables() const;  // Every identifier, in order of first appearance
+
+    // LSP "textDocument/semanticTokens" data: five integers per token
+    std::vector<quint32> semanticTokens() const;
+
+    // What the last replace() redid, for tracing
+    qsizetype lastRescannedTokens() const { return rescanned; }
+    qsizetype lastReparsedSegments() const { return reparsed; }
+
+private:
+    struct ScanError {
+        qsizetype offset;
+        qsizetype length;
+        QString message;
+    };
+
+    // A run of top-level statements: tokens [first, first + count). Offsets
+    // recorded while parsing are relative to the text at that time; base is
+    // where the segment started then, so adding segmentStart() - base updates them.
+    struct Segment {
+        qsizetype first;
+        qsizetype count;
+        qsizetype base;
+        FlatAst ast;
+        SymbolTable symbols;
+        Diagnostics diagnostics;
+    };
+
+    qsizetype segmentStart(const Segment &segment) const;   // Current byte offset
+    qsizetype segmentEnd(qsizetype first, qsizetype count) const;
+    std::unique_ptr<Segment> parseSegment(qsizetype first, qsizetype count) const;
+    void indexLines();
+    // Re-split tokens from segment index from on and re-parse until the old
+    // segmentation is met again at or after token index stable
+    void resegment(qsizetype from, qsizetype stable, qsizetype tokenDelta);
+
+    QByteArray source;
+    QList<CompactToken> tokenList;
+    QList<ScanError> scanErrors;
+    std::vector<std::unique_ptr<Segment>> segments;
+    std::vector<qsizetype> lineStarts;  // Byte offset of every line
+    qsizetype rescanned = 0;
+    qsizetype reparsed = 0;
+};
+
+#endif // LSPDOCUMENT_H
@@ -0,0 +1,237 @@
+#include "lspserver.h"
+#include "pipelinestats.h"
+#include "trace.h"
+#include <QCoreApplication>
+#include <QJsonDocument>
+#include <algorithm>
+
+namespace {
+
+// JSON-RPC and LSP error codes
+constexpr int ParseErrorCode = -32700;
+constexpr int InvalidRequest = -32600;
+constexpr int MethodNotFound = -32601;
+constexpr int ServerNotInitialized = -32002;
+
+constexpr int SymbolKindVariable = 13;
+constexpr int SeverityError = 1;
+constexpr int SyncIncremental = 2;
+
+} // namespace
+
+int LspServer::run() {
+    QByteArray body;
+    while (!exiting && readMessage(body)) {
+        QJsonParseError error;
+        QJsonDocument message = QJsonDocument::fromJson(body, &error);
+        if (!message.isObject()) {
+            replyError(QJsonValue(), ParseErrorCode, error.errorString());
+            continue;
+        }
+        dispatch(message.object());
+    }
+    // End of input without "exit" counts as the client going away
+    return exiting && shuttingDown ? 0 : 1;
+}
+
+bool LspServer::readMessage(QByteArray &body) {
+    qsizetype length = -1;
+    char line[1024];
+    while (std::fgets(line, sizeof line, input)) {
+        QByteArray header = QByteArray(line).trimmed();
+        if (!header.isEmpty()) {
+            if (header.toLower().startsWith("content-length:")) {
+                length = header.mid(15).trimmed().toLongLong();
+            }
+            continue;
+        }
+        if (length < 0) {
+            continue;   // Stray blank line before a header
+        }
+        body.resize(length);
+        return std::fread(body.data(), 1, size_t(length), input) == size_t(length);
+    }
+    return false;
+}
+
+void LspServer::send(const QJsonObject &message) {
+    QByteArray json = QJsonDocument(message).toJson(QJsonDocument::Compact);
+    std::fprintf(output, "Content-Length: %lld\r\n\r\n", qlonglong(json.size()));
+    std::fwrite(json.constData(), 1, size_t(json.size()), output);
+    std::fflush(output);
+}
+
+void LspServer::reply(const QJsonValue &id, const QJsonValue &result) {
+    send({{"jsonrpc", "2.0"}, {"id", id}, {"result", result}});
+}
+
+void LspServer::replyError(const QJsonValue &id, int code, const QString &message) {
+    QJsonObject error{{"code", code}, {"message", message}};
+    send({{"jsonrpc", "2.0"}, {"id", id.isUndefined() ? QJsonValue() : id}, {"error", error}});
+}
+
+void LspServer::notify(const QString &method, const QJsonObject &params) {
+    send({{"jsonrpc", "2.0"}, {"method", method}, {"params", params}});
+}
+
+void LspServer::dispatch(const QJsonObject &message) {
+    QString method = message.value("method").toString();
+    QJsonObject params = message.value("params").toObject();
+    QJsonValue id = message.value("id");
+    bool request = !id.isUndefined();
+    TINY_TRACE(TraceLevel::Statements) << "lsp" << method;
+
+    if (method == "exit") {
+        exiting = true;
+        return;
+    }
+    if (method == "initialize") {
+        initialized = true;
+        QJsonObject info{{"name", QCoreApplication::applicationName()},
+                         {"version", QCoreApplication::applicationVersion()}};
+        reply(id, QJsonObject{{"capabilities", capabilities()}, {"serverInfo", info}});
+        return;
+    }
+    if (!initialized) {
+        if (request) {
+            replyError(id, ServerNotInitialized, "initialize has not been called");
+        }
+        return;
+    }
+    if (shuttingDown) {
+        if (request) {
+            replyError(id, InvalidRequest, "The server is shutting down");
+        }
+        return;
+    }
+
+    if (method == "shutdown") {
+        shuttingDown = true;
+        documents.clear();
+        reply(id, QJsonValue());
+    } else if (method == "textDocument/didOpen") {
+        didOpen(params);
+    } else if (method == "textDocument/didChange") {
+        didChange(params);
+    } else if (method == "textDocument/didClose") {
+        didClose(params);
+    } else if (method == "textDocument/documentSymbol") {
+        const LspDocument *document = find(params);
+        reply(id, document ? QJsonValue(documentSymbols(*document)) : QJsonValue());
+    } else if (method == "textDocument/semanticTokens/full") {
+        const LspDocument *document = find(params);
+        reply(id, document ? QJsonValue(semanticTokens(*document)) : QJsonValue());
+    } else if (request) {
+        replyError(id, MethodNotFound, QString("Unsupported method: %1").arg(method));
+    }
+    // Other notifications ("initialized", "$/cancelRequest", ...) need nothing
+}
+
+QJsonObject LspServer::capabilities() const {
+    QJsonArray types;
+    for (const char *name : LspDocument::SemanticTypeNames) {
+        types.append(QString(name));
+    }
+    QJsonObject legend{{"tokenTypes", types}, {"tokenModifiers", QJsonArray()}};
+    return QJsonObject{
+        {"textDocumentSync", QJsonObject{{"openClose", true}, {"change", SyncIncremental}}},
+        {"documentSymbolProvider", true},
+        {"semanticTokensProvider", QJsonObject{{"legend", legend}, {"full", true}}},
+    };
+}
+
+void LspServer::didOpen(const QJsonObject &params) {
+    QJsonObject item = params.value("textDocument").toObject();
+    QString uri = item.value("uri").toString();
+    PhaseTimer timer(nullptr, "open");
+    std::unique_ptr<LspDocument> &document = documents[uri];
+    document = std::make_unique<LspDocument>(item.value("text").toString().toUtf8());
+    timer.stop();
+    publishDiagnostics(uri, document.get());
+}
+
+void LspServer::didChange(const QJsonObject &params) {
+    QString uri = params.value("textDocument").toObject().value("uri").toString();
+    LspDocument *document = find(params);
+    if (!document) {
+        return;
+    }
+    PhaseTimer timer(nullptr, "edit");
+    const QJsonArray changes = params.value("contentChanges").toArray();
+    for (const QJsonValue &value : changes) {
+        QJsonObject change = value.toObject();
+        QByteArray text = change.value("text").toString().toUtf8();
+        if (!change.contains("range")) {
+            document->setText(text);
+            continue;
+        }
+        QJsonObject range = change.value("range").toObject();
+        QJsonObject start = range.value("start").toObject();
+        QJsonObject end = range.value("end").toObject();
+        qsizetype from = document->offsetAt(start.value("line").toInt(), start.value("character").toInt());
+        qsizetype to = document->offsetAt(end.value("line").toInt(), end.value("character").toInt());
+        document->replace(from, std::max(to - from, qsizetype(0)), text);
+        TINY_TRACE(TraceLevel::Statements) << "re-scanned" << document->lastRescannedTokens() << "tokens";
+    }
+    timer.stop();
+    publishDiagnostics(uri, document);
+}
+
+void LspServer::didClose(const QJsonObject &params) {
+    QString uri = params.value("textDocument").toObject().value("uri").toString();
+    documents.erase(uri);
+    publishDiagnostics(uri, nullptr);   // Clear what the editor still shows
+}
+
+void LspServer::publishDiagnostics(const QString &uri, const LspDocument *document) {
+    QJsonArray list;
+    if (document) {
+        for (const LspDocument::Problem &problem : document->problems()) {
+            list.append(QJsonObject{{"range", range(*document, problem.offset, problem.offset + problem.length)},
+                                    {"severity", SeverityError},
+                                    {"source", "tiny"},
+                                    {"message", problem.message}});
+        }
+    }
+    notify("textDocument/publishDiagnostics", {{"uri", uri}, {"diagnostics", list}});
+}
+
+QJsonArray LspServer::documentSymbols(const LspDocument &document) const {
+    // One symbol per variable, at its first assign/read target (or first use)
+    QJsonArray list;
+    for (const LspDocument::Variable &variable : document.variables()) {
+        qsizetype at = variable.firstDefinition >= 0 ? variable.firstDefinition : variable.firstUse;
+        QJsonObject where = range(document, at, at + variable.name.toUtf8().size());
+        QString detail = QString("%1 assignments, %2 uses").arg(variable.definitions).arg(variable.uses);
+        list.append(QJsonObject{{"name", variable.name},
+                                {"detail", detail},
+                                {"kind", SymbolKindVariable},
+                                {"range", where},
+                                {"selectionRange", where}});
+    }
+    return list;
+}
+
+QJsonObject LspServer::semanticTokens(const LspDocument &document) const {
+    QJsonArray data;
+    for (quint32 value : document.semanticTokens()) {
+        data.append(qint64(value));
+    }
+    return QJsonObject{{"data", data}};
+}
+
+LspDocument *LspServer::find(const QJsonObject &params) const {
+    auto found = documents.find(params.value("textDocument").toObject().value("uri").toString());
+    return found == documents.end() ? nullptr : found->second.get();
+}
+
+QJsonObject LspServer::position(const LspDocument &document, qsizetype offset) {
+    int line;
+    int character;
+    document.positionAt(offset, line, character);
+    return QJsonObject{{"line", line}, {"character", character}};
+}
+
+QJsonObject LspServer::range(const LspDocument &document, qsizetype from, qsizetype to) {
+    return QJsonObject{{"start", position(document, from)}, {"end", position(document, to)}};
+}
@@ -0,0 +1,52 @@
+#ifndef LSPSERVER_H
+#define LSPSERVER_H
+
+#include "lspdocument.h"
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QJsonValue>
+#include <QString>
+#include <cstdio>
+#include <map>
+#include <memory>
+
+// Language Server Protocol over a pair of streams: JSON-RPC messages framed
+// by Content-Length headers. Every open document stays resident as an
+// LspDocument and is updated in place by incremental changes; diagnostics
+// are published after each change. Positions use UTF-16 characters, the
+// protocol's default encoding.
+class LspServer {
+public:
+    LspServer(FILE *input, FILE *output) : input(input), output(output) {}
+
+    int run();  // Serve until "exit"; returns the exit status the protocol asks for
+
+private:
+    bool readMessage(QByteArray &body);
+    void send(const QJsonObject &message);
+    void reply(const QJsonValue &id, const QJsonValue &result);
+    void replyError(const QJsonValue &id, int code, const QString &message);
+    void notify(const QString &method, const QJsonObject &params);
+
+    void dispatch(const QJsonObject &message);
+    QJsonObject capabilities() const;
+    void didOpen(const QJsonObject &params);
+    void didChange(const QJsonObject &params);
+    void didClose(const QJsonObject &params);
+    void publishDiagnostics(const QString &uri, const LspDocument *document);
+    QJsonArray documentSymbols(const LspDocument &document) const;
+    QJsonObject semanticTokens(const LspDocument &document) const;
+
+    LspDocument *find(const QJsonObject &params) const;  // From params.textDocument.uri
+    static QJsonObject position(const LspDocument &document, qsizetype offset);
+    static QJsonObject range(const LspDocument &document, qsizetype from, qsizetype to);
+
+    FILE *input;
+    FILE *output;
+    std::map<QString, std::unique_ptr<LspDocument>> documents;  // By URI
+    bool initialized = false;
+    bool shuttingDown = false;
+    bool exiting = false;
+};
+
+#endif // LSPSERVER_H
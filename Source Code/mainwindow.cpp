@@ -1,11 +1,18 @@
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
-#include "token.h"
-#include "parser.h"
-#include <QFile>
-#include <QTextStream>
+#include "syntaxtreeitem.h"
+#include "trace.h"
+#include <QMessageBox>
+#include <QWheelEvent>
+#include <algorithm>
+#include <cmath>
+#include <vector>
 
-void runScanner(const QString &input);
+// Trees with more nodes than this are drawn by a single virtualized item
+static const qsizetype DetailedSceneLimit = 2000;
+
+// Live mode waits this long (ms) after the last edit before parsing
+static const int LiveParseDelay = 300;
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent), ui(new Ui::MainWindow), scene(new QGraphicsScene(this)) {
@@ -21,6 +28,17 @@ MainWindow::MainWindow(QWidget *parent)
     ui->graphicsView->setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOn);
     ui->graphicsView->setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOn);
 
+    // Results come back from the worker thread; live mode re-parses once edits pause
+    connect(&worker, &AnalysisWorker::finished, this, &MainWindow::analysisFinished);
+    liveTimer.setSingleShot(true);
+    liveTimer.setInterval(LiveParseDelay);
+    connect(&liveTimer, &QTimer::timeout, this, &MainWindow::on_parser_clicked);
+    connect(ui->input, &QTextEdit::textChanged, this, &MainWindow::inputEdited);
+
+    // Ctrl+wheel zooms around the mouse
+    ui->graphicsView->setTransformationAnchor(QGraphicsView::AnchorUnderMouse);
+    ui->graphicsView->viewport()->installEventFilter(this);
+
 
 
 }
@@ -29,79 +47,161 @@ MainWindow::~MainWindow() {
     delete ui;
 }
 
+bool MainWindow::eventFilter(QObject *watched, QEvent *event) {
+    if (watched == ui->graphicsView->viewport() && event->type() == QEvent::Wheel) {
+        QWheelEvent *wheel = static_cast<QWheelEvent *>(event);
+        if (wheel->modifiers() & Qt::ControlModifier) {
+            qreal factor = std::pow(1.0015, wheel->angleDelta().y());
+            ui->graphicsView->scale(factor, factor);
+            return true;
+        }
+    }
+    return QMainWindow::eventFilter(watched, event);
+}
+
 void MainWindow::on_scan_clicked() {
-    // Get input from the text edit widget
+    // Scanning (and writing output.txt) happens on the worker thread
+    worker.submit(AnalysisResult::Kind::Scan, ui->input->toPlainText());
+    ui->label->setText("Scanning...");
+}
+
+void MainWindow::on_parser_clicked() {
+    liveTimer.stop();
     QString input = ui->input->toPlainText();
 
-    // Run the scanner function
-    runScanner(input);
+    // A parse of exactly this text is already running and will show its tree
+    if (worker.isPending(AnalysisResult::Kind::Parse, input)) {
+        return;
+    }
 
-    // Inform the user that tokenization is complete
-    ui->label->setText("Tokenization complete. Check 'output.txt' for results.");
+    // The tree on screen already belongs to exactly this text. Only a request
+    // for other text is stale; a scan of this text is left to finish.
+    if (shownTree && shownTree->error.isEmpty() && shownTree->source == input.toUtf8()) {
+        if (!worker.isPending(AnalysisResult::Kind::Scan, input)) {
+            worker.cancel();
+        }
+        return;
+    }
+    worker.submit(AnalysisResult::Kind::Parse, input);
+    ui->label->setText("Parsing...");
 }
 
-void runScanner(const QString &input) {
-    QFile file("output.txt"); // Open the file 'output.txt'
+void MainWindow::on_live_toggled(bool checked) {
+    if (checked) {
+        on_parser_clicked();
+    } else {
+        liveTimer.stop();
+    }
+}
 
-    // Tokenize the input text
-    QList<Token> tokens = tokenize(input);
+void MainWindow::inputEdited() {
+    if (ui->live->isChecked()) {
+        liveTimer.start(); // Restarting on every edit parses once typing pauses
+    }
+}
 
-    // Open the file for writing (overwrite the file if it exists)
-    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
-        // Handle the error if the file cannot be opened
-        qCritical() << "Error: Unable to open file 'output.txt' for writing.";
+// Runs on the GUI thread with a finished, current result
+void MainWindow::analysisFinished(std::shared_ptr<AnalysisResult> result) {
+    if (!result->error.isEmpty()) {
+        // Display an error message to the user
+        QMessageBox::critical(this, result->kind == AnalysisResult::Kind::Scan ? "Tokenization Error" : "parsing Error",
+                              result->error);
+        ui->label->setText(result->kind == AnalysisResult::Kind::Scan ? "Tokenization error." : "Parsing error.");
         return;
     }
 
-    // Create a QTextStream to write to the file
-    QTextStream writer(&file);
-
-    // Write each token to the file
-    for (const Token &token : tokens) {
-        writer << token.toString() << Qt::endl;
+    if (result->kind == AnalysisResult::Kind::Scan) {
+        showDiagnostics(result->diagnostics, &result->source);
+        if (!result->outputWritten) {
+            ui->label->setText("Error: Unable to write 'output.txt'.");
+            return;
+        }
+
+        // Inform the user that tokenization is complete
+        if (result->diagnostics.hasErrors()) {
+            showStatus(QString("Tokenization finished with %1 error(s). Check 'output.txt' for results.").arg(result->diagnostics.errorCount()), result->stats);
+        } else {
+            showStatus("Tokenization complete. Check 'output.txt' for results.", result->stats);
+        }
+        return;
     }
 
-    // Close the file after writing
-    file.close();
-}
-void MainWindow::on_parser_clicked() {
-    try {
-        // Clear the scene before proceeding with the new parse
-        scene->clear();
-        QString input = ui->input->toPlainText();
+    showDiagnostics(result->diagnostics, &result->source);
 
-        // Tokenize the input
-        QList<Token> tokens = tokenize(input);
+    // Clear the scene before releasing the tree it draws from
+    scene->clear();
+    shownTree = result;
+    if (!result->tree) {
+        ui->label->setText("Parsing error.");
+        return;
+    }
 
-        // Parse the tokenized input
-        Parser parser(tokens);
-        SyntaxTreeNode* tree = parser.parse();
+    // The layout was computed on the worker; only the scene is built here
+    PhaseTimer sceneTimer(&result->stats, "scene");
+    const TreeLayout &layout = result->layout;
+    if (layout.placements().size() <= DetailedSceneLimit) {
+        addToScene(scene, layout);   // One scene item per node, edge and label
+    } else {
+        scene->addItem(new SyntaxTreeItem(layout)); // Paints only the visible part
+    }
 
-        // Clear the scene
-        scene->clear();
+    // Adjust the scene size to fit the entire tree
+    scene->setSceneRect(layout.bounds().adjusted(-50, -50, 50, 50));
+    sceneTimer.stop();
 
-        // Fixed spacing
-        int xSpacing = 50; // Horizontal spacing
-        int ySpacing = 60; // Vertical spacing
-        int treeWidth = tree->getMaxWidth() * xSpacing; // Calculate tree width
-        int treeHeight = tree->getDepth() * ySpacing;   // Calculate tree height
+    // Notify the user of success
+    if (result->diagnostics.hasErrors()) {
+        showStatus(QString("Parsing finished with %1 error(s). Partial syntax tree visualized.").arg(result->diagnostics.errorCount()), result->stats);
+    } else {
+        showStatus("Parsing complete. Syntax tree visualized.", result->stats);
+    }
+    TINY_TRACE(TraceLevel::Phases) << "Syntax tree visualized.";
+}
 
-        // Add the tree to the scene
-        int x = (treeWidth+100) / 2; // Start at the center
-        tree->addToScene(scene, x, 55, xSpacing, ySpacing);
+// Status line with the run's phase times and sizes after the message
+void MainWindow::showStatus(const QString &message, const PipelineStats &stats) {
+    ui->label->setText(message + "  " + stats.summary());
+}
 
-        // Adjust the scene size to fit the entire tree
-        scene->setSceneRect(0, 0, treeWidth * 50, treeHeight * 50);
+// Fill the diagnostics list. utf8 is the text the offsets refer to when they
+// are byte offsets; they are converted to editor positions for navigation.
+void MainWindow::showDiagnostics(const Diagnostics &diagnostics, const QByteArray *utf8) {
+    ui->diagnostics->clear();
+    const QList<Diagnostic> &items = diagnostics.items();
+    std::vector<qsizetype> positions;
+    std::vector<qsizetype> order;   // Diagnostics to convert, by increasing offset
+    for (qsizetype i = 0; i < items.size(); ++i) {
+        positions.push_back(items[i].offset);
+        if (utf8 && items[i].offset >= 0) {
+            order.push_back(i);
+        }
+    }
+    std::sort(order.begin(), order.end(), [&](qsizetype a, qsizetype b) { return positions[a] < positions[b]; });
+
+    // One pass over the text: only the bytes since the previous offset are decoded
+    qsizetype byte = 0;
+    qsizetype position = 0;
+    for (qsizetype i : order) {
+        qsizetype end = qMin(positions[i], utf8->size());
+        position += QString::fromUtf8(utf8->constData() + byte, end - byte).size();
+        byte = end;
+        positions[i] = position;
+    }
 
-        // Notify the user of success
-        ui->label->setText("Parsing complete. Syntax tree visualized.");
-        qDebug() << "Syntax tree visualized.";
+    for (qsizetype i = 0; i < items.size(); ++i) {
+        QListWidgetItem *item = new QListWidgetItem(items[i].toString(), ui->diagnostics);
+        item->setData(Qt::UserRole, positions[i]);
+    }
+}
 
-        // Clean up the tree memory
-        //delete tree;
-    } catch (const std::runtime_error &e) {
-        // Display an error message to the user
-        ui->label->setText("Parsing error.");
-        qDebug() << "Error:" << e.what();
+// Jump to the reported position in the editor
+void MainWindow::on_diagnostics_itemActivated(QListWidgetItem *item) {
+    qsizetype position = item->data(Qt::UserRole).toLongLong();
+    if (position < 0) {
+        return;
     }
+    QTextCursor cursor = ui->input->textCursor();
+    cursor.setPosition(int(qMin<qsizetype>(position, ui->input->document()->characterCount() - 1)));
+    ui->input->setTextCursor(cursor);
+    ui->input->setFocus();
 }
@@ -3,7 +3,11 @@
 
 #include <QMainWindow>
 #include <QGraphicsView>
-#include "syntaxtree.h"
+#include <QTimer>
+#include "analysisworker.h"
+
+class Diagnostics;
+class QListWidgetItem;
 
 QT_BEGIN_NAMESPACE
 namespace Ui {
@@ -19,13 +23,30 @@ public:
     MainWindow(QWidget *parent = nullptr);
     ~MainWindow();
 
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) override;
+
 private slots:
     void on_scan_clicked();
 
     void on_parser_clicked();
 
+    void on_diagnostics_itemActivated(QListWidgetItem *item);
+
+    void on_live_toggled(bool checked);
+
+    void inputEdited();
+
+    void analysisFinished(std::shared_ptr<AnalysisResult> result);
+
 private:
+    void showDiagnostics(const Diagnostics &diagnostics, const QByteArray *utf8 = nullptr);
+    void showStatus(const QString &message, const PipelineStats &stats);
+
     Ui::MainWindow *ui;
     QGraphicsScene *scene;
+    AnalysisWorker worker;     // Scans, parses and lays out off the GUI thread
+    std::shared_ptr<AnalysisResult> shownTree; // Tree and layout the scene draws from
+    QTimer liveTimer;          // Debounces live re-parsing
 };
 #endif // MAINWINDOW_H
@@ -0,0 +1,472 @@
+#include "optimizer.h"
+#include "bytecode.h"
+#include <QStringList>
+
+bool parseOptimizerPasses(const QString &list, OptimizerOptions &options) {
+    OptimizerOptions chosen;
+    chosen.constantFolding = chosen.constantPropagation = chosen.copyPropagation = false;
+    chosen.branchElimination = chosen.deadStores = false;
+    for (const QString &name : list.split(',', Qt::SkipEmptyParts)) {
+        if (name == "fold") {
+            chosen.constantFolding = true;
+        } else if (name == "constprop") {
+            chosen.constantPropagation = true;
+        } else if (name == "copyprop") {
+            chosen.copyPropagation = true;
+        } else if (name == "branches") {
+            chosen.branchElimination = true;
+        } else if (name == "deadstores") {
+            chosen.deadStores = true;
+        } else {
+            return false;
+        }
+    }
+    options = chosen;
+    return true;
+}
+
+QString OptimizationReport::toString() const {
+    return QString("constant folding: %1 operator(s)\n"
+                   "constant propagation: %2 use(s)\n"
+                   "copy propagation: %3 use(s)\n"
+                   "branch elimination: %4 if(s)\n"
+                   "dead stores: %5 assignment(s)\n")
+        .arg(folded).arg(constantsPropagated).arg(copiesPropagated)
+        .arg(branchesRemoved).arg(deadStoresRemoved);
+}
+
+namespace {
+
+// What is known about a variable at one point of the program
+struct Fact {
+    enum Kind : quint8 { Unknown, Constant, Copy } kind = Unknown;
+    qint64 value = 0;       // Constant
+    quint32 source = 0;     // Copy: the variable copied ...
+    quint32 version = 0;    // ... and how often it had been assigned at the time
+
+    bool operator==(const Fact &other) const {
+        return kind == other.kind && value == other.value && source == other.source && version == other.version;
+    }
+};
+
+class Optimizer {
+public:
+    Optimizer(FlatAst &ast, const OptimizerOptions &options, OptimizationReport &report)
+        : ast(ast), options(options), report(report),
+          facts(ast.identifiers.size()), versions(ast.identifiers.size(), 0) {}
+
+    void propagate(quint32 &first);            // Forward: propagation, folding, branches
+    void removeDeadStores(quint32 &first, std::vector<bool> &live); // Backward
+
+private:
+    bool constant(quint32 index, qint64 &value) const;
+    void makeConstant(quint32 index, qint64 value);
+    bool mayTrap(quint32 index) const;          // Could raise "Division by zero"
+
+    void expression(quint32 index);
+    void fold(quint32 index);                   // An operator whose operands are done
+    void assigned(quint32 variable);            // Forget facts about it and its copies
+    void forgetAssignedIn(quint32 first);
+    void meet(const std::vector<Fact> &other);  // Keep what holds on both paths
+    void collectUses(quint32 index, std::vector<bool> &live) const;
+    void collectAllUses(quint32 first, std::vector<bool> &used) const;
+
+    FlatAst &ast;
+    const OptimizerOptions &options;
+    OptimizationReport &report;
+    std::vector<Fact> facts;        // Indexed by identifier ID
+    std::vector<quint32> versions;  // Assignments seen per variable, so copies of it can expire
+
+    // Working stacks of the expression walks, reused between expressions
+    struct Pending {
+        quint32 index;
+        bool expanded;      // Operands already pushed
+    };
+    std::vector<Pending> pending;
+    mutable std::vector<quint32> unvisited; // mayTrap and collectUses, where order doesn't matter
+
+    // Working stacks of the statement walks, so deep nesting can't exhaust the stack
+    mutable std::vector<quint32> sequences; // Heads still to visit, where order doesn't matter
+
+    struct Step {   // propagate()
+        enum Kind : quint8 { Sequence, ElseBranch, JoinBranches, RepeatCondition } kind;
+        quint32 index;          // The if/repeat to finish
+        quint32 *link;          // Sequence: the link to the next statement
+    };
+    std::vector<Step> steps;
+    std::vector<std::vector<Fact>> savedFacts;  // Per if: facts on entry, then at the end of its then branch
+
+    struct DeadStoreFrame { // removeDeadStores()
+        bool join;          // An if whose branches are done, rather than a sequence
+        quint32 index;      // Join: the if
+        size_t begin, next; // Sequence: its links in links, and the one after the next to visit
+        size_t live;        // Its live set in liveSets (join: the then branch's)
+        size_t elseLive;    // Join: the else branch's live set
+    };
+    std::vector<DeadStoreFrame> frames;
+    std::vector<quint32 *> links;               // Statements with the slot that links to each
+    std::vector<std::vector<bool>> liveSets;
+};
+
+bool Optimizer::constant(quint32 index, qint64 &value) const {
+    if (ast.node(index).kind != NodeKind::Const) {
+        return false;
+    }
+    bool ok = false;
+    value = ast.constantValue(index, &ok);
+    return ok;  // Out-of-range literals are left for the compiler to report
+}
+
+void Optimizer::makeConstant(quint32 index, qint64 value) {
+    AstNode &n = ast.nodes[index];
+    n.kind = NodeKind::Const;
+    n.op = TokenType::UNKNOWN;
+    n.childCount = 0;
+    n.payload = ast.literals.intern(QString::number(value));
+}
+
+// The expression walks are iterative, so deeply parenthesized expressions
+// can't exhaust the stack
+bool Optimizer::mayTrap(quint32 index) const {
+    unvisited.push_back(index);
+    while (!unvisited.empty()) {
+        const AstNode &n = ast.node(unvisited.back());
+        unvisited.pop_back();
+        if (n.kind != NodeKind::Op) {
+            continue;
+        }
+        qint64 divisor;
+        if (n.op == TokenType::DIV && !(constant(n.children[1], divisor) && divisor != 0)) {
+            unvisited.clear();
+            return true;
+        }
+        unvisited.push_back(n.children[1]);
+        unvisited.push_back(n.children[0]);
+    }
+    return false;
+}
+
+// Post-order, so operands are propagated and folded before their operator
+void Optimizer::expression(quint32 index) {
+    pending.push_back({index, false});
+    while (!pending.empty()) {
+        Pending item = pending.back();
+        AstNode &n = ast.nodes[item.index];
+        if (n.kind == NodeKind::Id) {
+            const Fact &fact = facts[n.payload];
+            if (fact.kind == Fact::Constant && options.constantPropagation) {
+                makeConstant(item.index, fact.value);
+                report.constantsPropagated++;
+            } else if (fact.kind == Fact::Copy && options.copyPropagation && versions[fact.source] == fact.version) {
+                n.payload = fact.source;
+                report.copiesPropagated++;
+            }
+        } else if (n.kind == NodeKind::Op && !item.expanded) {
+            pending.back().expanded = true;
+            pending.push_back({n.children[1], false});
+            pending.push_back({n.children[0], false});
+            continue;
+        } else if (n.kind == NodeKind::Op) {
+            fold(item.index);
+        }
+        pending.pop_back();
+    }
+}
+
+void Optimizer::fold(quint32 index) {
+    const AstNode &n = ast.node(index);
+    qint64 left, right;
+    if (!options.constantFolding || !constant(n.children[0], left) || !constant(n.children[1], right)) {
+        return;
+    }
+    qint64 value;
+    switch (n.op) {
+    case TokenType::PLUS: value = wrappingAdd(left, right); break;
+    case TokenType::MINUS: value = wrappingSub(left, right); break;
+    case TokenType::MULT: value = wrappingMul(left, right); break;
+    case TokenType::DIV:
+        if (right == 0) {
+            return; // Keep the run-time error
+        }
+        value = wrappingDiv(left, right);
+        break;
+    case TokenType::LESSTHAN: value = left < right; break;
+    default: value = left == right; break;
+    }
+    makeConstant(index, value);
+    report.folded++;
+}
+
+void Optimizer::assigned(quint32 variable) {
+    facts[variable] = Fact();
+    versions[variable]++;
+}
+
+// Everything a loop body assigns may differ on the next iteration
+void Optimizer::forgetAssignedIn(quint32 first) {
+    sequences.push_back(first);
+    while (!sequences.empty()) {
+        quint32 index = sequences.back();
+        sequences.pop_back();
+        for (; index != FlatAst::NoNode; index = ast.node(index).sibling) {
+            const AstNode &n = ast.node(index);
+            switch (n.kind) {
+            case NodeKind::Assign:
+            case NodeKind::Read:
+                assigned(n.payload);
+                break;
+            case NodeKind::If:
+                for (quint32 c = 1; c < n.childCount; ++c) {
+                    sequences.push_back(n.children[c]);
+                }
+                break;
+            case NodeKind::Repeat:
+                sequences.push_back(n.children[0]);
+                break;
+            default:
+                break;
+            }
+        }
+    }
+}
+
+void Optimizer::meet(const std::vector<Fact> &other) {
+    for (size_t i = 0; i < facts.size(); ++i) {
+        if (!(facts[i] == other[i])) {
+            facts[i] = Fact();
+        }
+    }
+}
+
+void Optimizer::propagate(quint32 &first) {
+    steps.push_back({Step::Sequence, FlatAst::NoNode, &first});
+    while (!steps.empty()) {
+        Step step = steps.back();
+        steps.pop_back();
+        if (step.kind == Step::Sequence && *step.link == FlatAst::NoNode) {
+            continue;   // End of a sequence
+        }
+        quint32 index = step.kind == Step::Sequence ? *step.link : step.index;
+        AstNode &n = ast.nodes[index];
+        switch (step.kind) {
+        case Step::Sequence:
+            break;
+        case Step::ElseBranch:
+            if (n.childCount > 2) {
+                std::swap(facts, savedFacts.back());    // Back to the facts on entry
+                steps.push_back({Step::JoinBranches, index, nullptr});
+                steps.push_back({Step::Sequence, FlatAst::NoNode, &n.children[2]});
+            } else {
+                meet(savedFacts.back());
+                savedFacts.pop_back();
+            }
+            continue;
+        case Step::JoinBranches:
+            meet(savedFacts.back());
+            savedFacts.pop_back();
+            continue;
+        case Step::RepeatCondition:
+            expression(n.children[1]);
+            continue;
+        }
+
+        switch (n.kind) {
+        case NodeKind::Assign: {
+            expression(n.children[0]);
+            quint32 target = n.payload;
+            assigned(target);
+            const AstNode &value = ast.node(n.children[0]);
+            qint64 known;
+            if (constant(n.children[0], known)) {
+                facts[target].kind = Fact::Constant;
+                facts[target].value = known;
+            } else if (value.kind == NodeKind::Id && value.payload != target) {
+                facts[target].kind = Fact::Copy;
+                facts[target].source = value.payload;
+                facts[target].version = versions[value.payload];
+            }
+            break;
+        }
+        case NodeKind::Read:
+            assigned(n.payload);
+            break;
+        case NodeKind::Write:
+            expression(n.children[0]);
+            break;
+        case NodeKind::If: {
+            expression(n.children[0]);
+            qint64 condition;
+            if (options.branchElimination && constant(n.children[0], condition)) {
+                // Splice the branch that always runs into this sequence in place
+                // of the if, and carry on from its first statement
+                quint32 taken = condition != 0 ? n.children[1] : (n.childCount > 2 ? n.children[2] : FlatAst::NoNode);
+                quint32 next = n.sibling;
+                if (taken == FlatAst::NoNode) {
+                    *step.link = next;
+                } else {
+                    quint32 last = taken;
+                    while (ast.node(last).sibling != FlatAst::NoNode) {
+                        last = ast.node(last).sibling;
+                    }
+                    ast.nodes[last].sibling = next;
+                    *step.link = taken;
+                }
+                report.branchesRemoved++;
+                steps.push_back(step);
+                continue;
+            }
+            savedFacts.push_back(facts);
+            steps.push_back({Step::Sequence, FlatAst::NoNode, &n.sibling});
+            steps.push_back({Step::ElseBranch, index, nullptr});
+            steps.push_back({Step::Sequence, FlatAst::NoNode, &n.children[1]});
+            continue;
+        }
+        case NodeKind::Repeat:
+            forgetAssignedIn(n.children[0]);
+            steps.push_back({Step::Sequence, FlatAst::NoNode, &n.sibling});
+            steps.push_back({Step::RepeatCondition, index, nullptr});
+            steps.push_back({Step::Sequence, FlatAst::NoNode, &n.children[0]});
+            continue;
+        default:
+            break;
+        }
+        steps.push_back({Step::Sequence, FlatAst::NoNode, &n.sibling});
+    }
+}
+
+void Optimizer::collectUses(quint32 index, std::vector<bool> &live) const {
+    unvisited.push_back(index);
+    while (!unvisited.empty()) {
+        const AstNode &n = ast.node(unvisited.back());
+        unvisited.pop_back();
+        if (n.kind == NodeKind::Id) {
+            live[n.payload] = true;
+        } else if (n.kind == NodeKind::Op) {
+            unvisited.push_back(n.children[1]);
+            unvisited.push_back(n.children[0]);
+        }
+    }
+}
+
+void Optimizer::collectAllUses(quint32 first, std::vector<bool> &used) const {
+    sequences.push_back(first);
+    while (!sequences.empty()) {
+        quint32 index = sequences.back();
+        sequences.pop_back();
+        for (; index != FlatAst::NoNode; index = ast.node(index).sibling) {
+            const AstNode &n = ast.node(index);
+            switch (n.kind) {
+            case NodeKind::Assign:
+            case NodeKind::Write:
+                collectUses(n.children[0], used);
+                break;
+            case NodeKind::If:
+                collectUses(n.children[0], used);
+                for (quint32 c = 1; c < n.childCount; ++c) {
+                    sequences.push_back(n.children[c]);
+                }
+                break;
+            case NodeKind::Repeat:
+                sequences.push_back(n.children[0]);
+                collectUses(n.children[1], used);
+                break;
+            default:
+                break;
+            }
+        }
+    }
+}
+
+// live holds the variables read after the sequence on entry, and those read
+// after its start on return
+void Optimizer::removeDeadStores(quint32 &first, std::vector<bool> &live) {
+    // Walk a sequence backwards from its end, so its links go on the stack first
+    auto enter = [&](quint32 *link, size_t liveSet) {
+        size_t begin = links.size();
+        for (; *link != FlatAst::NoNode; link = &ast.nodes[*link].sibling) {
+            links.push_back(link);
+        }
+        frames.push_back({false, FlatAst::NoNode, begin, links.size(), liveSet, 0});
+    };
+    liveSets.push_back(std::move(live));
+    enter(&first, 0);
+    while (!frames.empty()) {
+        DeadStoreFrame &frame = frames.back();
+        if (frame.join) {
+            std::vector<bool> &thenLive = liveSets[frame.live];
+            const std::vector<bool> &elseLive = liveSets[frame.elseLive];
+            for (size_t v = 0; v < thenLive.size(); ++v) {
+                thenLive[v] = thenLive[v] || elseLive[v];
+            }
+            collectUses(ast.node(frame.index).children[0], thenLive);
+            liveSets.pop_back();    // elseLive, the newest
+            frames.pop_back();
+            continue;
+        }
+        if (frame.next == frame.begin) {
+            links.resize(frame.begin);
+            frames.pop_back();
+            continue;
+        }
+
+        quint32 *link = links[--frame.next];
+        size_t liveSet = frame.live;
+        std::vector<bool> &current = liveSets[liveSet];
+        quint32 index = *link;
+        const AstNode &n = ast.node(index);
+        switch (n.kind) {
+        case NodeKind::Assign:
+            if (!current[n.payload] && !mayTrap(n.children[0])) {
+                *link = n.sibling;
+                report.deadStoresRemoved++;
+                break;
+            }
+            current[n.payload] = false;
+            collectUses(n.children[0], current);
+            break;
+        case NodeKind::Read:
+            current[n.payload] = false;    // Still consumes input, so it stays
+            break;
+        case NodeKind::Write:
+            collectUses(n.children[0], current);
+            break;
+        case NodeKind::If: {
+            // Each branch starts from what is live after the if; the join merges them
+            size_t elseLive = liveSets.size();
+            liveSets.push_back(current);
+            frames.push_back({true, index, 0, 0, liveSet, elseLive});
+            if (n.childCount > 2) {
+                enter(&ast.nodes[index].children[2], elseLive);
+            }
+            enter(&ast.nodes[index].children[1], liveSet);
+            break;
+        }
+        case NodeKind::Repeat:
+            // A store read by any later iteration must stay: treat everything
+            // the loop reads as live at the end of its body
+            collectAllUses(n.children[0], current);
+            collectUses(n.children[1], current);
+            enter(&ast.nodes[index].children[0], liveSet);
+            break;
+        default:
+            break;
+        }
+    }
+    live = std::move(liveSets[0]);
+    liveSets.clear();
+}
+
+} // namespace
+
+OptimizationReport optimizeProgram(FlatAst &ast, const OptimizerOptions &options) {
+    OptimizationReport report;
+    Optimizer optimizer(ast, options, report);
+    if (options.constantFolding || options.constantPropagation || options.copyPropagation || options.branchElimination) {
+        optimizer.propagate(ast.root);
+    }
+    if (options.deadStores) {
+        std::vector<bool> live(ast.identifiers.size(), false); // Only writes are observable
+        optimizer.removeDeadStores(ast.root, live);
+    }
+    return report;
+}
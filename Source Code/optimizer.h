@@ -0,0 +1,38 @@
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include "flatast.h"
+
+// Which passes optimizeProgram runs
+struct OptimizerOptions {
+    bool constantFolding = true;      // 2 * 3 + y  ->  6 + y
+    bool constantPropagation = true;  // x := 4; y := x  ->  y := 4
+    bool copyPropagation = true;      // x := y; z := x  ->  z := y
+    bool branchElimination = true;    // if 1 < 2 then A else B end  ->  A
+    bool deadStores = true;           // Assignments whose value is never read
+};
+
+// Comma-separated pass names: fold, constprop, copyprop, branches, deadstores.
+// Passes not listed are turned off.
+bool parseOptimizerPasses(const QString &list, OptimizerOptions &options);
+
+// What each pass changed
+struct OptimizationReport {
+    int folded = 0;             // Operators replaced by their value
+    int constantsPropagated = 0; // Variable uses replaced by a constant
+    int copiesPropagated = 0;   // Variable uses replaced by the variable they copy
+    int branchesRemoved = 0;    // Ifs replaced by the branch that always runs
+    int deadStoresRemoved = 0;
+
+    QString toString() const;   // One "pass: count" line per pass
+};
+
+// Rewrites a parsed program in place. Constants and copies are tracked
+// through straight-line sequences and merged where control flow joins;
+// anything assigned in a loop is forgotten on entry to it. Nodes are only
+// modified or unlinked, never added, so indices stay valid; unlinked nodes
+// stay in the array. Integer semantics match the VM (wrapping arithmetic),
+// and operations that could divide by zero are never folded or removed.
+OptimizationReport optimizeProgram(FlatAst &ast, const OptimizerOptions &options = OptimizerOptions());
+
+#endif // OPTIMIZER_H
@@ -0,0 +1,178 @@
+#include "parallelparse.h"
+#include "flatast.h"
+#include "parser.h"
+#include "threadpool.h"
+#include "tokenstream.h"
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Below this many tokens per thread, starting threads costs more than it saves
+constexpr qsizetype MinChunkTokens = 64 * 1024;
+
+struct Chunk {
+    qsizetype begin;            // Token range [begin, end), without the ';' around it
+    qsizetype end;
+    FlatAst ast;
+    quint32 last = FlatAst::NoNode; // Last top-level statement, in the chunk's numbering
+    bool failed = false;        // Syntax error: fall back to a sequential parse
+    quint32 nodeOffset = 0;     // Where the chunk's nodes go in the result
+    std::vector<quint32> identifierIds; // Chunk ID -> result ID
+    std::vector<quint32> literalIds;
+};
+
+void parseSequential(const QList<CompactToken> &tokens, const char *source, FlatAst &ast, Diagnostics *diagnostics) {
+    CompactTokenSource stream(tokens, source);
+    Parser parser(stream);
+    parser.setStrategy(Parser::Strategy::ExplicitStack);
+    parser.setDiagnostics(diagnostics);
+    parser.parse(ast);
+}
+
+// Top-level separators at or after each even split point. Returns no cuts if
+// the nesting doesn't balance, which means a syntax error somewhere.
+std::vector<qsizetype> findCuts(const QList<CompactToken> &tokens, int pieces) {
+    std::vector<qsizetype> cuts;
+    qsizetype size = tokens.size();
+    qsizetype next = size / pieces;
+    int depth = 0;
+    for (qsizetype i = 0; i < size; ++i) {
+        switch (tokens[i].type) {
+        case TokenType::IF:
+        case TokenType::REPEAT:
+            depth++;
+            break;
+        case TokenType::END:
+        case TokenType::UNTIL:
+            if (--depth < 0) {
+                return {};
+            }
+            break;
+        case TokenType::SEMICOLON:
+            if (depth == 0 && i >= next && int(cuts.size()) < pieces - 1) {
+                cuts.push_back(i);
+                next = size * qsizetype(cuts.size() + 1) / pieces;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+    if (depth != 0) {
+        return {};
+    }
+    return cuts;
+}
+
+// Copy a chunk's nodes into place, renumbering node indices and payload IDs
+void appendNodes(const Chunk &chunk, AstNode *out) {
+    const QList<AstNode> &nodes = chunk.ast.nodes;
+    for (qsizetype i = 0; i < nodes.size(); ++i) {
+        AstNode node = nodes[i];
+        for (quint16 c = 0; c < node.childCount; ++c) {
+            if (node.children[c] != FlatAst::NoNode) {
+                node.children[c] += chunk.nodeOffset;
+            }
+        }
+        if (node.sibling != FlatAst::NoNode) {
+            node.sibling += chunk.nodeOffset;
+        }
+        switch (node.kind) {
+        case NodeKind::Assign:
+        case NodeKind::Read:
+        case NodeKind::Id:
+            node.payload = chunk.identifierIds[node.payload];
+            break;
+        case NodeKind::Const:
+            node.payload = chunk.literalIds[node.payload];
+            break;
+        default:
+            break;
+        }
+        out[i] = node;
+    }
+}
+
+} // namespace
+
+void parseParallel(const QList<CompactToken> &tokens, const char *source, FlatAst &ast,
+                   Diagnostics *diagnostics, int threads) {
+    if (threads <= 0) {
+        threads = int(std::max(1u, std::thread::hardware_concurrency()));
+    }
+    threads = int(std::min<qsizetype>(threads, tokens.size() / MinChunkTokens));
+    std::vector<qsizetype> cuts;
+    if (threads > 1) {
+        cuts = findCuts(tokens, threads);
+    }
+    if (cuts.empty()) {
+        parseSequential(tokens, source, ast, diagnostics);
+        return;
+    }
+
+    std::vector<Chunk> chunks(cuts.size() + 1);
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        chunks[i].begin = i == 0 ? 0 : cuts[i - 1] + 1;
+        chunks[i].end = i < cuts.size() ? cuts[i] : tokens.size();
+    }
+
+    // Without a diagnostics sink the first syntax error throws, so a chunk
+    // fails fast and the whole program is handed to the sequential parser
+    runConcurrently(int(chunks.size()), [&](int i) {
+        Chunk &chunk = chunks[i];
+        try {
+            CompactTokenSource stream(tokens, source, chunk.begin, chunk.end);
+            Parser parser(stream);
+            parser.setStrategy(Parser::Strategy::ExplicitStack);
+            parser.parse(chunk.ast);
+            chunk.failed = chunk.ast.root == FlatAst::NoNode;
+            for (quint32 node = chunk.ast.root; node != FlatAst::NoNode; node = chunk.ast.nodes[node].sibling) {
+                chunk.last = node;
+            }
+        } catch (const std::exception &) {
+            chunk.failed = true;
+        }
+    });
+    for (const Chunk &chunk : chunks) {
+        if (chunk.failed) {
+            parseSequential(tokens, source, ast, diagnostics);
+            return;
+        }
+    }
+
+    // Interning each chunk's strings in chunk order assigns the IDs a
+    // sequential parse would: in order of first appearance
+    ast.clear();
+    qsizetype total = 0;
+    for (Chunk &chunk : chunks) {
+        chunk.nodeOffset = quint32(total);
+        total += chunk.ast.nodes.size();
+        chunk.identifierIds.resize(size_t(chunk.ast.identifiers.size()));
+        for (qsizetype id = 0; id < chunk.ast.identifiers.size(); ++id) {
+            chunk.identifierIds[size_t(id)] = ast.identifiers.intern(chunk.ast.identifiers.text(quint32(id)));
+        }
+        chunk.literalIds.resize(size_t(chunk.ast.literals.size()));
+        for (qsizetype id = 0; id < chunk.ast.literals.size(); ++id) {
+            chunk.literalIds[size_t(id)] = ast.literals.intern(chunk.ast.literals.text(quint32(id)));
+        }
+    }
+    if (total >= qsizetype(FlatAst::NoNode)) {
+        throw std::runtime_error("Program too large for the flat syntax tree");
+    }
+
+    ast.nodes.resize(total);
+    AstNode *out = ast.nodes.data();
+    runConcurrently(int(chunks.size()), [&](int i) {
+        appendNodes(chunks[i], out + chunks[i].nodeOffset);
+    });
+
+    // Chain the chunks' top-level sequences into one
+    ast.root = chunks.front().ast.root;
+    for (size_t i = 0; i + 1 < chunks.size(); ++i) {
+        ast.nodes[chunks[i].last + chunks[i].nodeOffset].sibling = chunks[i + 1].ast.root + chunks[i + 1].nodeOffset;
+    }
+}
@@ -0,0 +1,22 @@
+#ifndef PARALLELPARSE_H
+#define PARALLELPARSE_H
+
+#include "token.h"
+
+class Diagnostics;
+class FlatAst;
+
+// Parser::parse(FlatAst&) over a scanned program, with the top-level statement
+// sequence split between threads. The token list is cut at top-level ';'
+// separators (those outside every if...end and repeat...until), each run of
+// statements is parsed into its own FlatAst, and the pieces are appended in
+// order with their node indices and interned IDs renumbered. The result is
+// identical to a sequential parse with Parser::Strategy::ExplicitStack.
+//
+// A program with syntax errors is parsed again sequentially, so diagnostics
+// (or the exception, without a sink) are exactly the sequential ones.
+// threads = 0 uses one per core; short programs are parsed on the calling thread.
+void parseParallel(const QList<CompactToken> &tokens, const char *source, FlatAst &ast,
+                   Diagnostics *diagnostics = nullptr, int threads = 0);
+
+#endif // PARALLELPARSE_H
@@ -0,0 +1,137 @@
+#include "parallelscan.h"
+#include "diagnostics.h"
+#include "threadpool.h"
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <thread>
+#include <vector>
+
+// How the chunks are kept independent:
+//
+// - Cuts are moved forward to an ASCII whitespace byte. Whitespace ends every
+//   token and never occurs inside a UTF-8 sequence, so no identifier, number,
+//   ":=" or multi-byte character straddles a cut.
+// - Whether a cut falls inside a { ... } comment only depends on the last
+//   brace before it: after a '{' the scanner is in a comment (a nested '{' is
+//   just comment text), after a '}' it is not (outside a comment a stray '}'
+//   is an unknown character). Each chunk reports its last brace, and a chunk
+//   that starts inside a comment first skips past the closing '}'.
+//
+// Chunk results are then concatenated in order; diagnostics are replayed into
+// the caller's sink, and without one the earliest chunk's error is rethrown.
+
+namespace {
+
+// Below this many bytes per thread, starting threads costs more than it saves
+constexpr qsizetype MinChunkBytes = 256 * 1024;
+
+inline bool isAsciiSpace(char c) { return c == ' ' || (c >= '\t' && c <= '\r'); }
+
+struct Chunk {
+    qsizetype begin;
+    qsizetype end;
+    char lastBrace = 0;             // '{', '}' or 0 if the chunk has none
+    QList<CompactToken> tokens;
+    Diagnostics diagnostics;        // Only used when the caller passed a sink
+    std::exception_ptr error;
+    qsizetype outputOffset = 0;     // Where the chunk's tokens go in the result
+};
+
+char findLastBrace(const char *p, const char *end) {
+    while (end > p) {
+        --end;
+        if (*end == '{' || *end == '}') {
+            return *end;
+        }
+    }
+    return 0;
+}
+
+} // namespace
+
+QList<CompactToken> tokenizeParallel(const char *source, qsizetype size, Diagnostics *diagnostics, int threads) {
+    if (threads <= 0) {
+        threads = int(std::max(1u, std::thread::hardware_concurrency()));
+    }
+    threads = int(std::min<qsizetype>(threads, size / MinChunkBytes));
+    if (threads <= 1) {
+        return tokenizeCompact(source, size, diagnostics);
+    }
+
+    // Cut at whitespace at or after each even split point; a cut that would
+    // run into the next one is dropped, leaving fewer, larger chunks
+    std::vector<Chunk> chunks;
+    qsizetype begin = 0;
+    for (int i = 1; i < threads; ++i) {
+        qsizetype cut = std::max(begin, size * i / threads);
+        while (cut < size && !isAsciiSpace(source[cut])) {
+            ++cut;
+        }
+        if (cut == begin || cut >= size * (i + 1) / threads) {
+            continue;
+        }
+        chunks.push_back(Chunk{begin, cut});
+        begin = cut;
+    }
+    chunks.push_back(Chunk{begin, size});
+
+    runConcurrently(int(chunks.size()), [&](int i) {
+        Chunk &chunk = chunks[i];
+        chunk.lastBrace = findLastBrace(source + chunk.begin, source + chunk.end);
+    });
+
+    runConcurrently(int(chunks.size()), [&](int i) {
+        Chunk &chunk = chunks[i];
+        qsizetype from = chunk.begin;
+
+        // Finish a comment opened in an earlier chunk
+        char before = 0;
+        for (int k = i; k-- > 0 && !before;) {
+            before = chunks[k].lastBrace;
+        }
+        if (before == '{') {
+            const void *close = std::memchr(source + from, '}', size_t(chunk.end - from));
+            if (!close) {
+                return; // The whole chunk is comment
+            }
+            from = static_cast<const char *>(close) - source + 1;
+        }
+
+        try {
+            Lexer lexer(source, size, diagnostics ? &chunk.diagnostics : nullptr);
+            lexer.setRange(from, chunk.end);
+            CompactToken token;
+            while (lexer.next(token)) {
+                chunk.tokens.append(token);
+            }
+        } catch (...) {
+            chunk.error = std::current_exception();
+        }
+    });
+
+    // The earliest failing chunk holds the error a sequential scan stops at
+    qsizetype total = 0;
+    for (Chunk &chunk : chunks) {
+        if (chunk.error) {
+            std::rethrow_exception(chunk.error);
+        }
+        chunk.outputOffset = total;
+        total += chunk.tokens.size();
+    }
+    if (diagnostics) {
+        for (const Chunk &chunk : chunks) {
+            for (const Diagnostic &item : chunk.diagnostics.items()) {
+                diagnostics->error(item.offset, item.message);
+            }
+        }
+    }
+
+    QList<CompactToken> tokens(total);
+    CompactToken *out = tokens.data();
+    runConcurrently(int(chunks.size()), [&](int i) {
+        const Chunk &chunk = chunks[i];
+        std::copy(chunk.tokens.cbegin(), chunk.tokens.cend(), out + chunk.outputOffset);
+    });
+    return tokens;
+}
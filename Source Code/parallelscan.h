@@ -0,0 +1,19 @@
+#ifndef PARALLELSCAN_H
+#define PARALLELSCAN_H
+
+#include "token.h"
+
+class Diagnostics;
+
+// tokenizeCompact() spread over several threads, for inputs too large for one
+// core to scan quickly. The source is cut into one chunk per thread and each
+// chunk is scanned on its own; the result is exactly what tokenizeCompact()
+// returns, with the same diagnostics and the same exception for the first
+// unknown character when there is no sink.
+//
+// threads = 0 uses one per core. Small inputs, or threads = 1, are scanned
+// sequentially on the calling thread.
+QList<CompactToken> tokenizeParallel(const char *source, qsizetype size,
+                                     Diagnostics *diagnostics = nullptr, int threads = 0);
+
+#endif // PARALLELSCAN_H
@@ -1,92 +1,185 @@
 #include "parser.h"
-#include <qmessagebox.h>
+#include "symboltable.h"
+#include "diagnostics.h"
+#include "trace.h"
+#include <stdexcept>
+#include <vector>
 
 
-// Constructor
-Parser::Parser(const QList<Token> &tokens) : tokens(tokens), currentIndex(0) {}
+// Constructors
+Parser::Parser(const QList<Token> &tokens, SyntaxTreeArena &arena)
+    : ownedSource(new ListTokenSource(tokens)), stream(*ownedSource), arena(&arena) {}
+
+Parser::Parser(TokenSource &source, SyntaxTreeArena &arena) : stream(source), arena(&arena) {}
+
+Parser::Parser(TokenSource &source) : stream(source), arena(nullptr) {}
 
 // Helper functions
-Token Parser::currentToken() const {
-    return currentIndex < tokens.size() ? tokens[currentIndex] : Token("", TokenType::UNKNOWN);
+const Token &Parser::currentToken() {
+    return stream.peek();
 }
 
 void Parser::advance() {
-    if (currentIndex < tokens.size()) {
-        currentIndex++;
+    stream.advance();
+}
+
+ParseError::ParseError(const QString &message, qsizetype offset)
+    : std::runtime_error(message.toStdString()), offset(offset) {}
+
+void Parser::fail(const QString &message) {
+    throw ParseError(message, currentToken().offset);
+}
+
+// Called from a catch block. Without a diagnostics sink the error keeps
+// propagating; otherwise it is recorded and the parser skips ahead (panic
+// mode) to a token that can separate or end statements.
+void Parser::recover(const ParseError &error) {
+    if (!diagnostics) {
+        throw;
+    }
+
+    // Report one error per token: the first failure there is the real one,
+    // the rest are its echoes in the enclosing constructs
+    if (currentIndex() != lastErrorIndex) {
+        diagnostics->error(error.offset, QString::fromStdString(error.what()));
+        lastErrorIndex = currentIndex();
     }
+
+    while (!isSynchronizingToken(currentToken().type)) {
+        advance();
+    }
+}
+
+bool Parser::isSynchronizingToken(TokenType type) {
+    return type == TokenType::SEMICOLON || type == TokenType::END || type == TokenType::ELSE ||
+           type == TokenType::UNTIL || type == TokenType::UNKNOWN;
 }
 
 void Parser::match(TokenType expectedType) {
-    qDebug() << "Matching token. Expected:" << Token::tokenTypeToString(expectedType)
+    TINY_TRACE(TraceLevel::Tokens) << "Matching token. Expected:" << Token::tokenTypeToString(expectedType)
     << ", Found:" << currentToken().toString();
 
     if (currentToken().type == expectedType) {
         advance();
     } else {
         QString errorMsg = QString("Unexpected token: '%1', expected: '%2'").arg(currentToken().value).arg(Token::tokenTypeToString(expectedType));
-        QMessageBox::critical(nullptr, "parsing Error", errorMsg);
-        throw std::runtime_error(QString("1Unexpected token: '%1', expected: '%2'")
-                                     .arg(currentToken().value)
-                                     .arg(Token::tokenTypeToString(expectedType))
-                                     .toStdString());
+        fail(errorMsg);
     }
 }
 
 
+quint32 Parser::addIdentifierNode(NodeKind kind) {
+    const Token &token = currentToken();
+    quint32 id = ast->identifiers.intern(token.value);
+    quint32 node = ast->addNode(kind, id);
+    if (symbols) {
+        symbols->record(id, node, token.offset, kind != NodeKind::Id);
+    }
+    return node;
+}
+
 SyntaxTreeNode* Parser::parse() {
-    SyntaxTreeNode* root = parseProgram(); // Use parseProgram as the entry point
+    Q_ASSERT(arena);
+    FlatAst flat;
+    parse(flat);
+    return flat.toSyntaxTree(*arena);
+}
 
-    // Check if there are unparsed tokens remaining
-    if (currentIndex < tokens.size()) {
-        QString errorMsg = QString("Unexpected token: '%1' at position %2. Expected end of input.").arg(currentToken().value).arg(currentIndex);
-        QMessageBox::critical(nullptr, "parsing Error", errorMsg);
-        throw std::runtime_error(
-            QString("2Unexpected token: '%1' at position %2. Expected end of input.")
-                .arg(currentToken().value)
-                .arg(currentIndex)
-                .toStdString()
-            );
+void Parser::parse(FlatAst &result) {
+    result.clear();
+    if (symbols) {
+        symbols->clear();
     }
+    ast = &result;
+    lastErrorIndex = -1;
+    ast->root = parseProgram(); // Use parseProgram as the entry point
 
-    return root;
+    // Check if there are unparsed tokens remaining
+    quint32 last = ast->root;
+    while (!stream.atEnd()) {
+        try {
+            QString errorMsg = QString("Unexpected token: '%1' at position %2. Expected end of input.").arg(currentToken().value).arg(currentIndex());
+            fail(errorMsg);
+        } catch (const ParseError &error) {
+            recover(error);
+        }
+
+        // Recovering: a stray end/else/until closes nothing here, so drop it and keep parsing
+        advance();
+        if (stream.atEnd()) {
+            break;
+        }
+        quint32 more = parseProgram();
+        if (last == FlatAst::NoNode) {
+            ast->root = more;
+        } else {
+            while (ast->nodes[last].sibling != FlatAst::NoNode) {
+                last = ast->nodes[last].sibling;
+            }
+            ast->nodes[last].sibling = more;
+        }
+        if (more != FlatAst::NoNode) {
+            last = more;
+        }
+    }
 }
 
 
 
-SyntaxTreeNode* Parser::parseProgram() {
+quint32 Parser::parseProgram() {
+    if (strategy == Strategy::ExplicitStack) {
+        return parseStmtSequenceIterative();
+    }
     return parseStmtSequence(); // Directly return the parsed statements
 }
 
 
-SyntaxTreeNode* Parser::parseStmtSequence() {
-    SyntaxTreeNode* firstStmt = parseStatement(); // Parse the first statement
-    SyntaxTreeNode* currentStmt = firstStmt;     // Pointer to track the current sibling
+quint32 Parser::parseStmtSequence() {
+    quint32 firstStmt = FlatAst::NoNode;    // First statement of the sequence
+    quint32 currentStmt = FlatAst::NoNode;  // Index of the current sibling
 
-    while (currentToken().type == TokenType::SEMICOLON) {
-        match(TokenType::SEMICOLON);             // Consume the semicolon
-        qDebug() << "current node:" << currentStmt->name ;
-        SyntaxTreeNode* nextStmt = parseStatement(); // Parse the next statement
-        if (currentStmt) {
-            currentStmt->sibling = nextStmt;     // Link the sibling
-            currentStmt = nextStmt;             // Move to the next sibling
-            qDebug() << "sibling node:" << currentStmt->name  ;
+    while (true) {
+        quint32 nextStmt = FlatAst::NoNode;
+        try {
+            nextStmt = parseStatement();         // Parse the next statement
+        } catch (const ParseError &error) {
+            recover(error);                      // A broken statement is left out of the tree
+        }
+        if (nextStmt != FlatAst::NoNode) {
+            if (currentStmt == FlatAst::NoNode) {
+                firstStmt = nextStmt;
+            } else {
+                ast->nodes[currentStmt].sibling = nextStmt; // Link the sibling
+                TINY_TRACE(TraceLevel::Statements) << "sibling node:" << ast->displayName(nextStmt);
+            }
+            currentStmt = nextStmt;              // Move to the next sibling
         }
-    }
 
+        if (currentToken().type == TokenType::SEMICOLON) {
+            match(TokenType::SEMICOLON);         // Consume the semicolon
+            if (currentStmt != FlatAst::NoNode) {
+                TINY_TRACE(TraceLevel::Statements) << "current node:" << ast->displayName(currentStmt);
+            }
+            continue;
+        }
 
-    // If we encounter an unexpected token, throw an error
-    if (currentToken().type != TokenType::END &&
-        currentToken().type != TokenType::ELSE &&
-        currentToken().type != TokenType::UNTIL &&
-        currentToken().type != TokenType::UNKNOWN) {
-        QString errorMsg = QString("Unexpected token in statement sequence: '%1' at position %2").arg(currentToken().value).arg(currentIndex);
-        QMessageBox::critical(nullptr, "parsing Error", errorMsg);
-        throw std::runtime_error(
-            QString("3Unexpected token in statement sequence: '%1' at position %2")
-                .arg(currentToken().value)
-                .arg(currentIndex)
-                .toStdString()
-            );
+        // If we encounter an unexpected token, throw an error
+        if (currentToken().type != TokenType::END &&
+            currentToken().type != TokenType::ELSE &&
+            currentToken().type != TokenType::UNTIL &&
+            currentToken().type != TokenType::UNKNOWN) {
+            try {
+                QString errorMsg = QString("Unexpected token in statement sequence: '%1' at position %2").arg(currentToken().value).arg(currentIndex());
+                fail(errorMsg);
+            } catch (const ParseError &error) {
+                recover(error);
+            }
+            if (currentToken().type == TokenType::SEMICOLON) {
+                match(TokenType::SEMICOLON);     // Resume after the bad stretch
+                continue;
+            }
+        }
+        break;
     }
 
     return firstStmt; // Return the first statement in the sequence
@@ -95,166 +188,381 @@ SyntaxTreeNode* Parser::parseStmtSequence() {
 
 
 
-SyntaxTreeNode* Parser::parseStatement() {
+quint32 Parser::parseStatement() {
     switch (currentToken().type) {
     case TokenType::IF:
         return parseIfStmt();
     case TokenType::REPEAT:
         return parseRepeatStmt();
-    case TokenType::IDENTIFIER:{
-        QString identifier = currentToken().value; // Capture the identifier's value
-        return parseAssignStmt(identifier);
-    }
+    case TokenType::IDENTIFIER:
+        return parseAssignStmt();
     case TokenType::READ:
-    {
-        QString identifier = currentToken().value; // Capture the identifier's value
         return parseReadStmt();
-    }
     case TokenType::WRITE:
         return parseWriteStmt();
     default:
-        QString errorMsg = QString("Unexpected token in statement sequence: '%1' at position %2").arg(currentToken().value).arg(currentIndex);
-        QMessageBox::critical(nullptr, "parsing Error", errorMsg);
-        throw std::runtime_error(
-            QString("4Unexpected token in statement: '%1' at position %2")
-                .arg(currentToken().value)
-                .arg(currentIndex)
-                .toStdString()
-            );
+        QString errorMsg = QString("Unexpected token in statement sequence: '%1' at position %2").arg(currentToken().value).arg(currentIndex());
+        fail(errorMsg);
     }
 }
 
-SyntaxTreeNode* Parser::parseIfStmt() {
-    SyntaxTreeNode* node = new SyntaxTreeNode("if");
+quint32 Parser::parseIfStmt() {
+    quint32 node = ast->addNode(NodeKind::If);
 
     match(TokenType::IF);
-    node->children.append(parseExp());
+    ast->addChild(node, parseExp());
     match(TokenType::THEN);
-    node->children.append(parseStmtSequence());
+    ast->addChild(node, parseStmtSequence());
 
     if (currentToken().type == TokenType::ELSE) {
         match(TokenType::ELSE);
-        node->children.append(parseStmtSequence());
+        ast->addChild(node, parseStmtSequence());
     }
 
     match(TokenType::END);
     return node;
 }
 
-SyntaxTreeNode* Parser::parseRepeatStmt() {
-    SyntaxTreeNode* node = new SyntaxTreeNode("repeat");
+quint32 Parser::parseRepeatStmt() {
+    quint32 node = ast->addNode(NodeKind::Repeat);
 
     match(TokenType::REPEAT);
-    node->children.append(parseStmtSequence());
+    ast->addChild(node, parseStmtSequence());
     match(TokenType::UNTIL);
-    node->children.append(parseExp());
+    ast->addChild(node, parseExp());
 
     return node;
 }
 
 
-SyntaxTreeNode* Parser::parseAssignStmt(QString identifier) {
-    SyntaxTreeNode* node = new SyntaxTreeNode(QString("assign (%1)").arg(identifier));
-    //node->children.append(new SyntaxTreeNode(currentToken().value)); // Identifier
+quint32 Parser::parseAssignStmt() {
+    quint32 node = addIdentifierNode(NodeKind::Assign);
     match(TokenType::IDENTIFIER);
     match(TokenType::ASSIGN);
-    node->children.append(parseExp());
+    ast->addChild(node, parseExp());
 
     return node;
 }
 
-SyntaxTreeNode* Parser::parseReadStmt() {
+quint32 Parser::parseReadStmt() {
     match(TokenType::READ);
-    SyntaxTreeNode* node = new SyntaxTreeNode(QString("read (%1)").arg(currentToken().value));
-    //node->children.append(new SyntaxTreeNode(currentToken().value)); // Identifier
+    quint32 node = addIdentifierNode(NodeKind::Read);
     match(TokenType::IDENTIFIER);
 
     return node;
 }
 
-SyntaxTreeNode* Parser::parseWriteStmt() {
-    SyntaxTreeNode* node = new SyntaxTreeNode("write");
+quint32 Parser::parseWriteStmt() {
+    quint32 node = ast->addNode(NodeKind::Write);
 
     match(TokenType::WRITE);
-    node->children.append(parseExp());
+    ast->addChild(node, parseExp());
 
     return node;
 }
 
-SyntaxTreeNode* Parser::parseExp() {
-    SyntaxTreeNode* node = parseSimpleExp();
+quint32 Parser::parseExp() {
+    quint32 node = parseSimpleExp();
 
     if (currentToken().type == TokenType::LESSTHAN || currentToken().type == TokenType::EQUAL) {
-        SyntaxTreeNode* compNode = parseComparisonOp();
-        compNode->children.append(node);
-        compNode->children.append(parseSimpleExp());
+        quint32 compNode = parseComparisonOp();
+        ast->addChild(compNode, node);
+        ast->addChild(compNode, parseSimpleExp());
         node = compNode;
     }
     return node;
 }
 
-SyntaxTreeNode* Parser::parseSimpleExp() {
-    SyntaxTreeNode* node = parseTerm();
+quint32 Parser::parseSimpleExp() {
+    quint32 node = parseTerm();
 
     while (currentToken().type == TokenType::PLUS || currentToken().type == TokenType::MINUS) {
-        SyntaxTreeNode* opNode = parseAddOp();
-        opNode->children.append(node);
-        opNode->children.append(parseTerm());
+        quint32 opNode = parseAddOp();
+        ast->addChild(opNode, node);
+        ast->addChild(opNode, parseTerm());
         node = opNode;
     }
 
     return node;
 }
 
-SyntaxTreeNode* Parser::parseTerm() {
-    SyntaxTreeNode* node = parseFactor();
+quint32 Parser::parseTerm() {
+    quint32 node = parseFactor();
 
     while (currentToken().type == TokenType::MULT || currentToken().type == TokenType::DIV) {
-        SyntaxTreeNode* opNode = parseMulOp();
-        opNode->children.append(node);
-        opNode->children.append(parseFactor());
+        quint32 opNode = parseMulOp();
+        ast->addChild(opNode, node);
+        ast->addChild(opNode, parseFactor());
         node = opNode;
     }
 
     return node;
 }
 
-SyntaxTreeNode* Parser::parseFactor() {
+quint32 Parser::parseFactor() {
     if (currentToken().type == TokenType::OPENBRACKET) {
         match(TokenType::OPENBRACKET);
-        SyntaxTreeNode* node = parseExp();
+        quint32 node = parseExp();
         match(TokenType::CLOSEDBRACKET);
         return node;
-    } else if (currentToken().type == TokenType::NUMBER || currentToken().type == TokenType::IDENTIFIER) {
-        SyntaxTreeNode* node = new SyntaxTreeNode(currentToken().value);
+    } else if (currentToken().type == TokenType::NUMBER) {
+        quint32 node = ast->addNode(NodeKind::Const, ast->literals.intern(currentToken().value));
+        match(currentToken().type);
+        return node;
+    } else if (currentToken().type == TokenType::IDENTIFIER) {
+        quint32 node = addIdentifierNode(NodeKind::Id);
         match(currentToken().type);
         return node;
     } else {
-        QString errorMsg = QString("Unexpected token in factor: '%1' at position %2").arg(currentToken().value).arg(currentIndex);
-        QMessageBox::critical(nullptr, "parsing Error", errorMsg);
-        throw std::runtime_error(
-            QString("6Unexpected token in factor: '%1' at position %2")
-                .arg(currentToken().value)
-                .arg(currentIndex)
-                .toStdString()
-            );
+        QString errorMsg = QString("Unexpected token in factor: '%1' at position %2").arg(currentToken().value).arg(currentIndex());
+        fail(errorMsg);
     }
 }
 
-SyntaxTreeNode* Parser::parseComparisonOp() {
-    SyntaxTreeNode* node = new SyntaxTreeNode(currentToken().value);
+quint32 Parser::parseComparisonOp() {
+    quint32 node = ast->addNode(NodeKind::Op, 0, currentToken().type);
     match(currentToken().type);
     return node;
 }
 
-SyntaxTreeNode* Parser::parseAddOp() {
-    SyntaxTreeNode* node = new SyntaxTreeNode(currentToken().value);
+quint32 Parser::parseAddOp() {
+    quint32 node = ast->addNode(NodeKind::Op, 0, currentToken().type);
     match(currentToken().type);
     return node;
 }
 
-SyntaxTreeNode* Parser::parseMulOp() {
-    SyntaxTreeNode* node = new SyntaxTreeNode(currentToken().value);
+quint32 Parser::parseMulOp() {
+    quint32 node = ast->addNode(NodeKind::Op, 0, currentToken().type);
     match(currentToken().type);
     return node;
 }
+
+
+// ---------------------------------------------------------------------------
+// ExplicitStack strategy: same grammar, same node order and the same errors as
+// the recursive functions above, but nesting lives in std::vectors.
+
+namespace {
+
+int binaryPrecedence(TokenType type) {
+    switch (type) {
+    case TokenType::LESSTHAN:
+    case TokenType::EQUAL: return 1;
+    case TokenType::PLUS:
+    case TokenType::MINUS: return 2;
+    case TokenType::MULT:
+    case TokenType::DIV: return 3;
+    default: return 0;
+    }
+}
+
+} // namespace
+
+quint32 Parser::parseSimpleStatement() {
+    switch (currentToken().type) {
+    case TokenType::IDENTIFIER: {
+        quint32 node = addIdentifierNode(NodeKind::Assign);
+        match(TokenType::IDENTIFIER);
+        match(TokenType::ASSIGN);
+        ast->addChild(node, parseExpIterative());
+        return node;
+    }
+    case TokenType::READ:
+        return parseReadStmt();
+    default: { // WRITE
+        quint32 node = ast->addNode(NodeKind::Write);
+        match(TokenType::WRITE);
+        ast->addChild(node, parseExpIterative());
+        return node;
+    }
+    }
+}
+
+quint32 Parser::parseStmtSequenceIterative() {
+    // One frame per open construct; a Sequence frame sits above each If/Repeat
+    enum class FrameKind { Sequence, IfThen, IfElse, Repeat };
+    struct Frame {
+        FrameKind kind;
+        quint32 node;   // If/Repeat node, or the last statement of a Sequence
+        quint32 first;  // First statement of a Sequence
+    };
+    std::vector<Frame> frames;
+    frames.push_back({FrameKind::Sequence, FlatAst::NoNode, FlatAst::NoNode});
+
+    while (true) {
+        // Start a statement: compound ones open a frame, simple ones finish at once
+        quint32 stmt = FlatAst::NoNode;
+        try {
+            switch (currentToken().type) {
+            case TokenType::IF:
+                stmt = ast->addNode(NodeKind::If);
+                match(TokenType::IF);
+                ast->addChild(stmt, parseExpIterative());
+                match(TokenType::THEN);
+                frames.push_back({FrameKind::IfThen, stmt, FlatAst::NoNode});
+                frames.push_back({FrameKind::Sequence, FlatAst::NoNode, FlatAst::NoNode});
+                continue;
+            case TokenType::REPEAT:
+                stmt = ast->addNode(NodeKind::Repeat);
+                match(TokenType::REPEAT);
+                frames.push_back({FrameKind::Repeat, stmt, FlatAst::NoNode});
+                frames.push_back({FrameKind::Sequence, FlatAst::NoNode, FlatAst::NoNode});
+                continue;
+            case TokenType::IDENTIFIER:
+            case TokenType::READ:
+            case TokenType::WRITE:
+                stmt = parseSimpleStatement();
+                break;
+            default: {
+                QString errorMsg = QString("Unexpected token in statement sequence: '%1' at position %2").arg(currentToken().value).arg(currentIndex());
+                fail(errorMsg);
+            }
+            }
+        } catch (const ParseError &error) {
+            recover(error);     // A broken statement is left out of the tree
+            stmt = FlatAst::NoNode;
+        }
+
+        // A statement is complete: link it into the innermost sequence, and
+        // close every construct whose sequence ends here
+        while (true) {
+            Frame &sequence = frames.back();
+            if (stmt == FlatAst::NoNode) {
+                // Nothing to link after an error
+            } else if (sequence.first == FlatAst::NoNode) {
+                sequence.first = stmt;
+                sequence.node = stmt;
+            } else {
+                ast->nodes[sequence.node].sibling = stmt;
+                TINY_TRACE(TraceLevel::Statements) << "sibling node:" << ast->displayName(stmt);
+                sequence.node = stmt;
+            }
+
+            if (currentToken().type == TokenType::SEMICOLON) {
+                match(TokenType::SEMICOLON);
+                if (stmt != FlatAst::NoNode) {
+                    TINY_TRACE(TraceLevel::Statements) << "current node:" << ast->displayName(stmt);
+                }
+                break; // Next statement of the same sequence
+            }
+
+            if (currentToken().type != TokenType::END &&
+                currentToken().type != TokenType::ELSE &&
+                currentToken().type != TokenType::UNTIL &&
+                currentToken().type != TokenType::UNKNOWN) {
+                try {
+                    QString errorMsg = QString("Unexpected token in statement sequence: '%1' at position %2").arg(currentToken().value).arg(currentIndex());
+                    fail(errorMsg);
+                } catch (const ParseError &error) {
+                    recover(error);
+                }
+                if (currentToken().type == TokenType::SEMICOLON) {
+                    match(TokenType::SEMICOLON);
+                    stmt = FlatAst::NoNode;
+                    break; // Resume after the bad stretch
+                }
+            }
+
+            quint32 first = sequence.first;
+            frames.pop_back();
+            if (frames.empty()) {
+                return first; // End of the program's sequence
+            }
+
+            Frame &owner = frames.back();
+            ast->addChild(owner.node, first);
+            if (owner.kind == FrameKind::IfThen && currentToken().type == TokenType::ELSE) {
+                match(TokenType::ELSE);
+                owner.kind = FrameKind::IfElse;
+                frames.push_back({FrameKind::Sequence, FlatAst::NoNode, FlatAst::NoNode});
+                break; // Parse the else sequence
+            }
+            try {
+                if (owner.kind == FrameKind::Repeat) {
+                    match(TokenType::UNTIL);
+                    ast->addChild(owner.node, parseExpIterative());
+                } else {
+                    match(TokenType::END);
+                }
+                stmt = owner.node;
+            } catch (const ParseError &error) {
+                recover(error);  // The unfinished If/Repeat is dropped, as in the recursive parser
+                stmt = FlatAst::NoNode;
+            }
+            frames.pop_back(); // The If/Repeat is now a finished statement of the enclosing sequence
+        }
+    }
+}
+
+quint32 Parser::parseExpIterative() {
+    // Operator nodes are created when their token is consumed, exactly as in
+    // parseAddOp()/parseMulOp(), and get their operands when reduced.
+    struct Level {
+        size_t operandBase;
+        size_t operatorBase;
+        bool comparisonSeen;  // exp allows a single comparison per level
+    };
+    std::vector<quint32> operands;
+    std::vector<quint32> operators;
+    std::vector<Level> levels;
+    levels.push_back({0, 0, false});
+
+    auto reduce = [&]() {
+        quint32 op = operators.back();
+        operators.pop_back();
+        quint32 right = operands.back();
+        operands.pop_back();
+        ast->addChild(op, operands.back());
+        ast->addChild(op, right);
+        operands.back() = op;
+    };
+
+    while (true) {
+        // Operand position: open parentheses, then a number or identifier
+        while (currentToken().type == TokenType::OPENBRACKET) {
+            match(TokenType::OPENBRACKET);
+            levels.push_back({operands.size(), operators.size(), false});
+        }
+        if (currentToken().type == TokenType::NUMBER) {
+            operands.push_back(ast->addNode(NodeKind::Const, ast->literals.intern(currentToken().value)));
+            match(currentToken().type);
+        } else if (currentToken().type == TokenType::IDENTIFIER) {
+            operands.push_back(addIdentifierNode(NodeKind::Id));
+            match(currentToken().type);
+        } else {
+            QString errorMsg = QString("Unexpected token in factor: '%1' at position %2").arg(currentToken().value).arg(currentIndex());
+            fail(errorMsg);
+        }
+
+        // Operator position: continue this level, or close parentheses
+        while (true) {
+            Level &level = levels.back();
+            TokenType type = currentToken().type;
+            int precedence = binaryPrecedence(type);
+            if (precedence == 1 && level.comparisonSeen) {
+                precedence = 0; // A second comparison ends the expression
+            }
+
+            if (precedence > 0) {
+                while (operators.size() > level.operatorBase &&
+                       binaryPrecedence(ast->nodes[operators.back()].op) >= precedence) {
+                    reduce();
+                }
+                level.comparisonSeen = level.comparisonSeen || precedence == 1;
+                operators.push_back(ast->addNode(NodeKind::Op, 0, type));
+                match(type);
+                break; // Back to operand position
+            }
+
+            // This level's expression is complete
+            while (operators.size() > level.operatorBase) {
+                reduce();
+            }
+            if (levels.size() == 1) {
+                return operands.back();
+            }
+            levels.pop_back();
+            match(TokenType::CLOSEDBRACKET); // The parenthesized exp is now a factor
+        }
+    }
+}
@@ -2,38 +2,91 @@
 #define PARSER_H
 
 #include "token.h"
+#include "tokenstream.h"
 #include "syntaxtree.h"
+#include "flatast.h"
 #include <QList>
 #include <QDebug>
+#include <memory>
+#include <stdexcept>
+
+class Diagnostics;
+class SymbolTable;
+
+// Thrown for a syntax error; offset locates the offending token in the source (-1 at end of input)
+class ParseError : public std::runtime_error {
+public:
+    ParseError(const QString &message, qsizetype offset);
+    qsizetype offset;
+};
 
 class Parser {
 public:
-    explicit Parser(const QList<Token> &tokens);
-    SyntaxTreeNode* parse();
+    // How nesting is parsed. ExplicitStack builds the same tree without using a
+    // C++ frame per nesting level, so depth is limited only by the heap.
+    enum class Strategy { RecursiveDescent, ExplicitStack };
+
+    // Display-tree nodes are allocated from the arena and live until it is reset or destroyed
+    Parser(const QList<Token> &tokens, SyntaxTreeArena &arena);
+    Parser(TokenSource &source, SyntaxTreeArena &arena);  // Pulls tokens on demand; source must outlive the parser
+    explicit Parser(TokenSource &source);                 // For parse(FlatAst&) only
+
+    SyntaxTreeNode* parse();    // Parse and build the display tree in the arena
+    void parse(FlatAst &ast);   // Parse into the flat AST only
+
+    void setStrategy(Strategy value) { strategy = value; }
+
+    // With a sink, syntax errors are recorded there and parsing resumes at the
+    // next statement, so parse() returns a partial tree instead of throwing
+    void setDiagnostics(Diagnostics *sink) { diagnostics = sink; }
+
+    // With a table, parse(FlatAst&) clears it and records every identifier
+    // occurrence (position, definition or use) under its interned ID
+    void setSymbols(SymbolTable *table) { symbols = table; }
+
+    // Tokens consumed so far; after parse(), the number of tokens in the input
+    int tokenCount() const { return stream.position(); }
 
 private:
-    QList<Token> tokens;
-    int currentIndex;
+    std::unique_ptr<TokenSource> ownedSource; // Set when constructed from a token list
+    TokenStream stream;
+    SyntaxTreeArena *arena;
+    FlatAst *ast = nullptr;     // Tree being built by parse()
+    Strategy strategy = Strategy::RecursiveDescent;
+    Diagnostics *diagnostics = nullptr;
+    SymbolTable *symbols = nullptr;
+    int lastErrorIndex = -1;    // Token of the last recorded error
 
-    Token currentToken() const;
+    const Token &currentToken();
+    int currentIndex() const { return stream.position(); }
     void advance();
 
+    [[noreturn]] void fail(const QString &message);
+    void recover(const ParseError &error);
+    static bool isSynchronizingToken(TokenType type);
+
     void match(TokenType expectedType);
-    SyntaxTreeNode* parseProgram();       // program -> stmt-sequence
-    SyntaxTreeNode* parseStmtSequence(); // stmt-sequence -> statement {; statement}
-    SyntaxTreeNode* parseStatement();    // statement -> if-stmt | repeat-stmt | ...
-    SyntaxTreeNode* parseIfStmt();       // if-stmt -> if exp then stmt-sequence ...
-    SyntaxTreeNode* parseRepeatStmt();   // repeat-stmt -> repeat stmt-sequence ...
-    SyntaxTreeNode* parseAssignStmt(QString identifier);   // assign-stmt -> identifier := exp
-    SyntaxTreeNode* parseReadStmt();     // read-stmt -> read identifier
-    SyntaxTreeNode* parseWriteStmt();    // write-stmt -> write exp
-    SyntaxTreeNode* parseExp();          // exp -> simple-exp comparison-op ...
-    SyntaxTreeNode* parseSimpleExp();    // simple-exp -> term {addop term}
-    SyntaxTreeNode* parseTerm();         // term -> factor {mulop factor}
-    SyntaxTreeNode* parseFactor();       // factor -> (exp) | number | identifier
-    SyntaxTreeNode* parseComparisonOp(); // comparison-op -> < | =
-    SyntaxTreeNode* parseAddOp();        // addop -> + | -
-    SyntaxTreeNode* parseMulOp();        // mulop -> * | /
+    quint32 addIdentifierNode(NodeKind kind); // Assign/Read/Id node for the current token
+    quint32 parseProgram();       // program -> stmt-sequence
+    quint32 parseStmtSequence(); // stmt-sequence -> statement {; statement}
+    quint32 parseStatement();    // statement -> if-stmt | repeat-stmt | ...
+    quint32 parseIfStmt();       // if-stmt -> if exp then stmt-sequence ...
+    quint32 parseRepeatStmt();   // repeat-stmt -> repeat stmt-sequence ...
+    quint32 parseAssignStmt();   // assign-stmt -> identifier := exp
+    quint32 parseReadStmt();     // read-stmt -> read identifier
+    quint32 parseWriteStmt();    // write-stmt -> write exp
+    quint32 parseExp();          // exp -> simple-exp comparison-op ...
+    quint32 parseSimpleExp();    // simple-exp -> term {addop term}
+    quint32 parseTerm();         // term -> factor {mulop factor}
+    quint32 parseFactor();       // factor -> (exp) | number | identifier
+    quint32 parseComparisonOp(); // comparison-op -> < | =
+    quint32 parseAddOp();        // addop -> + | -
+    quint32 parseMulOp();        // mulop -> * | /
+
+    // ExplicitStack strategy
+    quint32 parseStmtSequenceIterative(); // if/repeat nesting kept on a work stack
+    quint32 parseExpIterative();          // precedence climbing, parentheses on a stack
+    quint32 parseSimpleStatement();       // assign | read | write
 
 };
 
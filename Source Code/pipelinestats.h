@@ -0,0 +1,59 @@
+#ifndef PIPELINESTATS_H
+#define PIPELINESTATS_H
+
+#include "token.h"
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include <QList>
+#include <QString>
+
+class FlatAst;
+class SyntaxTreeArena;
+class TreeLayout;
+
+// Where one run of the pipeline spent its time, and how much it built:
+// wall time per phase plus counts of tokens, nodes, bytes and layout items.
+// Cheap enough to collect on every run, in release builds too.
+struct PipelineStats {
+    struct Phase {
+        QString name;
+        qint64 nanoseconds;
+    };
+
+    QList<Phase> phases;        // In the order each phase first ran
+    qint64 tokensScanned = 0;
+    qint64 nodesAllocated = 0;  // Flat AST nodes plus display tree nodes
+    qint64 bytesAllocated = 0;  // Capacity held by token lists, trees and layouts
+    qint64 layoutItems = 0;
+
+    void addPhase(const QString &name, qint64 nanoseconds); // Adds to a phase already listed
+    void addTokens(const QList<CompactToken> &tokens);
+    void addAst(const FlatAst &ast);
+    void addTree(const SyntaxTreeArena &arena);
+    void addLayout(const TreeLayout &layout);
+    void merge(const PipelineStats &other);  // Sum of both, e.g. over a batch of files
+
+    qint64 totalNanoseconds() const;
+    QString summary() const;     // One line for a status bar
+    QJsonObject toJson() const;
+};
+
+// Adds the time from construction to stop() (or the end of the scope) to
+// stats as the named phase. Nothing is recorded when stats is null.
+class PhaseTimer {
+public:
+    PhaseTimer(PipelineStats *stats, const QString &name);
+    ~PhaseTimer() { stop(); }
+
+    PhaseTimer(const PhaseTimer&) = delete;
+    PhaseTimer& operator=(const PhaseTimer&) = delete;
+
+    void stop();
+
+private:
+    PipelineStats *stats;
+    QString name;
+    QElapsedTimer timer;
+};
+
+#endif // PIPELINESTATS_H
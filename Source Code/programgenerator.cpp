@@ -0,0 +1,170 @@
+#include "programgenerator.h"
+#include <QStringList>
+
+bool parseStatementMix(const QString &text, GeneratorOptions &options) {
+    GeneratorOptions chosen = options;
+    for (const QString &item : text.split(',', Qt::SkipEmptyParts)) {
+        QStringList parts = item.split('=');
+        bool ok = false;
+        int weight = parts.size() == 2 ? parts[1].toInt(&ok) : 0;
+        if (!ok || weight < 0) {
+            return false;
+        }
+        if (parts[0] == "assign") {
+            chosen.assignWeight = weight;
+        } else if (parts[0] == "read") {
+            chosen.readWeight = weight;
+        } else if (parts[0] == "write") {
+            chosen.writeWeight = weight;
+        } else if (parts[0] == "if") {
+            chosen.ifWeight = weight;
+        } else if (parts[0] == "repeat") {
+            chosen.repeatWeight = weight;
+        } else {
+            return false;
+        }
+    }
+    if (chosen.assignWeight + chosen.readWeight + chosen.writeWeight + chosen.ifWeight + chosen.repeatWeight == 0) {
+        return false;
+    }
+    options = chosen;
+    return true;
+}
+
+qint64 parseByteSize(const QString &text) {
+    qint64 scale = 1;
+    QString digits = text.trimmed().toUpper();
+    if (digits.endsWith("K")) {
+        scale = qint64(1) << 10;
+    } else if (digits.endsWith("M")) {
+        scale = qint64(1) << 20;
+    } else if (digits.endsWith("G")) {
+        scale = qint64(1) << 30;
+    }
+    if (scale > 1) {
+        digits.chop(1);
+    }
+    bool ok = false;
+    qint64 value = digits.toLongLong(&ok);
+    return ok && value > 0 ? value * scale : -1;
+}
+
+ProgramGenerator::ProgramGenerator(const GeneratorOptions &options) : options(options), rng(options.seed) {
+    // Identifiers are letters only: "va", "vb", ..., "vba", ...; none is a keyword
+    for (int i = 0; i < qMax(1, options.variables); ++i) {
+        QByteArray name = "v";
+        int n = i;
+        do {
+            name += char('a' + n % 26);
+            n /= 26;
+        } while (n > 0);
+        names.push_back(name);
+    }
+}
+
+QByteArray ProgramGenerator::generate() {
+    out.clear();
+    out.reserve(options.targetBytes + 4096);
+    statements = 0;
+    bool first = true;
+    while (first || out.size() < options.targetBytes) {
+        if (!first) {
+            out += ";\n";
+        }
+        first = false;
+        statement(0);
+    }
+    out += '\n';
+    return out;
+}
+
+void ProgramGenerator::comment() {
+    static const char *const words[] = {"compute", "the", "next", "value", "loop", "until", "done", "check"};
+    out += '{';
+    for (int i = 0, n = 1 + below(6); i < n; ++i) {
+        out += ' ';
+        out += words[below(8)];
+    }
+    out += " }\n";
+}
+
+void ProgramGenerator::sequence(int nesting) {
+    for (int i = 0, n = 1 + below(4); i < n; ++i) {
+        if (i > 0) {
+            out += ";\n";
+        }
+        statement(nesting);
+    }
+}
+
+void ProgramGenerator::statement(int nesting) {
+    if (options.commentDensity > 0 && chance(options.commentDensity)) {
+        comment();
+    }
+    statements++;
+
+    // Compound statements only while nesting allows
+    int compound = nesting < options.maxNesting ? options.ifWeight + options.repeatWeight : 0;
+    int simple = options.assignWeight + options.readWeight + options.writeWeight;
+    int assignWeight = options.assignWeight;
+    if (simple + compound == 0) {
+        simple = assignWeight = 1; // Only compound kinds, at the nesting limit
+    }
+    int pick = below(simple + compound);
+
+    if (pick < assignWeight) {
+        out += names[below(int(names.size()))];
+        out += " := ";
+        expression(0);
+    } else if ((pick -= assignWeight) < options.readWeight) {
+        out += "read ";
+        out += names[below(int(names.size()))];
+    } else if ((pick -= options.readWeight) < options.writeWeight) {
+        out += "write ";
+        expression(0);
+    } else if ((pick -= options.writeWeight) < options.ifWeight) {
+        out += "if ";
+        expression(0);
+        out += " then\n";
+        sequence(nesting + 1);
+        if (chance(0.5)) {
+            out += "\nelse\n";
+            sequence(nesting + 1);
+        }
+        out += "\nend";
+    } else {
+        out += "repeat\n";
+        sequence(nesting + 1);
+        out += "\nuntil ";
+        expression(0);
+    }
+}
+
+void ProgramGenerator::expression(int depth) {
+    simpleExpression(depth);
+    if (chance(0.3)) {
+        out += chance(0.5) ? " < " : " = ";
+        simpleExpression(depth);
+    }
+}
+
+void ProgramGenerator::simpleExpression(int depth) {
+    static const char *const operators[] = {" + ", " - ", " * ", " / "};
+    factor(depth);
+    for (int i = 0, n = below(3); i < n; ++i) {
+        out += operators[below(4)];
+        factor(depth);
+    }
+}
+
+void ProgramGenerator::factor(int depth) {
+    if (depth < options.maxExpressionDepth && chance(0.2)) {
+        out += '(';
+        expression(depth + 1);
+        out += ')';
+    } else if (chance(0.6)) {
+        out += names[below(int(names.size()))];
+    } else {
+        out += QByteArray::number(below(1000));
+    }
+}
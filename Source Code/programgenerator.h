@@ -0,0 +1,61 @@
+#ifndef PROGRAMGENERATOR_H
+#define PROGRAMGENERATOR_H
+
+#include <QByteArray>
+#include <QString>
+#include <random>
+#include <vector>
+
+// Knobs for ProgramGenerator. The same options and seed always produce the
+// same program.
+struct GeneratorOptions {
+    quint64 seed = 1;
+    qint64 targetBytes = 1 << 20;   // Generation stops at the first statement boundary past this
+
+    // Relative weights of the statement kinds
+    int assignWeight = 5;
+    int readWeight = 1;
+    int writeWeight = 2;
+    int ifWeight = 2;
+    int repeatWeight = 1;
+
+    int maxExpressionDepth = 4;     // Parenthesized sub-expressions nest at most this deep
+    int maxNesting = 3;             // if/repeat bodies nest at most this deep
+    double commentDensity = 0.1;    // Chance of a { comment } before each statement
+    int variables = 64;             // Size of the identifier pool
+};
+
+// "assign=5,read=1,write=2,if=2,repeat=1"; kinds not listed keep their weight
+bool parseStatementMix(const QString &text, GeneratorOptions &options);
+
+// Byte count with an optional K, M or G suffix (powers of 1024), -1 if invalid
+qint64 parseByteSize(const QString &text);
+
+// Writes random but syntactically valid TINY programs of a requested size,
+// for benchmarks and stress tests.
+class ProgramGenerator {
+public:
+    explicit ProgramGenerator(const GeneratorOptions &options);
+
+    QByteArray generate();
+
+    qint64 statementCount() const { return statements; } // Of the last generate()
+
+private:
+    void statement(int nesting);
+    void sequence(int nesting);     // One to four statements
+    void expression(int depth);     // simple-exp [comparison-op simple-exp]
+    void simpleExpression(int depth);
+    void factor(int depth);
+    void comment();
+    int below(int bound) { return int(rng() % quint64(bound)); }
+    bool chance(double p) { return std::uniform_real_distribution<double>(0, 1)(rng) < p; }
+
+    GeneratorOptions options;
+    std::mt19937_64 rng;
+    std::vector<QByteArray> names;
+    QByteArray out;
+    qint64 statements = 0;
+};
+
+#endif // PROGRAMGENERATOR_H
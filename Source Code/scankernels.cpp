@@ -0,0 +1,179 @@
+#include "scankernels.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define TINY_SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+inline bool isAsciiSpace(unsigned char c) { return c == ' ' || (c >= '\t' && c <= '\r'); }
+inline bool isAsciiLetter(unsigned char c) { return unsigned((c | 0x20) - 'a') < 26; }
+inline bool isAsciiDigit(unsigned char c) { return unsigned(c - '0') < 10; }
+
+// Scalar versions, also used for the tails of the vector loops
+const char *skipSpaceScalar(const char *p, const char *end) {
+    while (p < end && isAsciiSpace(*p)) ++p;
+    return p;
+}
+
+const char *findCommentEndScalar(const char *p, const char *end) {
+    while (p < end && *p != '}') ++p;
+    return p;
+}
+
+const char *letterRunScalar(const char *p, const char *end) {
+    while (p < end && isAsciiLetter(*p)) ++p;
+    return p;
+}
+
+const char *digitRunScalar(const char *p, const char *end) {
+    while (p < end && isAsciiDigit(*p)) ++p;
+    return p;
+}
+
+const ScanKernels scalarKernels = {
+    skipSpaceScalar, findCommentEndScalar, letterRunScalar, digitRunScalar, "scalar"
+};
+
+#ifdef TINY_SCAN_X86
+
+// Byte-range tests use the signed-compare trick: shift the range so it starts
+// at -128, then one signed "less than" selects exactly the bytes in range.
+// Bytes >= 0x80 never land in any of the ranges below.
+
+__attribute__((target("sse2"))) inline int spaceMask16(__m128i v) {
+    __m128i ctrl = _mm_cmplt_epi8(_mm_add_epi8(v, _mm_set1_epi8(char(128 - '\t'))),
+                                  _mm_set1_epi8(char(-128 + 5)));
+    __m128i blank = _mm_cmpeq_epi8(v, _mm_set1_epi8(' '));
+    return _mm_movemask_epi8(_mm_or_si128(ctrl, blank));
+}
+
+__attribute__((target("sse2"))) inline int letterMask16(__m128i v) {
+    __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+    return _mm_movemask_epi8(_mm_cmplt_epi8(_mm_add_epi8(lower, _mm_set1_epi8(char(128 - 'a'))),
+                                            _mm_set1_epi8(char(-128 + 26))));
+}
+
+__attribute__((target("sse2"))) inline int digitMask16(__m128i v) {
+    return _mm_movemask_epi8(_mm_cmplt_epi8(_mm_add_epi8(v, _mm_set1_epi8(char(128 - '0'))),
+                                            _mm_set1_epi8(char(-128 + 10))));
+}
+
+__attribute__((target("sse2"))) inline int braceMask16(__m128i v) {
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('}')));
+}
+
+// Advance while every byte matches; stop at the first byte whose bit is clear
+template <int (*Mask)(__m128i), const char *(*Tail)(const char *, const char *)>
+__attribute__((target("sse2"))) const char *runSse2(const char *p, const char *end) {
+    while (end - p >= 16) {
+        unsigned miss = ~unsigned(Mask(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p)))) & 0xFFFFu;
+        if (miss) {
+            return p + __builtin_ctz(miss);
+        }
+        p += 16;
+    }
+    return Tail(p, end);
+}
+
+__attribute__((target("sse2"))) const char *findCommentEndSse2(const char *p, const char *end) {
+    while (end - p >= 16) {
+        unsigned hit = unsigned(braceMask16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p))));
+        if (hit) {
+            return p + __builtin_ctz(hit);
+        }
+        p += 16;
+    }
+    return findCommentEndScalar(p, end);
+}
+
+const ScanKernels sse2Kernels = {
+    runSse2<spaceMask16, skipSpaceScalar>, findCommentEndSse2,
+    runSse2<letterMask16, letterRunScalar>, runSse2<digitMask16, digitRunScalar>, "sse2"
+};
+
+__attribute__((target("avx2"))) inline unsigned spaceMask32(__m256i v) {
+    __m256i ctrl = _mm256_cmpgt_epi8(_mm256_set1_epi8(char(-128 + 5)),
+                                     _mm256_add_epi8(v, _mm256_set1_epi8(char(128 - '\t'))));
+    __m256i blank = _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' '));
+    return unsigned(_mm256_movemask_epi8(_mm256_or_si256(ctrl, blank)));
+}
+
+__attribute__((target("avx2"))) inline unsigned letterMask32(__m256i v) {
+    __m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+    return unsigned(_mm256_movemask_epi8(
+        _mm256_cmpgt_epi8(_mm256_set1_epi8(char(-128 + 26)),
+                          _mm256_add_epi8(lower, _mm256_set1_epi8(char(128 - 'a'))))));
+}
+
+__attribute__((target("avx2"))) inline unsigned digitMask32(__m256i v) {
+    return unsigned(_mm256_movemask_epi8(
+        _mm256_cmpgt_epi8(_mm256_set1_epi8(char(-128 + 10)),
+                          _mm256_add_epi8(v, _mm256_set1_epi8(char(128 - '0'))))));
+}
+
+__attribute__((target("avx2"))) inline unsigned braceMask32(__m256i v) {
+    return unsigned(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('}'))));
+}
+
+template <unsigned (*Mask)(__m256i), const char *(*Tail)(const char *, const char *)>
+__attribute__((target("avx2"))) const char *runAvx2(const char *p, const char *end) {
+    while (end - p >= 32) {
+        unsigned miss = ~Mask(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(p)));
+        if (miss) {
+            return p + __builtin_ctz(miss);
+        }
+        p += 32;
+    }
+    return Tail(p, end);
+}
+
+__attribute__((target("avx2"))) const char *findCommentEndAvx2(const char *p, const char *end) {
+    while (end - p >= 32) {
+        unsigned hit = braceMask32(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(p)));
+        if (hit) {
+            return p + __builtin_ctz(hit);
+        }
+        p += 32;
+    }
+    return findCommentEndSse2(p, end);
+}
+
+// The AVX2 tails drop to SSE2 so a 16..31 byte remainder is still vectorized
+const ScanKernels avx2Kernels = {
+    runAvx2<spaceMask32, runSse2<spaceMask16, skipSpaceScalar>>, findCommentEndAvx2,
+    runAvx2<letterMask32, runSse2<letterMask16, letterRunScalar>>,
+    runAvx2<digitMask32, runSse2<digitMask16, digitRunScalar>>, "avx2"
+};
+
+bool cpuSupports(ScanIsa isa) {
+    switch (isa) {
+    case ScanIsa::AVX2: return __builtin_cpu_supports("avx2");
+    case ScanIsa::SSE2: return __builtin_cpu_supports("sse2");
+    default: return true;
+    }
+}
+
+#endif // TINY_SCAN_X86
+
+} // namespace
+
+const ScanKernels &scanKernels(ScanIsa isa) {
+#ifdef TINY_SCAN_X86
+    if (isa == ScanIsa::AVX2 && cpuSupports(ScanIsa::AVX2)) {
+        return avx2Kernels;
+    }
+    if (isa != ScanIsa::Scalar && cpuSupports(ScanIsa::SSE2)) {
+        return sse2Kernels;
+    }
+#else
+    (void)isa;
+#endif
+    return scalarKernels;
+}
+
+const ScanKernels &scanKernels() {
+    static const ScanKernels &best = scanKernels(ScanIsa::AVX2);
+    return best;
+}
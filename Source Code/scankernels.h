@@ -0,0 +1,24 @@
+#ifndef SCANKERNELS_H
+#define SCANKERNELS_H
+
+// Byte-run kernels used by tokenizeCompact(). Each one starts at p and
+// returns the first position in [p, end) that does NOT belong to the run
+// (or end). They only look at ASCII; callers handle UTF-8 sequences themselves.
+struct ScanKernels {
+    const char* (*skipSpace)(const char *p, const char *end);      // ' ' \t \n \v \f \r
+    const char* (*findCommentEnd)(const char *p, const char *end); // Position of '}', or end
+    const char* (*letterRun)(const char *p, const char *end);      // [A-Za-z]*
+    const char* (*digitRun)(const char *p, const char *end);       // [0-9]*
+    const char *name;
+};
+
+enum class ScanIsa { Scalar, SSE2, AVX2 };
+
+// Kernels for the best instruction set this CPU supports (detected once)
+const ScanKernels &scanKernels();
+
+// Kernels for a specific instruction set; falls back to the best supported
+// one below it. Used by benchmarks and to cross-check the vector paths.
+const ScanKernels &scanKernels(ScanIsa isa);
+
+#endif // SCANKERNELS_H
@@ -8,18 +8,19 @@ CONFIG += c++17
 # In order to do so, uncomment the following line.
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
+include(tinycore.pri)
+
 SOURCES += \
+    analysisworker.cpp \
     main.cpp \
     mainwindow.cpp \
-    parser.cpp \
-    syntaxtree.cpp \
-    token.cpp
+    syntaxtreeitem.cpp \
+    syntaxtreescene.cpp
 
 HEADERS += \
+    analysisworker.h \
     mainwindow.h \
-    parser.h \
-    syntaxtree.h \
-    token.h
+    syntaxtreeitem.h
 
 FORMS += \
     mainwindow.ui
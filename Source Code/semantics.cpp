@@ -0,0 +1,169 @@
+#include "semantics.h"
+#include "diagnostics.h"
+
+namespace {
+
+class AssignmentChecker {
+public:
+    AssignmentChecker(const FlatAst &ast, const SymbolTable &symbols, Diagnostics &diagnostics)
+        : ast(ast), symbols(symbols), diagnostics(diagnostics),
+          assigned(ast.identifiers.size(), false), reported(ast.identifiers.size(), false),
+          stamp(ast.identifiers.size(), 0) {}
+
+    void sequence(quint32 index);
+    int warnings = 0;
+
+private:
+    void expression(quint32 index);
+    void assign(quint32 id);
+    void undo(size_t mark);     // Forget assignments logged since mark
+
+    const FlatAst &ast;
+    const SymbolTable &symbols;
+    Diagnostics &diagnostics;
+    std::vector<bool> assigned;
+    std::vector<bool> reported;
+    std::vector<quint32> log;       // Variables in the order they became assigned
+    std::vector<quint32> stamp;     // For intersecting the two branches of an if
+    quint32 generation = 0;
+    std::vector<quint32> pending;   // Expression nodes still to visit
+
+    // Statement work still to do; the branch steps carry an if's undo mark
+    struct Step {
+        enum Kind : quint8 { Sequence, ElseBranch, JoinBranches, RepeatCondition } kind;
+        quint32 index;      // First statement of a sequence, or the if/repeat to finish
+        size_t mark;        // log.size() before the if's then branch
+        size_t saved;       // Where the then branch's assignments start in thenAssigned
+    };
+    std::vector<Step> steps;
+    std::vector<quint32> thenAssigned;  // Per if being walked, what its then branch assigned
+};
+
+void AssignmentChecker::assign(quint32 id) {
+    if (!assigned[id]) {
+        assigned[id] = true;
+        log.push_back(id);
+    }
+}
+
+void AssignmentChecker::undo(size_t mark) {
+    for (size_t i = mark; i < log.size(); ++i) {
+        assigned[log[i]] = false;
+    }
+    log.resize(mark);
+}
+
+// Iterative, so deeply parenthesized expressions can't exhaust the stack
+void AssignmentChecker::expression(quint32 index) {
+    pending.push_back(index);
+    while (!pending.empty()) {
+        quint32 node = pending.back();
+        pending.pop_back();
+        const AstNode &n = ast.node(node);
+        if (n.kind == NodeKind::Op) {
+            pending.push_back(n.children[1]);
+            pending.push_back(n.children[0]);
+        } else if (n.kind == NodeKind::Id && !assigned[n.payload] && !reported[n.payload]) {
+            reported[n.payload] = true;
+            warnings++;
+            diagnostics.warning(symbols.nodeOffset(node),
+                                QString("'%1' may be used before it is assigned").arg(ast.identifiers.text(n.payload)));
+        }
+    }
+}
+
+// Iterative too, so deeply nested ifs and repeats can't exhaust the stack
+void AssignmentChecker::sequence(quint32 index) {
+    steps.push_back({Step::Sequence, index, 0, 0});
+    while (!steps.empty()) {
+        Step step = steps.back();
+        steps.pop_back();
+        if (step.index == FlatAst::NoNode) {
+            continue;   // End of a sequence
+        }
+        const AstNode &n = ast.node(step.index);
+        switch (step.kind) {
+        case Step::Sequence:
+            steps.push_back({Step::Sequence, n.sibling, 0, 0});
+            switch (n.kind) {
+            case NodeKind::Assign:
+                expression(n.children[0]);
+                assign(n.payload);
+                break;
+            case NodeKind::Read:
+                assign(n.payload);
+                break;
+            case NodeKind::Write:
+                expression(n.children[0]);
+                break;
+            case NodeKind::If:
+                expression(n.children[0]);
+                steps.push_back({Step::ElseBranch, step.index, log.size(), 0});
+                steps.push_back({Step::Sequence, n.childCount > 1 ? n.children[1] : FlatAst::NoNode, 0, 0});
+                break;
+            case NodeKind::Repeat:
+                // The body runs at least once, so what it assigns stays assigned
+                steps.push_back({Step::RepeatCondition, step.index, 0, 0});
+                steps.push_back({Step::Sequence, n.children[0], 0, 0});
+                break;
+            default:
+                break;
+            }
+            break;
+        case Step::ElseBranch:
+            if (n.childCount > 2) {
+                size_t saved = thenAssigned.size();
+                thenAssigned.insert(thenAssigned.end(), log.begin() + step.mark, log.end());
+                undo(step.mark);
+                steps.push_back({Step::JoinBranches, step.index, step.mark, saved});
+                steps.push_back({Step::Sequence, n.children[2], 0, 0});
+            } else {
+                undo(step.mark);
+            }
+            break;
+        case Step::JoinBranches:
+            // Assigned after the if = assigned on both paths
+            generation++;
+            for (size_t i = step.mark; i < log.size(); ++i) {
+                stamp[log[i]] = generation;
+            }
+            undo(step.mark);
+            for (size_t i = step.saved; i < thenAssigned.size(); ++i) {
+                if (stamp[thenAssigned[i]] == generation) {
+                    assign(thenAssigned[i]);
+                }
+            }
+            thenAssigned.resize(step.saved);
+            break;
+        case Step::RepeatCondition:
+            expression(n.children[1]);
+            break;
+        }
+    }
+}
+
+} // namespace
+
+int checkUseBeforeAssign(const FlatAst &ast, const SymbolTable &symbols, Diagnostics &diagnostics) {
+    AssignmentChecker checker(ast, symbols, diagnostics);
+    checker.sequence(ast.root);
+    return checker.warnings;
+}
+
+QString symbolReport(const FlatAst &ast, const SymbolTable &symbols, Diagnostics &diagnostics) {
+    QString text;
+    for (qsizetype id = 0; id < symbols.size(); ++id) {
+        const Symbol &symbol = symbols.symbol(quint32(id));
+        QString line = QString("%1: %2 definition(s), %3 use(s)")
+                           .arg(ast.identifiers.text(quint32(id))).arg(symbol.definitions).arg(symbol.uses);
+        if (symbol.firstDefinition >= 0) {
+            int row = 0, column = 0;
+            diagnostics.locate(symbol.firstDefinition, row, column);
+            line += QString(", first assigned at %1:%2").arg(row).arg(column);
+        } else {
+            line += ", never assigned";
+        }
+        text += line + '\n';
+    }
+    return text;
+}
@@ -0,0 +1,20 @@
+#ifndef SEMANTICS_H
+#define SEMANTICS_H
+
+#include "flatast.h"
+#include "symboltable.h"
+
+class Diagnostics;
+
+// Warn about variables read before every path to the read has assigned them
+// (TINY variables start at 0, so this is a lint, not an error). One warning
+// per variable, at its first such read. Linear in the size of the tree: the
+// set of assigned variables is kept with an undo log, so branches never copy it.
+// Returns the number of warnings.
+int checkUseBeforeAssign(const FlatAst &ast, const SymbolTable &symbols, Diagnostics &diagnostics);
+
+// One line per variable in ID order: name, definition and use counts, and
+// where it is first assigned ("line:column", using diagnostics for the lookup)
+QString symbolReport(const FlatAst &ast, const SymbolTable &symbols, Diagnostics &diagnostics);
+
+#endif // SEMANTICS_H
@@ -0,0 +1,37 @@
+#include "sourcebuffer.h"
+#include <stdexcept>
+
+SourceBuffer::SourceBuffer(const QString &path) : file(path) {
+    if (!file.open(QIODevice::ReadOnly)) {
+        QString errorMsg = QString("Unable to open '%1': %2").arg(path, file.errorString());
+        throw std::runtime_error(errorMsg.toStdString());
+    }
+
+    length = file.size();
+    if (length > 0) {
+        mapped = file.map(0, length);
+    }
+    if (mapped) {
+        bytes = reinterpret_cast<const char*>(mapped);
+    } else {
+        // Empty files can't be mapped, and some file systems refuse to; read instead
+        owned = file.readAll();
+        bytes = owned.constData();
+        length = owned.size();
+    }
+}
+
+SourceBuffer::SourceBuffer(const QByteArray &utf8) : owned(utf8) {
+    bytes = owned.constData();
+    length = owned.size();
+}
+
+SourceBuffer::~SourceBuffer() {
+    if (mapped) {
+        file.unmap(mapped);
+    }
+}
+
+QString SourceBuffer::text(qsizetype offset, qsizetype count) const {
+    return QString::fromUtf8(bytes + offset, count);
+}
@@ -0,0 +1,35 @@
+#ifndef SOURCEBUFFER_H
+#define SOURCEBUFFER_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+
+// Read-only view of a source file's bytes. Files are memory-mapped when the
+// platform allows it, so scanning never copies the text; in-memory text
+// (e.g. from the editor) is held as UTF-8.
+class SourceBuffer {
+public:
+    explicit SourceBuffer(const QString &path); // Throws std::runtime_error if unreadable
+    explicit SourceBuffer(const QByteArray &utf8);
+    ~SourceBuffer();
+
+    SourceBuffer(const SourceBuffer&) = delete;
+    SourceBuffer& operator=(const SourceBuffer&) = delete;
+
+    const char* data() const { return bytes; }
+    qsizetype size() const { return length; }
+    bool isMapped() const { return mapped != nullptr; }
+
+    // Materialize a byte range as a QString (UTF-8 decoded)
+    QString text(qsizetype offset, qsizetype count) const;
+
+private:
+    QFile file;
+    uchar* mapped = nullptr;
+    QByteArray owned;          // Used when the data is not mapped
+    const char* bytes = nullptr;
+    qsizetype length = 0;
+};
+
+#endif // SOURCEBUFFER_H
@@ -0,0 +1,34 @@
+#include "stringinterner.h"
+
+quint32 StringInterner::intern(const QString &text) {
+    auto it = ids.constFind(text);
+    if (it != ids.constEnd()) {
+        return it.value();
+    }
+    quint32 id = quint32(strings.size());
+    strings.append(text);
+    ids.insert(text, id);
+    return id;
+}
+
+quint32 StringInterner::find(const QString &text) const {
+    return ids.value(text, NotFound);
+}
+
+void StringInterner::clear() {
+    // Keep the table's size, so interning the next tree's names doesn't rehash
+    qsizetype buckets = ids.capacity();
+    ids.clear();
+    ids.reserve(buckets);
+    strings.resize(0);
+}
+
+qsizetype StringInterner::memoryUsage() const {
+    // The hash shares each string's data with the list; count the text once
+    qsizetype bytes = strings.capacity() * qsizetype(sizeof(QString)) +
+                      ids.capacity() * qsizetype(sizeof(QString) + sizeof(quint32) + sizeof(void *));
+    for (const QString &text : strings) {
+        bytes += text.capacity() * qsizetype(sizeof(QChar));
+    }
+    return bytes;
+}
@@ -0,0 +1,28 @@
+#ifndef STRINGINTERNER_H
+#define STRINGINTERNER_H
+
+#include <QHash>
+#include <QList>
+#include <QString>
+
+// Maps each distinct string to a dense integer ID (0, 1, 2, ...), so later
+// passes can compare and index names with plain integers.
+class StringInterner {
+public:
+    quint32 intern(const QString &text);
+    quint32 find(const QString &text) const; // NotFound if never interned
+
+    const QString &text(quint32 id) const { return strings[id]; }
+    qsizetype size() const { return strings.size(); }
+    void clear();   // Keeps the allocated capacity for reuse
+
+    qsizetype memoryUsage() const; // Approximate bytes held, string data included
+
+    static constexpr quint32 NotFound = 0xFFFFFFFFu;
+
+private:
+    QHash<QString, quint32> ids;
+    QList<QString> strings;
+};
+
+#endif // STRINGINTERNER_H
@@ -0,0 +1,29 @@
+#include "symboltable.h"
+
+void SymbolTable::clear() {
+    symbols.clear();
+    offsets.clear();
+}
+
+void SymbolTable::record(quint32 id, quint32 node, qsizetype offset, bool definition) {
+    if (id >= quint32(symbols.size())) {
+        symbols.resize(id + 1);
+    }
+    Symbol &symbol = symbols[id];
+    if (definition) {
+        if (symbol.definitions++ == 0) {
+            symbol.firstDefinition = offset;
+        }
+    } else if (symbol.uses++ == 0) {
+        symbol.firstUse = offset;
+    }
+
+    if (node >= offsets.size()) {
+        offsets.resize(node + 1, -1);
+    }
+    offsets[node] = offset;
+}
+
+qsizetype SymbolTable::nodeOffset(quint32 node) const {
+    return node < offsets.size() ? offsets[node] : -1;
+}
@@ -0,0 +1,34 @@
+#ifndef SYMBOLTABLE_H
+#define SYMBOLTABLE_H
+
+#include <QList>
+#include <vector>
+
+// What the parser saw of one variable. Names live in FlatAst::identifiers;
+// the table is indexed by the same interned IDs.
+struct Symbol {
+    qsizetype firstDefinition = -1; // Source offset of the first assignment or read, -1 if none
+    qsizetype firstUse = -1;        // Source offset of the first use in an expression, -1 if none
+    int definitions = 0;
+    int uses = 0;
+};
+
+// Filled by Parser (see Parser::setSymbols) as identifiers are interned, so
+// later passes get positions and counts without going back to the text.
+class SymbolTable {
+public:
+    void clear();
+
+    // One occurrence of identifier id at node: an assign/read target, or a use
+    void record(quint32 id, quint32 node, qsizetype offset, bool definition);
+
+    qsizetype size() const { return symbols.size(); }
+    const Symbol &symbol(quint32 id) const { return symbols[id]; }
+    qsizetype nodeOffset(quint32 node) const;  // Where an identifier node's name starts, -1 if unknown
+
+private:
+    QList<Symbol> symbols;
+    std::vector<qsizetype> offsets;     // Indexed by node; -1 for nodes without an identifier
+};
+
+#endif // SYMBOLTABLE_H
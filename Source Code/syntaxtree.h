@@ -1,28 +1,53 @@
 #ifndef SYNTAXTREE_H
 #define SYNTAXTREE_H
 
+#include "flatast.h"
 #include <QString>
 #include <QList>
-#include <QGraphicsScene>
-#include <set>
+#include <vector>
+
+class QGraphicsScene;
+class TreeLayout;
 
 // Represents a single node in the syntax tree
 class SyntaxTreeNode {
 public:
     QString name;
+    NodeKind kind;
     QList<SyntaxTreeNode*> children = {};
     SyntaxTreeNode* sibling = NULL;         // Pointer to the next sibling
-    bool processed = false;
 
-    SyntaxTreeNode(const QString &name);
-    ~SyntaxTreeNode();
+    SyntaxTreeNode(const QString &name, NodeKind kind);  // Nodes are created by a SyntaxTreeArena
+};
+
+// Draw a laid-out tree into a QGraphicsScene; only reads the position table
+// (defined in syntaxtreescene.cpp, which only the GUI target compiles)
+void addToScene(QGraphicsScene *scene, const TreeLayout &layout);
+
+// Block allocator that owns every node of one or more parse trees.
+// Nodes are constructed in place in fixed-size blocks; reset() destroys them
+// all in one linear sweep (no tree walk) and keeps the blocks for the next
+// parse, so re-parsing doesn't go back to the heap for node storage.
+class SyntaxTreeArena {
+public:
+    SyntaxTreeArena() = default;
+    ~SyntaxTreeArena();
+
+    SyntaxTreeArena(const SyntaxTreeArena&) = delete;
+    SyntaxTreeArena& operator=(const SyntaxTreeArena&) = delete;
+
+    SyntaxTreeNode* create(const QString &name, NodeKind kind);
+    void reset();                                  // Invalidates every node handed out so far
+
+    qsizetype nodeCount() const { return used; }
+    qsizetype capacity() const { return qsizetype(blocks.size()) * BlockNodes; }
+    qsizetype memoryUsage() const; // Blocks plus each live node's name and child list
 
-    // Recursively add the tree to a QGraphicsScene for visualization
-    void addToScene(QGraphicsScene *scene, int &x, int y, int xSpacing, int ySpacing);
+private:
+    static constexpr qsizetype BlockNodes = 1024;
 
-    void deleteNode(SyntaxTreeNode* node, std::set<SyntaxTreeNode*>& visited);
-    int getDepth() const;
-    int getMaxWidth() const;
+    std::vector<SyntaxTreeNode*> blocks; // Raw storage for BlockNodes nodes each
+    qsizetype used = 0;
 };
 
 #endif // SYNTAXTREE_H
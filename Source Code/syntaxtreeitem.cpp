@@ -0,0 +1,105 @@
+#include "syntaxtreeitem.h"
+#include "syntaxtree.h"
+#include "treelayout.h"
+#include <QPainter>
+#include <QPolygonF>
+#include <QStyleOptionGraphicsItem>
+#include <algorithm>
+
+namespace {
+
+const qreal DetailRowPixels = 12;  // Rows closer than this on screen start to collapse
+const qreal MinNodePixels = 2;     // Nodes closer than this on screen merge into a bar
+const qreal TextScale = 0.35;      // Labels are drawn from this zoom level up
+const qreal LabelOverhang = 60;    // Labels may be wider than their box
+
+} // namespace
+
+SyntaxTreeItem::SyntaxTreeItem(const TreeLayout &layout) : layout(layout) {
+    setFlag(QGraphicsItem::ItemUsesExtendedStyleOption); // Fills in exposedRect
+}
+
+QRectF SyntaxTreeItem::boundingRect() const {
+    return layout.bounds().adjusted(-LabelOverhang, 0, LabelOverhang, 0);
+}
+
+void SyntaxTreeItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *) {
+    if (layout.rowCount() == 0) {
+        return;
+    }
+    const QList<TreeLayout::Placement> &placements = layout.placements();
+    const QRectF area = option->exposedRect;
+    const qreal scale = QStyleOptionGraphicsItem::levelOfDetailFromTransform(painter->worldTransform());
+    const qreal rowHeight = layout.rowHeight();
+
+    // A row's nodes also draw the edges up to the row above, so look one row
+    // below the exposed area too
+    int firstRow = layout.rowAt(area.top());
+    int lastRow = layout.rowAt(area.bottom() + rowHeight);
+
+    // Once rows get too close, stop a few rows down and summarise what is below
+    int collapseRow = lastRow;
+    qreal rowPixels = rowHeight * scale;
+    bool collapsed = rowPixels < DetailRowPixels;
+    if (collapsed) {
+        collapseRow = std::min(lastRow, firstRow + int(rowPixels / 3));
+    }
+
+    QPen pen(Qt::black, 0); // Cosmetic: one pixel at any zoom
+    painter->setPen(pen);
+    painter->setBrush(Qt::NoBrush);
+    const QBrush runBrush(Qt::darkGray);
+    const QBrush glyphBrush(QColor(0, 0, 0, 40));
+    const qreal minStep = MinNodePixels / scale;
+    const bool labels = scale >= TextScale;
+
+    for (int row = firstRow; row <= collapseRow; ++row) {
+        int begin, end;
+        layout.rowRange(row, area.left(), area.right(), begin, end);
+
+        for (int i = begin; i < end;) {
+            const TreeLayout::Placement &p = placements[i];
+
+            // Everything up to next is within minStep of this node
+            int next = std::min(end, std::max(i + 1, layout.firstAtOrAfter(row, i + 1, p.x + minStep)));
+            const TreeLayout::Placement &last = placements[next - 1];
+
+            if (p.parent >= 0) {
+                const TreeLayout::Placement &parent = placements[p.parent];
+                painter->drawLine(QPointF(parent.x, parent.y + parent.height / 2), QPointF(p.x, p.y - p.height / 2));
+            }
+            if (p.previous >= 0) {
+                const TreeLayout::Placement &previous = placements[p.previous];
+                painter->drawLine(QPointF(previous.x + previous.width / 2, p.y), QPointF(p.x - p.width / 2, p.y));
+            }
+
+            if (next > i + 1) {
+                // A run too dense to tell apart: one bar
+                painter->fillRect(QRectF(p.x - p.width / 2, p.y - p.height / 2,
+                                         last.x + last.width / 2 - (p.x - p.width / 2), p.height), runBrush);
+            } else {
+                QRectF box(p.x - p.width / 2, p.y - p.height / 2, p.width, p.height);
+                if (isStatementKind(p.node->kind)) {
+                    painter->drawRect(box);
+                } else {
+                    painter->drawEllipse(box);
+                }
+                if (labels) {
+                    painter->drawText(box, Qt::AlignCenter | Qt::TextDontClip, p.node->name);
+                }
+            }
+
+            // Collapsed rows: one glyph covering everything below the run
+            if (collapsed && row == collapseRow && row + 1 < layout.rowCount() && (p.hasChildren || last.hasChildren)) {
+                qreal bottom = std::max(p.spanBottom, last.spanBottom);
+                QPolygonF glyph;
+                glyph << QPointF(p.x, p.y + p.height / 2) << QPointF(last.x, p.y + p.height / 2)
+                      << QPointF(last.spanRight, bottom) << QPointF(p.spanLeft, bottom);
+                painter->setBrush(glyphBrush);
+                painter->drawPolygon(glyph);
+                painter->setBrush(Qt::NoBrush);
+            }
+            i = next;
+        }
+    }
+}
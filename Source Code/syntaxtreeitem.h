@@ -0,0 +1,24 @@
+#ifndef SYNTAXTREEITEM_H
+#define SYNTAXTREEITEM_H
+
+#include <QGraphicsItem>
+
+class TreeLayout;
+
+// Draws a whole laid-out tree as one scene item. Only the nodes inside the
+// exposed rect are painted, found through the layout's row index, so the
+// cost of a repaint follows the viewport rather than the tree. Zoomed out,
+// nodes closer than a pixel merge into bars and deep rows collapse into one
+// glyph per subtree.
+class SyntaxTreeItem : public QGraphicsItem {
+public:
+    explicit SyntaxTreeItem(const TreeLayout &layout); // layout must outlive the item
+
+    QRectF boundingRect() const override;
+    void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget) override;
+
+private:
+    const TreeLayout &layout;
+};
+
+#endif // SYNTAXTREEITEM_H
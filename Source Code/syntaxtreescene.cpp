@@ -0,0 +1,41 @@
+#include "syntaxtree.h"
+#include "treelayout.h"
+#include <QGraphicsScene>
+#include <QGraphicsEllipseItem>
+#include <QGraphicsTextItem>
+#include <QGraphicsLineItem>
+#include <QGraphicsRectItem>
+
+// Helper function to determine if a node is a non-terminal
+static bool isNonTerminal(const SyntaxTreeNode *node) {
+    // Statements are drawn as rectangles, expression nodes as circles
+    return isStatementKind(node->kind);
+}
+
+
+void addToScene(QGraphicsScene *scene, const TreeLayout &layout) {
+    const QList<TreeLayout::Placement> &placements = layout.placements();
+    for (const TreeLayout::Placement &p : placements) {
+        // Draw the current node
+        QRectF box(p.x - p.width / 2, p.y - p.height / 2, p.width, p.height);
+        if (isNonTerminal(p.node)) {
+            scene->addRect(box);
+        } else {
+            scene->addEllipse(box);
+        }
+        QGraphicsTextItem* text = scene->addText(p.node->name);
+        text->setPos(p.x - text->boundingRect().width() / 2, p.y - text->boundingRect().height() / 2);
+
+        // Edge down from the parent, for the first node of each child sequence
+        if (p.parent >= 0) {
+            const TreeLayout::Placement &parent = placements[p.parent];
+            scene->addLine(parent.x, parent.y + parent.height / 2, p.x, p.y - p.height / 2);
+        }
+
+        // Horizontal link from the previous statement of the same sequence
+        if (p.previous >= 0) {
+            const TreeLayout::Placement &previous = placements[p.previous];
+            scene->addLine(previous.x + previous.width / 2, p.y, p.x - p.width / 2, p.y);
+        }
+    }
+}
@@ -0,0 +1,109 @@
+#include "threadpool.h"
+#include <algorithm>
+
+namespace {
+// Which pool/worker the current thread belongs to, so nested submits stay local
+thread_local WorkStealingPool* currentPool = nullptr;
+thread_local int currentIndex = -1;
+}
+
+WorkStealingPool::WorkStealingPool(int threadCount) {
+    if (threadCount <= 0) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    for (int i = 0; i < threadCount; ++i) {
+        workers.push_back(std::make_unique<Worker>());
+    }
+    for (int i = 0; i < threadCount; ++i) {
+        threads.emplace_back(&WorkStealingPool::run, this, i);
+    }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    wait();
+    {
+        std::lock_guard<std::mutex> lock(idleMutex);
+        stopping = true;
+    }
+    idleCondition.notify_all();
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+}
+
+void WorkStealingPool::submit(Task task) {
+    int index = (currentPool == this) ? currentIndex
+                                      : static_cast<int>(nextWorker++ % workers.size());
+
+    pending++;
+    {
+        std::lock_guard<std::mutex> lock(workers[index]->mutex);
+        workers[index]->tasks.push_back(std::move(task));
+    }
+    queued++;
+
+    // Taking the idle mutex before notifying closes the gap between a worker
+    // checking "queued" and going to sleep.
+    std::lock_guard<std::mutex> lock(idleMutex);
+    idleCondition.notify_one();
+}
+
+void WorkStealingPool::wait() {
+    std::unique_lock<std::mutex> lock(idleMutex);
+    doneCondition.wait(lock, [this] { return pending == 0; });
+}
+
+bool WorkStealingPool::popLocal(int index, Task &task) {
+    Worker &worker = *workers[index];
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    if (worker.tasks.empty()) {
+        return false;
+    }
+    task = std::move(worker.tasks.back());
+    worker.tasks.pop_back();
+    return true;
+}
+
+bool WorkStealingPool::steal(int index, Task &task) {
+    int count = static_cast<int>(workers.size());
+    for (int offset = 1; offset < count; ++offset) {
+        Worker &victim = *workers[(index + offset) % count];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkStealingPool::run(int index) {
+    currentPool = this;
+    currentIndex = index;
+
+    while (true) {
+        Task task;
+        if (popLocal(index, task) || steal(index, task)) {
+            queued--;
+            try {
+                task();
+            } catch (...) {
+                // A failing task must not take the whole pool down; callers
+                // report their own errors from inside the task.
+            }
+            if (--pending == 0) {
+                std::lock_guard<std::mutex> lock(idleMutex);
+                doneCondition.notify_all();
+            }
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(idleMutex);
+        idleCondition.wait(lock, [this] { return stopping || queued > 0; });
+        if (stopping && queued == 0) {
+            return;
+        }
+    }
+}
@@ -0,0 +1,72 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed-size thread pool where every worker owns a task deque.
+// A worker pops from the back of its own deque and, when that runs dry,
+// steals from the front of the others, so uneven file sizes still keep
+// every core busy.
+class WorkStealingPool {
+public:
+    using Task = std::function<void()>;
+
+    explicit WorkStealingPool(int threadCount = 0); // 0 = one thread per core
+    ~WorkStealingPool();
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    void submit(Task task);  // Tasks submitted from a worker stay on its own deque
+    void wait();             // Block until every submitted task has finished
+    int threadCount() const { return static_cast<int>(threads.size()); }
+
+private:
+    struct Worker {
+        std::deque<Task> tasks;
+        std::mutex mutex;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::thread> threads;
+
+    std::mutex idleMutex;
+    std::condition_variable idleCondition;  // Signalled when work is queued or on shutdown
+    std::condition_variable doneCondition;  // Signalled when pending drops to zero
+    std::atomic<int> queued{0};              // Tasks sitting in some deque
+    std::atomic<int> pending{0};             // Tasks submitted but not yet finished
+    std::atomic<unsigned> nextWorker{0};
+    bool stopping = false;
+
+    bool popLocal(int index, Task &task);
+    bool steal(int index, Task &task);
+    void run(int index);
+};
+
+// Run body(0) .. body(count - 1) at the same time, one thread each (body(0)
+// on the calling thread), and return once all of them have finished. Meant
+// for splitting one large job into a few coarse pieces; it is safe to call
+// from a pool task, which a nested wait() on the pool would not be.
+template <typename Body>
+void runConcurrently(int count, Body body) {
+    std::vector<std::thread> helpers;
+    helpers.reserve(count > 1 ? count - 1 : 0);
+    for (int i = 1; i < count; ++i) {
+        helpers.emplace_back([&body, i] { body(i); });
+    }
+    if (count > 0) {
+        body(0);
+    }
+    for (std::thread &helper : helpers) {
+        helper.join();
+    }
+}
+
+#endif // THREADPOOL_H
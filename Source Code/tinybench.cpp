@@ -0,0 +1,338 @@
+#include "programgenerator.h"
+#include "parallelparse.h"
+#include "parallelscan.h"
+#include "parser.h"
+#include "pipelinestats.h"
+#include "syntaxtree.h"
+#include "token.h"
+#include "tokenstream.h"
+#include "treelayout.h"
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+
+#if defined(Q_OS_WIN)
+#include <windows.h>
+#include <psapi.h>
+#elif defined(Q_OS_UNIX)
+#include <sys/resource.h>
+#endif
+
+// Benchmark driver: generates a TINY program with ProgramGenerator, times each
+// stage of the pipeline on it separately and prints the results as JSON.
+
+namespace {
+
+const char *const AllPhases[] = {"tokenize", "scan", "pscan", "parse", "pparse", "tree", "layout", "destroy"};
+
+struct PhaseResult {
+    QString name;
+    double best = 0;    // Seconds, fastest run
+    double total = 0;   // Seconds, all runs
+    qint64 tokens = 0;
+    qint64 nodes = 0;
+};
+
+qint64 peakRssBytes() {
+#if defined(Q_OS_WIN)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return -1;
+    }
+    return qint64(counters.PeakWorkingSetSize);
+#elif defined(Q_OS_UNIX)
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return -1;
+    }
+#if defined(Q_OS_MACOS)
+    return qint64(usage.ru_maxrss);         // Bytes on macOS
+#else
+    return qint64(usage.ru_maxrss) * 1024;  // Kilobytes elsewhere
+#endif
+#else
+    return -1;
+#endif
+}
+
+// Same nodes in the same order, with the same interned names and numbers
+bool sameAst(const FlatAst &a, const FlatAst &b) {
+    if (a.root != b.root || a.nodes.size() != b.nodes.size() ||
+        a.identifiers.size() != b.identifiers.size() || a.literals.size() != b.literals.size()) {
+        return false;
+    }
+    for (qsizetype i = 0; i < a.nodes.size(); ++i) {
+        const AstNode &x = a.nodes[i];
+        const AstNode &y = b.nodes[i];
+        if (x.kind != y.kind || x.op != y.op || x.childCount != y.childCount || x.payload != y.payload ||
+            x.sibling != y.sibling || !std::equal(std::begin(x.children), std::end(x.children), std::begin(y.children))) {
+            return false;
+        }
+    }
+    for (quint32 id = 0; id < quint32(a.identifiers.size()); ++id) {
+        if (a.identifiers.text(id) != b.identifiers.text(id)) {
+            return false;
+        }
+    }
+    for (quint32 id = 0; id < quint32(a.literals.size()); ++id) {
+        if (a.literals.text(id) != b.literals.text(id)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Seconds taken by body
+double timed(const std::function<void()> &body) {
+    QElapsedTimer timer;
+    timer.start();
+    body();
+    return timer.nsecsElapsed() / 1e9;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("tinybench");
+
+    QCommandLineParser cli;
+    cli.setApplicationDescription("Times the TINY scanner, parser, tree building and layout on a generated program.");
+    cli.addHelpOption();
+    QCommandLineOption size({"s", "size"}, "Program size in bytes, with optional K/M/G suffix (1K to 1G).", "bytes", "1M");
+    QCommandLineOption seed("seed", "Generator seed.", "n", "1");
+    QCommandLineOption mix("mix", "Statement weights, e.g. assign=5,read=1,write=2,if=2,repeat=1.", "weights");
+    QCommandLineOption expressionDepth("expr-depth", "Deepest parenthesized sub-expression nesting.", "n", "4");
+    QCommandLineOption nesting("nesting", "Deepest if/repeat nesting.", "n", "3");
+    QCommandLineOption comments("comments", "Chance of a comment before each statement (0 to 1).", "p", "0.1");
+    QCommandLineOption variables("variables", "Number of distinct variables.", "n", "64");
+    QCommandLineOption runs({"r", "runs"}, "Time each phase <n> times; the fastest run is reported.", "n", "3");
+    QCommandLineOption phases("phases", "Comma-separated phases: tokenize, scan, pscan, parse, pparse, tree, layout, destroy (default all).", "list");
+    QCommandLineOption threads({"t", "threads"}, "Threads for the pscan and pparse phases (default: one per core).", "n", "0");
+    QCommandLineOption output({"o", "output"}, "Write the JSON report to <file> instead of stdout.", "file");
+    QCommandLineOption saveProgram("save-program", "Also write the generated program to <file>.", "file");
+    QCommandLineOption verify("verify", "Also parse with the recursive-descent parser (untimed) and fail unless it builds the same tree.");
+    cli.addOptions({size, seed, mix, expressionDepth, nesting, comments, variables, runs, phases, threads, output, saveProgram, verify});
+    cli.process(app);
+
+    GeneratorOptions options;
+    options.seed = cli.value(seed).toULongLong();
+    options.targetBytes = parseByteSize(cli.value(size));
+    options.maxExpressionDepth = cli.value(expressionDepth).toInt();
+    options.maxNesting = cli.value(nesting).toInt();
+    options.commentDensity = cli.value(comments).toDouble();
+    options.variables = cli.value(variables).toInt();
+    if (options.targetBytes < 1) {
+        std::fprintf(stderr, "tinybench: invalid size '%s'\n", qPrintable(cli.value(size)));
+        return 2;
+    }
+    if (cli.isSet(mix) && !parseStatementMix(cli.value(mix), options)) {
+        std::fprintf(stderr, "tinybench: invalid statement mix '%s'\n", qPrintable(cli.value(mix)));
+        return 2;
+    }
+
+    QStringList selected;
+    for (const char *phase : AllPhases) {
+        selected.append(phase);
+    }
+    if (cli.isSet(phases)) {
+        selected = cli.value(phases).split(',', Qt::SkipEmptyParts);
+        for (const QString &phase : selected) {
+            if (!std::any_of(std::begin(AllPhases), std::end(AllPhases), [&](const char *name) { return phase == name; })) {
+                std::fprintf(stderr, "tinybench: unknown phase '%s'\n", qPrintable(phase));
+                return 2;
+            }
+        }
+    }
+    int runCount = qMax(1, cli.value(runs).toInt());
+
+    ProgramGenerator generator(options);
+    QByteArray program;
+    double generateTime = timed([&] { program = generator.generate(); });
+    if (cli.isSet(saveProgram)) {
+        QFile file(cli.value(saveProgram));
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(program) != program.size()) {
+            std::fprintf(stderr, "tinybench: cannot write '%s'\n", qPrintable(cli.value(saveProgram)));
+            return 1;
+        }
+    }
+
+    // Each phase works on the previous phase's result; phases that weren't
+    // selected still run, untimed, when a later one needs their output
+    QList<PhaseResult> results;
+    for (const char *phase : AllPhases) {
+        if (selected.contains(phase)) {
+            results.append(PhaseResult{phase});
+        }
+    }
+    auto record = [&](const char *phase, double seconds, qint64 tokens, qint64 nodes) {
+        for (PhaseResult &result : results) {
+            if (result.name == phase) {
+                result.best = result.total == 0 ? seconds : qMin(result.best, seconds);
+                result.total += seconds;
+                result.tokens = tokens;
+                result.nodes = nodes;
+            }
+        }
+    };
+    auto wanted = [&](const char *phase) { return selected.contains(phase); };
+    bool needTree = wanted("tree") || wanted("layout");
+    bool needAst = needTree || wanted("parse") || wanted("destroy");
+
+    const char *data = program.constData();
+    qint64 tokenCount = 0;
+    qint64 nodeCount = 0;
+    FlatAst ast;
+    SyntaxTreeArena arena;
+    TreeLayout layout;
+    PipelineStats sizes;    // What the last run built, before it was destroyed
+    try {
+        for (int run = 0; run < runCount; ++run) {
+            if (wanted("tokenize")) {
+                QString text = QString::fromUtf8(program);
+                QList<Token> tokens;
+                double seconds = timed([&] { tokens = tokenize(text); });
+                record("tokenize", seconds, tokens.size(), 0);
+            }
+
+            if (wanted("pscan")) {
+                QList<CompactToken> tokens;
+                double seconds = timed([&] { tokens = tokenizeParallel(data, program.size(), nullptr, cli.value(threads).toInt()); });
+                record("pscan", seconds, tokens.size(), 0);
+            }
+
+            QList<CompactToken> compact;
+            if (wanted("scan") || wanted("pparse") || needAst) {
+                double seconds = timed([&] { compact = tokenizeCompact(data, program.size()); });
+                tokenCount = compact.size();
+                record("scan", seconds, tokenCount, 0);
+            }
+
+            if (needAst) {
+                double seconds = timed([&] {
+                    CompactTokenSource source(compact, data);
+                    Parser parser(source);
+                    parser.setStrategy(Parser::Strategy::ExplicitStack);
+                    parser.parse(ast);
+                });
+                nodeCount = ast.nodes.size();
+                record("parse", seconds, tokenCount, nodeCount);
+
+                // The explicit-stack parser must build exactly what recursive descent builds
+                if (cli.isSet(verify) && run == 0) {
+                    CompactTokenSource source(compact, data);
+                    Parser parser(source);
+                    parser.setStrategy(Parser::Strategy::RecursiveDescent);
+                    FlatAst reference;
+                    parser.parse(reference);
+                    if (!sameAst(ast, reference)) {
+                        std::fprintf(stderr, "tinybench: explicit-stack and recursive-descent parses differ\n");
+                        return 1;
+                    }
+                }
+            }
+
+            if (wanted("pparse")) {
+                FlatAst parallelAst;
+                double seconds = timed([&] { parseParallel(compact, data, parallelAst, nullptr, cli.value(threads).toInt()); });
+                record("pparse", seconds, tokenCount, parallelAst.nodes.size());
+            }
+
+            SyntaxTreeNode *root = nullptr;
+            if (needTree) {
+                double seconds = timed([&] { root = ast.toSyntaxTree(arena); });
+                record("tree", seconds, tokenCount, arena.nodeCount());
+            }
+
+            if (wanted("layout")) {
+                double seconds = timed([&] { layout.compute(root, 20, 60); });
+                record("layout", seconds, tokenCount, layout.placements().size());
+            }
+
+            if (run == runCount - 1) {
+                sizes.addTokens(compact);
+                if (needAst) {
+                    sizes.addAst(ast);
+                }
+                if (needTree) {
+                    sizes.addTree(arena);
+                }
+                sizes.addLayout(layout);
+            }
+
+            double seconds = timed([&] {
+                layout.clear();
+                arena.reset();
+                ast.clear();
+                compact = QList<CompactToken>();
+            });
+            record("destroy", seconds, tokenCount, nodeCount);
+        }
+    } catch (const std::exception &e) {
+        std::fprintf(stderr, "tinybench: %s\n", e.what());
+        return 1;
+    }
+
+    QJsonObject generatorJson{
+        {"seed", qint64(options.seed)},
+        {"targetBytes", options.targetBytes},
+        {"bytes", qint64(program.size())},
+        {"statements", generator.statementCount()},
+        {"mix", QJsonObject{{"assign", options.assignWeight}, {"read", options.readWeight},
+                            {"write", options.writeWeight}, {"if", options.ifWeight},
+                            {"repeat", options.repeatWeight}}},
+        {"maxExpressionDepth", options.maxExpressionDepth},
+        {"maxNesting", options.maxNesting},
+        {"commentDensity", options.commentDensity},
+        {"variables", options.variables},
+        {"seconds", generateTime},
+    };
+
+    QJsonArray phaseJson;
+    for (const PhaseResult &result : results) {
+        double best = result.best > 0 ? result.best : 1e-9;
+        phaseJson.append(QJsonObject{
+            {"name", result.name},
+            {"bestSeconds", result.best},
+            {"meanSeconds", result.total / runCount},
+            {"mbPerSecond", program.size() / 1e6 / best},
+            {"tokensPerSecond", result.tokens / best},
+            {"nodesPerSecond", result.nodes / best},
+        });
+    }
+
+    QJsonObject report{
+        {"generator", generatorJson},
+        {"tokens", tokenCount},
+        {"nodes", nodeCount},
+        {"runs", runCount},
+        {"threads", cli.value(threads).toInt()},
+        {"phases", phaseJson},
+        {"bytesAllocated", sizes.bytesAllocated},
+        {"layoutItems", sizes.layoutItems},
+        {"peakRssBytes", peakRssBytes()},
+    };
+    if (cli.isSet(verify)) {
+        report.insert("verified", needAst);
+    }
+    QByteArray json = QJsonDocument(report).toJson(QJsonDocument::Indented);
+
+    if (cli.isSet(output)) {
+        QFile file(cli.value(output));
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(json) != json.size()) {
+            std::fprintf(stderr, "tinybench: cannot write '%s'\n", qPrintable(cli.value(output)));
+            return 1;
+        }
+    } else {
+        std::fwrite(json.constData(), 1, size_t(json.size()), stdout);
+    }
+    return 0;
+}
@@ -0,0 +1,22 @@
+QT = core
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TARGET = tinybench
+
+include(tinycore.pri)
+
+SOURCES += \
+    programgenerator.cpp \
+    tinybench.cpp
+
+HEADERS += \
+    programgenerator.h
+
+win32: LIBS += -lpsapi
+
+# Default rules for deployment.
+qnx: target.path = /tmp/$${TARGET}/bin
+else: unix:!android: target.path = /opt/$${TARGET}/bin
+!isEmpty(target.path): INSTALLS += target
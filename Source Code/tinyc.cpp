@@ -0,0 +1,435 @@
+#include "token.h"
+#include "astcache.h"
+#if defined(Q_OS_UNIX)
+#include "compileserver.h"
+#endif
+#include "diagnostics.h"
+#include "parallelparse.h"
+#include "parallelscan.h"
+#include "parser.h"
+#include "pipelinestats.h"
+#include "semantics.h"
+#include "sourcebuffer.h"
+#include "threadpool.h"
+#include "tokenexport.h"
+#include "trace.h"
+#include "treeexport.h"
+#include "treelayout.h"
+#include <QBuffer>
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QTextStream>
+#include <atomic>
+#include <cstdio>
+#include <exception>
+#include <mutex>
+
+// Headless batch driver: scans and/or parses every input file on a
+// work-stealing pool and writes "<name>.tokens.txt" / "<name>.ast.txt"
+// (or .ast.dot / .ast.svg).
+
+namespace {
+
+struct Options {
+    bool scan = true;
+    bool parse = true;
+    QString outputDir; // Empty = next to each input file
+    bool toStdout = false;
+    TokenFormat tokenFormat = TokenFormat::Text;
+    TreeFormat treeFormat = TreeFormat::Text;
+    qreal pageWidth = 0;    // SVG page size for --svg-pages; 0 = one document
+    qreal pageHeight = 0;
+    const AstCache *cache = nullptr; // Set by --cache
+    bool warnings = false;  // Use-before-assign check
+    bool symbols = false;   // Write <name>.symbols.txt
+    int fileThreads = 1;    // Threads scanning and parsing one file; more than one when a single input has the machine to itself
+};
+
+// Bump whenever the parser's output changes, so stale cache entries miss
+const char ToolVersion[] = "1.1";
+
+std::atomic<int> cacheHits{0};
+
+// Totals over every file, for --stats
+std::mutex statsMutex;
+PipelineStats totalStats;
+
+std::mutex errorMutex;
+
+void reportError(const QString &path, const QString &message) {
+    std::lock_guard<std::mutex> lock(errorMutex);
+    std::fprintf(stderr, "%s: %s\n", qPrintable(path), qPrintable(message));
+}
+
+QString outputPath(const Options &options, const QFileInfo &info, const QString &suffix) {
+    QString dir = options.outputDir.isEmpty() ? info.absolutePath() : options.outputDir;
+    return dir + '/' + info.completeBaseName() + suffix;
+}
+
+std::mutex stdoutMutex;
+
+// Write one output file. With --output -, it is assembled in memory and then
+// copied to stdout in one piece, so outputs from parallel jobs don't interleave.
+bool writeFile(const Options &options, const QString &path, const std::function<bool(QIODevice&)> &body) {
+    if (options.toStdout) {
+        QBuffer buffer;
+        buffer.open(QIODevice::WriteOnly);
+        if (!body(buffer)) {
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(stdoutMutex);
+        const QByteArray &data = buffer.data();
+        return std::fwrite(data.constData(), 1, data.size(), stdout) == size_t(data.size());
+    }
+
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return false;
+    }
+    return body(file) && file.flush();
+}
+
+void reportDiagnostics(const QString &path, const Diagnostics &diagnostics) {
+    std::lock_guard<std::mutex> lock(errorMutex);
+    for (const Diagnostic &diagnostic : diagnostics.items()) {
+        std::fprintf(stderr, "%s:%s\n", qPrintable(path), qPrintable(diagnostic.toString()));
+    }
+}
+
+// Write the tree in the chosen format: text and DOT straight from the nodes,
+// SVG from ast and its layout, as numbered pages when a page size is set
+template <class Tree>
+bool writeTree(const Options &options, const QFileInfo &info, const Tree &tree,
+               const FlatAst &ast, const TreeLayout &layout) {
+    if (options.treeFormat == TreeFormat::Svg && options.pageWidth > 0) {
+        QList<QRectF> pages = svgPages(layout, options.pageWidth, options.pageHeight);
+        for (qsizetype n = 0; n < pages.size(); ++n) {
+            QString pagePath = outputPath(options, info, ".ast-" + QString::number(n + 1) + ".svg");
+            bool ok = writeFile(options, pagePath, [&](QIODevice &device) {
+                return writeSvg(layout, ast, device, pages[n]);
+            });
+            if (!ok) {
+                reportError(pagePath, "unable to write syntax tree output");
+                return false;
+            }
+        }
+        return true;
+    }
+
+    QString astPath = outputPath(options, info, treeFormatSuffix(options.treeFormat));
+    bool ok = writeFile(options, astPath, [&](QIODevice &device) {
+        if (options.treeFormat == TreeFormat::Dot) {
+            return writeDot(tree, device);
+        } else if (options.treeFormat == TreeFormat::Svg) {
+            return writeSvg(layout, ast, device);
+        }
+        QTextStream writer(&device);
+        tree.dump(writer);
+        writer.flush();
+        return writer.status() == QTextStream::Ok;
+    });
+    if (!ok) {
+        reportError(astPath, "unable to write syntax tree output");
+    }
+    return ok;
+}
+
+bool processFile(const Options &options, const QString &path, PipelineStats &stats) {
+    QFileInfo info(path);
+    try {
+        // Scan straight out of the mapped file; lexemes are only copied when written
+        PhaseTimer readTimer(&stats, "read");
+        SourceBuffer source(path);
+        readTimer.stop();
+
+        // Every error in the file is collected and reported together
+        Diagnostics diagnostics;
+        diagnostics.setSource(source.data(), source.size());
+
+        QList<CompactToken> scanned;
+        if (options.scan) {
+            PhaseTimer scanTimer(&stats, "scan");
+            scanned = tokenizeParallel(source.data(), source.size(), &diagnostics, options.fileThreads);
+            scanTimer.stop();
+            stats.addTokens(scanned);
+            PhaseTimer writeTimer(&stats, "write");
+            QString tokensPath = outputPath(options, info, tokenFormatSuffix(options.tokenFormat));
+            bool ok = writeFile(options, tokensPath, [&](QIODevice &device) {
+                TokenWriter writer(device, options.tokenFormat);
+                for (const CompactToken &token : scanned) {
+                    writer.write(token, source.data());
+                }
+                return writer.finish();
+            });
+            if (!ok) {
+                reportError(tokensPath, "unable to write token output");
+                return false;
+            }
+        }
+
+        // An unchanged input was parsed before: dump the cached tree as it lies in the mapped file
+        std::unique_ptr<CachedAst> cached;
+        QString cacheKey;
+        // Warnings and symbol reports need source positions, which the cache
+        // doesn't keep, and SVG is laid out from a FlatAst; those runs still
+        // key the file so their fresh parse can be stored
+        bool needSymbols = options.warnings || options.symbols;
+        if (options.parse && options.cache) {
+            PhaseTimer cacheTimer(&stats, "cache");
+            cacheKey = options.cache->key(source.data(), source.size());
+            if (!needSymbols && options.treeFormat != TreeFormat::Svg) {
+                cached = options.cache->find(cacheKey);
+            }
+        }
+        if (cached) {
+            cacheHits++;
+            PhaseTimer writeTimer(&stats, "write");
+            if (!writeTree(options, info, cached->ast(), FlatAst(), TreeLayout())) {
+                return false;
+            }
+        } else if (options.parse) {
+            // Reuse the scan when there was one; otherwise the parser pulls
+            // tokens from the lexer as it goes and no token list is built
+            CompactTokenSource scannedTokens(scanned, source.data());
+            LexerTokenSource lexedTokens(source.data(), source.size(), &diagnostics);
+            TokenSource &tokens = options.scan ? static_cast<TokenSource &>(scannedTokens) : lexedTokens;
+
+            // Each worker reuses one flat AST (and its capacity) for every file it parses
+            thread_local FlatAst ast;
+            thread_local SymbolTable symbols;
+            PhaseTimer parseTimer(&stats, "parse");
+            if (options.scan && options.fileThreads != 1 && !needSymbols) {
+                // Split the top-level statements between threads as well
+                parseParallel(scanned, source.data(), ast, &diagnostics, options.fileThreads);
+            } else {
+                Parser parser(tokens);
+                parser.setStrategy(Parser::Strategy::ExplicitStack); // Generated code can nest very deeply
+                parser.setDiagnostics(&diagnostics);
+                parser.setSymbols(needSymbols ? &symbols : nullptr);
+                parser.parse(ast);
+                if (!options.scan) {
+                    stats.tokensScanned += parser.tokenCount(); // Scanned during the parse
+                }
+            }
+            parseTimer.stop();
+            stats.addAst(ast);
+            if (options.warnings) {
+                PhaseTimer checkTimer(&stats, "check");
+                checkUseBeforeAssign(ast, symbols, diagnostics);
+            }
+            // Only SVG needs a layout; it is reused like the AST
+            thread_local TreeLayout layout;
+            if (options.treeFormat == TreeFormat::Svg) {
+                PhaseTimer layoutTimer(&stats, "layout");
+                layout.compute(ast, TreeLayout::DefaultXSpacing, TreeLayout::DefaultYSpacing);
+                layoutTimer.stop();
+                stats.addLayout(layout);
+            }
+            PhaseTimer writeTimer(&stats, "write");
+            if (options.symbols) {
+                QString symbolsPath = outputPath(options, info, ".symbols.txt");
+                bool ok = writeFile(options, symbolsPath, [&](QIODevice &device) {
+                    QTextStream writer(&device);
+                    writer << symbolReport(ast, symbols, diagnostics);
+                    writer.flush();
+                    return writer.status() == QTextStream::Ok;
+                });
+                if (!ok) {
+                    reportError(symbolsPath, "unable to write symbol report");
+                    return false;
+                }
+            }
+            if (!writeTree(options, info, ast, ast, layout)) {
+                return false;
+            }
+            writeTimer.stop();
+
+            // Only clean parses are cached; files with errors are re-parsed so they get reported again
+            if (options.cache && !diagnostics.hasErrors()) {
+                PhaseTimer cacheTimer(&stats, "cache");
+                if (!options.cache->store(cacheKey, ast)) {
+                    reportError(path, "unable to write cache entry");
+                }
+            }
+        }
+
+        // Warnings are printed too, but only errors fail the file
+        reportDiagnostics(path, diagnostics);
+        if (diagnostics.hasErrors()) {
+            return false;
+        }
+    } catch (const std::exception &e) {  // Including bad_alloc: one file mustn't end the batch
+        reportError(path, e.what());
+        return false;
+    }
+    return true;
+}
+
+// Expand directories into the .tiny files they contain (recursively)
+QStringList collectInputs(const QStringList &arguments) {
+    QStringList inputs;
+    for (const QString &argument : arguments) {
+        QFileInfo info(argument);
+        if (info.isDir()) {
+            QDirIterator it(argument, QStringList() << "*.tiny", QDir::Files,
+                            QDirIterator::Subdirectories);
+            while (it.hasNext()) {
+                inputs.append(it.next());
+            }
+        } else {
+            inputs.append(argument);
+        }
+    }
+    return inputs;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("tinyc");
+    QCoreApplication::setApplicationVersion(ToolVersion);
+
+    QCommandLineParser cli;
+    cli.setApplicationDescription("Batch scanner/parser for TINY programs.");
+    cli.addHelpOption();
+    cli.addPositionalArgument("inputs", "TINY source files or directories of .tiny files.", "<inputs...>");
+    QCommandLineOption scanOnly({"s", "scan"}, "Only scan; write <name>.tokens.txt.");
+    QCommandLineOption parseOnly({"p", "parse"}, "Only parse; write <name>.ast.txt.");
+    QCommandLineOption tree({"t", "tree"}, "Syntax tree output format: text, dot (Graphviz) or svg.", "format", "text");
+    QCommandLineOption pages("svg-pages", "Split SVG trees into pages of at most <size> (e.g. 4000x3000), written as <name>.ast-<n>.svg.", "size");
+    QCommandLineOption outputDir({"o", "output"}, "Write outputs into <dir> instead of next to each input (- for stdout).", "dir");
+    QCommandLineOption format({"f", "format"}, "Token output format: text, jsonl or binary.", "format", "text");
+    QCommandLineOption cacheDir({"c", "cache"}, "Reuse syntax trees of unchanged inputs from <dir>.", "dir");
+    QCommandLineOption jobs({"j", "jobs"}, "Number of worker threads (default: one per core).", "n", "0");
+    QCommandLineOption warnings({"w", "warnings"}, "Warn about variables used before they are assigned.");
+    QCommandLineOption symbols("symbols", "Write <name>.symbols.txt: each variable's counts and first assignment.");
+    QCommandLineOption stats("stats", "Write phase times and token/node/byte counts over all inputs as JSON to <file> (- for stderr).", "file");
+    QCommandLineOption verbose({"v", "verbose"}, "Report cache hits, and trace the parser (builds with TINY_TRACE_LEVEL > 0).");
+    cli.addOptions({scanOnly, parseOnly, tree, pages, outputDir, format, cacheDir, jobs, warnings, symbols, stats, verbose});
+#if defined(Q_OS_UNIX)
+    QCommandLineOption serve("serve", "Run as a compile server for tinyclient on a Unix socket, until interrupted.");
+    QCommandLineOption socket("socket", "Socket for --serve (default: $TINYC_SOCKET, else tinyc-<uid>.sock in $XDG_RUNTIME_DIR or /tmp).", "path");
+    cli.addOptions({serve, socket});
+#endif
+    cli.process(app);
+
+#if defined(Q_OS_UNIX)
+    if (cli.isSet(serve)) {
+        QString path = cli.isSet(socket) ? cli.value(socket) : QString::fromStdString(defaultSocketPath());
+        CompileServer server;
+        return server.serve(path, cli.value(jobs).toInt());
+    }
+#endif
+
+    Options options;
+    if (cli.isSet(scanOnly) && !cli.isSet(parseOnly)) {
+        options.parse = false;
+    } else if (cli.isSet(parseOnly) && !cli.isSet(scanOnly)) {
+        options.scan = false;
+    }
+    if (!parseTokenFormat(cli.value(format), options.tokenFormat)) {
+        std::fprintf(stderr, "tinyc: unknown token format '%s'\n", qPrintable(cli.value(format)));
+        return 2;
+    }
+    if (!parseTreeFormat(cli.value(tree), options.treeFormat)) {
+        std::fprintf(stderr, "tinyc: unknown tree format '%s'\n", qPrintable(cli.value(tree)));
+        return 2;
+    }
+    if (cli.isSet(pages)) {
+        QStringList size = cli.value(pages).split('x');
+        bool widthOk = false, heightOk = false;
+        if (size.size() == 2) {
+            options.pageWidth = size[0].toDouble(&widthOk);
+            options.pageHeight = size[1].toDouble(&heightOk);
+        }
+        if (!widthOk || !heightOk || options.pageWidth <= 0 || options.pageHeight <= 0) {
+            std::fprintf(stderr, "tinyc: invalid page size '%s', expected WIDTHxHEIGHT\n", qPrintable(cli.value(pages)));
+            return 2;
+        }
+    }
+    if (cli.value(outputDir) == "-") {
+        options.toStdout = true;
+    } else if (cli.isSet(outputDir)) {
+        options.outputDir = cli.value(outputDir);
+        if (!QDir().mkpath(options.outputDir)) {
+            std::fprintf(stderr, "tinyc: cannot create output directory '%s'\n", qPrintable(options.outputDir));
+            return 2;
+        }
+    }
+    options.warnings = cli.isSet(warnings);
+    options.symbols = cli.isSet(symbols);
+    std::unique_ptr<AstCache> cache;
+    if (cli.isSet(cacheDir)) {
+        cache = std::make_unique<AstCache>(cli.value(cacheDir), ToolVersion);
+        options.cache = cache.get();
+    }
+    if (cli.isSet(verbose)) {
+        setTraceLevel(TraceLevel::Tokens);
+    }
+
+    QStringList inputs = collectInputs(cli.positionalArguments());
+    if (inputs.isEmpty()) {
+        cli.showHelp(2);
+    }
+    // Files are spread over the pool; a lone (possibly huge) file is split up instead
+    if (inputs.size() == 1) {
+        options.fileThreads = cli.value(jobs).toInt();
+    }
+
+    std::atomic<int> failures{0};
+    QElapsedTimer wallTimer;
+    wallTimer.start();
+    {
+        WorkStealingPool pool(cli.value(jobs).toInt());
+        for (const QString &path : inputs) {
+            pool.submit([&options, &failures, path] {
+                PipelineStats fileStats;
+                if (!processFile(options, path, fileStats)) {
+                    failures++;
+                }
+                std::lock_guard<std::mutex> lock(statsMutex);
+                totalStats.merge(fileStats);
+            });
+        }
+        pool.wait();
+    }
+
+    if (cli.isSet(stats)) {
+        // Phase times are summed over the workers; wallSeconds is the whole batch
+        QJsonObject report = totalStats.toJson();
+        report.insert("files", int(inputs.size()));
+        report.insert("failed", failures.load());
+        report.insert("cacheHits", cacheHits.load());
+        report.insert("wallSeconds", wallTimer.nsecsElapsed() / 1e9);
+        QByteArray json = QJsonDocument(report).toJson(QJsonDocument::Indented);
+        bool written;
+        if (cli.value(stats) == "-") {
+            written = std::fwrite(json.constData(), 1, size_t(json.size()), stderr) == size_t(json.size());
+        } else {
+            QFile file(cli.value(stats));
+            written = file.open(QIODevice::WriteOnly | QIODevice::Truncate) && file.write(json) == json.size();
+        }
+        if (!written) {
+            std::fprintf(stderr, "tinyc: cannot write '%s'\n", qPrintable(cli.value(stats)));
+            return 1;
+        }
+    }
+
+    if (cache && cli.isSet(verbose)) {
+        std::fprintf(stderr, "tinyc: %d of %d syntax tree(s) from cache\n", cacheHits.load(), int(inputs.size()));
+    }
+
+    if (failures > 0) {
+        std::fprintf(stderr, "tinyc: %d of %d file(s) failed\n", failures.load(), int(inputs.size()));
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,27 @@
+QT = core
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TARGET = tinyc
+
+include(tinycore.pri)
+
+SOURCES += \
+    tinyc.cpp
+
+# The compile server (--serve) talks to tinyclient over a Unix domain socket
+unix {
+    SOURCES += \
+        compileprotocol.cpp \
+        compileserver.cpp
+
+    HEADERS += \
+        compileprotocol.h \
+        compileserver.h
+}
+
+# Default rules for deployment.
+qnx: target.path = /tmp/$${TARGET}/bin
+else: unix:!android: target.path = /opt/$${TARGET}/bin
+!isEmpty(target.path): INSTALLS += target
@@ -0,0 +1,217 @@
+#include "compileprotocol.h"
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <vector>
+
+// Thin front end for "tinyc --serve": forwards a tinyc-style command line to
+// the server one file at a time and writes what comes back, so every file
+// costs a round trip on a local socket instead of a process with Qt in it.
+// Deliberately free of Qt; it only links the wire protocol.
+
+namespace {
+
+const char Usage[] =
+    "Usage: tinyclient [-S socket] [-s|-p] [-f text|jsonl|binary] [-w] [--symbols] [-o dir|-] <file.tiny|->...\n"
+    "Sends each file to a running \"tinyc --serve\" and writes <name>.tokens.txt / <name>.ast.txt\n"
+    "(and <name>.symbols.txt) like tinyc does. - reads a program from stdin and writes to stdout.\n";
+
+struct Options {
+    std::string socket = defaultSocketPath();
+    uint8_t flags = WantTokens | WantTree;
+    uint8_t tokenFormat = 0;
+    const char *tokenSuffix = ".tokens.txt";
+    std::string outputDir;  // Empty = next to each input
+    bool toStdout = false;
+};
+
+bool writeOutput(const Options &options, const std::string &input, const char *suffix, const std::string &data) {
+    if (options.toStdout || input == "-") {
+        return std::fwrite(data.data(), 1, data.size(), stdout) == data.size();
+    }
+    // <dir>/<name without its last extension><suffix>, as tinyc names outputs
+    size_t slash = input.rfind('/');
+    std::string dir = options.outputDir.empty() ? (slash == std::string::npos ? "." : input.substr(0, slash))
+                                                : options.outputDir;
+    std::string name = slash == std::string::npos ? input : input.substr(slash + 1);
+    size_t dot = name.rfind('.');
+    if (dot != std::string::npos && dot > 0) {
+        name.resize(dot);
+    }
+    std::string path = dir + '/' + name + suffix;
+    FILE *file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        std::fprintf(stderr, "%s: unable to write output\n", path.c_str());
+        return false;
+    }
+    bool ok = std::fwrite(data.data(), 1, data.size(), file) == data.size();
+    return std::fclose(file) == 0 && ok;
+}
+
+// Diagnostics come back as "line:column: ..." lines, or a bare message when
+// the request failed; prefix each with the input
+void reportDiagnostics(const std::string &input, const std::string &text, const char *separator) {
+    const char *name = input == "-" ? "<stdin>" : input.c_str();
+    size_t start = 0;
+    while (start < text.size()) {
+        size_t end = text.find('\n', start);
+        if (end == std::string::npos) {
+            end = text.size();
+        }
+        std::fprintf(stderr, "%s%s%.*s\n", name, separator, int(end - start), text.data() + start);
+        start = end + 1;
+    }
+}
+
+bool readStdin(std::string &text) {
+    char chunk[1 << 16];
+    size_t n;
+    while ((n = std::fread(chunk, 1, sizeof chunk, stdin)) > 0) {
+        text.append(chunk, n);
+    }
+    return !std::ferror(stdin);
+}
+
+int connectTo(const std::string &path) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof address.sun_path) {
+        return -1;
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd >= 0 && ::connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof address) != 0) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    Options options;
+    std::vector<std::string> inputs;
+    bool scanOnly = false;
+    bool parseOnly = false;
+    bool warnings = false;
+    bool symbols = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "-h" || arg == "--help") {
+            std::fputs(Usage, stdout);
+            return 0;
+        } else if ((arg == "-S" || arg == "--socket") && hasValue) {
+            options.socket = argv[++i];
+        } else if (arg == "-s" || arg == "--scan") {
+            scanOnly = true;
+        } else if (arg == "-p" || arg == "--parse") {
+            parseOnly = true;
+        } else if (arg == "-w" || arg == "--warnings") {
+            warnings = true;
+        } else if (arg == "--symbols") {
+            symbols = true;
+        } else if ((arg == "-o" || arg == "--output") && hasValue) {
+            std::string dir = argv[++i];
+            options.toStdout = dir == "-";
+            options.outputDir = options.toStdout ? std::string() : dir;
+        } else if ((arg == "-f" || arg == "--format") && hasValue) {
+            std::string format = argv[++i];
+            if (format == "text") {
+                options.tokenFormat = 0;
+                options.tokenSuffix = ".tokens.txt";
+            } else if (format == "jsonl") {
+                options.tokenFormat = 1;
+                options.tokenSuffix = ".tokens.jsonl";
+            } else if (format == "binary") {
+                options.tokenFormat = 2;
+                options.tokenSuffix = ".tokens.bin";
+            } else {
+                std::fprintf(stderr, "tinyclient: unknown token format '%s'\n", format.c_str());
+                return 2;
+            }
+        } else if (arg.size() > 1 && arg[0] == '-') {
+            std::fprintf(stderr, "tinyclient: unknown option '%s'\n%s", arg.c_str(), Usage);
+            return 2;
+        } else {
+            inputs.push_back(arg);
+        }
+    }
+    if (inputs.empty()) {
+        std::fputs(Usage, stderr);
+        return 2;
+    }
+    if (scanOnly != parseOnly) {
+        options.flags = scanOnly ? WantTokens : WantTree;
+    }
+    options.flags |= (warnings ? Warnings : 0) | (symbols ? WantSymbols : 0);
+
+    int fd = connectTo(options.socket);
+    if (fd < 0) {
+        std::fprintf(stderr, "tinyclient: no compile server on %s (start one with tinyc --serve)\n", options.socket.c_str());
+        return 2;
+    }
+    if (!peerIsCurrentUser(fd)) {
+        std::fprintf(stderr, "tinyclient: the server on %s runs as another user\n", options.socket.c_str());
+        ::close(fd);
+        return 2;
+    }
+
+    // The server has its own working directory, so paths go out absolute
+    char cwd[4096];
+    std::string base = ::getcwd(cwd, sizeof cwd) ? std::string(cwd) + '/' : std::string();
+
+    int failures = 0;
+    for (const std::string &input : inputs) {
+        CompileRequest request;
+        request.flags = options.flags;
+        request.tokenFormat = options.tokenFormat;
+        if (input == "-") {
+            request.flags |= InlineSource;
+            if (!readStdin(request.payload)) {
+                std::fprintf(stderr, "tinyclient: cannot read stdin\n");
+                failures++;
+                continue;
+            }
+        } else {
+            request.payload = input[0] == '/' ? input : base + input;
+        }
+
+        std::string frame;
+        CompileReply reply;
+        if (!writeFrame(fd, encodeRequest(request)) || !readFrame(fd, frame) || !decodeReply(frame, reply)) {
+            std::fprintf(stderr, "tinyclient: lost the connection to the compile server\n");
+            ::close(fd);
+            return 2;
+        }
+
+        bool ok = reply.status == CompileStatus::Ok;
+        if (reply.status != CompileStatus::Failed) {
+            if (options.flags & WantTokens) {
+                ok = writeOutput(options, input, options.tokenSuffix, reply.tokens) && ok;
+            }
+            if (options.flags & WantSymbols) {
+                ok = writeOutput(options, input, ".symbols.txt", reply.symbols) && ok;
+            }
+            if (options.flags & WantTree) {
+                ok = writeOutput(options, input, ".ast.txt", reply.tree) && ok;
+            }
+        }
+        reportDiagnostics(input, reply.diagnostics, reply.status == CompileStatus::Failed ? ": " : ":");
+        if (!ok) {
+            failures++;
+        }
+    }
+    ::close(fd);
+
+    if (failures > 0) {
+        std::fprintf(stderr, "tinyclient: %d of %d file(s) failed\n", failures, int(inputs.size()));
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,19 @@
+TEMPLATE = app
+
+# Plain C++: starting the client must cost far less than the work it forwards
+CONFIG += c++17 console
+CONFIG -= app_bundle qt
+
+TARGET = tinyclient
+
+SOURCES += \
+    compileprotocol.cpp \
+    tinyclient.cpp
+
+HEADERS += \
+    compileprotocol.h
+
+# Default rules for deployment.
+qnx: target.path = /tmp/$${TARGET}/bin
+else: unix:!android: target.path = /opt/$${TARGET}/bin
+!isEmpty(target.path): INSTALLS += target
@@ -0,0 +1,66 @@
+# Scanner, parser and syntax tree shared by the GUI and the tinyc batch tool.
+# Only needs QtCore; anything that touches widgets stays out of this file.
+#
+# Parser tracing is compiled in up to TINY_TRACE_LEVEL (0 = none, 3 = every
+# token; default 0 in release builds, 3 in debug builds), e.g.
+#   DEFINES += TINY_TRACE_LEVEL=1
+
+CONFIG += c++17
+
+INCLUDEPATH += $$PWD
+DEPENDPATH += $$PWD
+
+SOURCES += \
+    $$PWD/astcache.cpp \
+    $$PWD/bytecode.cpp \
+    $$PWD/diagnostics.cpp \
+    $$PWD/flatast.cpp \
+    $$PWD/optimizer.cpp \
+    $$PWD/parallelparse.cpp \
+    $$PWD/parallelscan.cpp \
+    $$PWD/parser.cpp \
+    $$PWD/pipelinestats.cpp \
+    $$PWD/scankernels.cpp \
+    $$PWD/semantics.cpp \
+    $$PWD/sourcebuffer.cpp \
+    $$PWD/stringinterner.cpp \
+    $$PWD/symboltable.cpp \
+    $$PWD/syntaxtree.cpp \
+    $$PWD/threadpool.cpp \
+    $$PWD/tmcode.cpp \
+    $$PWD/tmmachine.cpp \
+    $$PWD/token.cpp \
+    $$PWD/tokenexport.cpp \
+    $$PWD/tokenstream.cpp \
+    $$PWD/trace.cpp \
+    $$PWD/treeexport.cpp \
+    $$PWD/treelayout.cpp \
+    $$PWD/vm.cpp
+
+HEADERS += \
+    $$PWD/astcache.h \
+    $$PWD/bytecode.h \
+    $$PWD/diagnostics.h \
+    $$PWD/flatast.h \
+    $$PWD/keywords.h \
+    $$PWD/optimizer.h \
+    $$PWD/parallelparse.h \
+    $$PWD/parallelscan.h \
+    $$PWD/parser.h \
+    $$PWD/pipelinestats.h \
+    $$PWD/scankernels.h \
+    $$PWD/semantics.h \
+    $$PWD/sourcebuffer.h \
+    $$PWD/stringinterner.h \
+    $$PWD/symboltable.h \
+    $$PWD/syntaxtree.h \
+    $$PWD/threadpool.h \
+    $$PWD/tmcode.h \
+    $$PWD/tmmachine.h \
+    $$PWD/token.h \
+    $$PWD/tokenexport.h \
+    $$PWD/tokenstream.h \
+    $$PWD/trace.h \
+    $$PWD/treeexport.h \
+    $$PWD/treelayout.h \
+    $$PWD/vm.h
@@ -0,0 +1,36 @@
+#include "lspserver.h"
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <cstdio>
+
+#if defined(Q_OS_WIN)
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+// Language server for TINY: speaks LSP on stdin/stdout, so an editor can
+// show scan and syntax errors, variables and highlighting as the user types.
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("tinylsp");
+    QCoreApplication::setApplicationVersion("1.0");
+
+    QCommandLineParser cli;
+    cli.setApplicationDescription("Language server for TINY programs (LSP over stdio).");
+    cli.addHelpOption();
+    cli.addVersionOption();
+    QCommandLineOption stdio("stdio", "Talk to the client on stdin/stdout (the default and only transport).");
+    cli.addOption(stdio);
+    cli.process(app);
+
+#if defined(Q_OS_WIN)
+    // Content-Length counts bytes, so no CR/LF translation
+    _setmode(_fileno(stdin), _O_BINARY);
+    _setmode(_fileno(stdout), _O_BINARY);
+#endif
+
+    LspServer server(stdin, stdout);
+    return server.run();
+}
@@ -0,0 +1,22 @@
+QT = core
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TARGET = tinylsp
+
+include(tinycore.pri)
+
+SOURCES += \
+    lspdocument.cpp \
+    lspserver.cpp \
+    tinylsp.cpp
+
+HEADERS += \
+    lspdocument.h \
+    lspserver.h
+
+# Default rules for deployment.
+qnx: target.path = /tmp/$${TARGET}/bin
+else: unix:!android: target.path = /opt/$${TARGET}/bin
+!isEmpty(target.path): INSTALLS += target
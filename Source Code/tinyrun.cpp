@@ -0,0 +1,243 @@
+#include "bytecode.h"
+#include "diagnostics.h"
+#include "optimizer.h"
+#include "parser.h"
+#include "pipelinestats.h"
+#include "sourcebuffer.h"
+#include "tmcode.h"
+#include "tmmachine.h"
+#include "tokenstream.h"
+#include "vm.h"
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonDocument>
+#include <QTextStream>
+#include <cstdio>
+#include <exception>
+
+// Runs a TINY program: parses it, compiles it to register bytecode and
+// executes it on the virtual machine (or on the tree walker with --tree, or
+// as TM code on the built-in TM simulator with --tm). .tm listings run as is.
+
+namespace {
+
+// Parse the values given with --input ("1,2,3" or "1 2 3")
+bool parseInputs(const QString &text, QList<qint64> &values) {
+    QString normalized = text;
+    normalized.replace(',', ' ');
+    for (const QString &part : normalized.split(' ', Qt::SkipEmptyParts)) {
+        bool ok = false;
+        values.append(part.toLongLong(&ok));
+        if (!ok) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Average time of one run, in microseconds
+template <typename Run>
+double timeRuns(int runs, const QList<qint64> &input, Run run) {
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < runs; ++i) {
+        ListIo io(input);
+        run(io);
+    }
+    return timer.nsecsElapsed() / 1000.0 / runs;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("tinyrun");
+
+    QCommandLineParser cli;
+    cli.setApplicationDescription("Runs a TINY program on the bytecode virtual machine.");
+    cli.addHelpOption();
+    cli.addPositionalArgument("file", "TINY source file, or a TM listing (.tm).", "<file.tiny|file.tm>");
+    QCommandLineOption tree("tree", "Interpret the syntax tree directly instead of compiling it.");
+    QCommandLineOption dump("dump", "Print the bytecode instead of running it.");
+    QCommandLineOption input({"i", "input"}, "Values for read, instead of reading stdin (e.g. 3,5,8).", "values");
+    QCommandLineOption bench({"b", "bench"}, "Time <n> runs on both engines and print the speedup.", "n");
+    QCommandLineOption optimize({"O", "optimize"}, "Optimize the program before running it.");
+    QCommandLineOption passes("passes", "Optimize with only these passes: fold, constprop, copyprop, branches, deadstores.", "list");
+    QCommandLineOption report("report", "Print what the optimizer changed to stderr.");
+    QCommandLineOption tm("tm", "Generate TM code and run it on the TM simulator.");
+    QCommandLineOption emitTm("emit-tm", "Print the generated TM code instead of running it.");
+    QCommandLineOption profile("profile", "With --tm: print the step count, hottest instructions and loops to stderr.");
+    QCommandLineOption maxSteps("max-steps", "With --tm: stop after <n> TM instructions.", "n", "0");
+    QCommandLineOption stats("stats", "Write phase times and token/node/byte counts as JSON to <file> (- for stderr).", "file");
+    cli.addOptions({tree, dump, input, bench, optimize, passes, report, tm, emitTm, profile, maxSteps, stats});
+    cli.process(app);
+
+    QStringList files = cli.positionalArguments();
+    if (files.size() != 1) {
+        cli.showHelp(2);
+    }
+    QString path = files.first();
+
+    QList<qint64> values;
+    if (cli.isSet(input) && !parseInputs(cli.value(input), values)) {
+        std::fprintf(stderr, "tinyrun: invalid --input '%s'\n", qPrintable(cli.value(input)));
+        return 2;
+    }
+    OptimizerOptions optimizerOptions;
+    if (cli.isSet(passes) && !parseOptimizerPasses(cli.value(passes), optimizerOptions)) {
+        std::fprintf(stderr, "tinyrun: unknown optimizer pass in '%s'\n", qPrintable(cli.value(passes)));
+        return 2;
+    }
+
+    QTextStream out(stdout);
+    QTextStream in(stdin);
+    StreamIo streamIo(in, out);
+    ListIo listIo(values);
+    ProgramIo &io = cli.isSet(input) ? static_cast<ProgramIo &>(listIo) : streamIo;
+
+    // Every exit goes through here, so --stats covers failed runs too
+    PipelineStats pipeline;
+    auto finish = [&](int status) {
+        if (!cli.isSet(stats)) {
+            return status;
+        }
+        QByteArray json = QJsonDocument(pipeline.toJson()).toJson(QJsonDocument::Indented);
+        if (cli.value(stats) == "-") {
+            std::fwrite(json.constData(), 1, size_t(json.size()), stderr);
+            return status;
+        }
+        QFile file(cli.value(stats));
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(json) != json.size()) {
+            std::fprintf(stderr, "tinyrun: cannot write '%s'\n", qPrintable(cli.value(stats)));
+            return 1;
+        }
+        return status;
+    };
+
+    // Runs TM code on the simulator, with --profile and --max-steps
+    auto runTm = [&](const TmProgram &code) {
+        TmMachine machine;
+        TmProfile counters;
+        machine.setStepLimit(cli.value(maxSteps).toULongLong());
+        if (cli.isSet(profile)) {
+            machine.setProfile(&counters);
+        }
+        std::exception_ptr error; // The profile is printed for failed runs too
+        try {
+            PhaseTimer runTimer(&pipeline, "run");
+            machine.run(code, io);
+        } catch (const std::runtime_error &) {
+            error = std::current_exception();
+        }
+        if (cli.isSet(profile)) {
+            std::fprintf(stderr, "%s", qPrintable(counters.report(code)));
+        }
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    };
+
+    try {
+        if (path.endsWith(".tm")) {
+            QFile file(path);
+            if (!file.open(QIODevice::ReadOnly)) {
+                throw std::runtime_error("cannot open file");
+            }
+            PhaseTimer assembleTimer(&pipeline, "assemble");
+            TmProgram code = TmProgram::assemble(QString::fromUtf8(file.readAll()));
+            assembleTimer.stop();
+            runTm(code);
+            for (qint64 value : listIo.output) {
+                out << value << '\n';
+            }
+            return finish(0);
+        }
+
+        // The parse phase includes the scanning, which happens on demand
+        PhaseTimer parseTimer(&pipeline, "parse");
+        SourceBuffer source(path);
+        Diagnostics diagnostics;
+        diagnostics.setSource(source.data(), source.size());
+        LexerTokenSource tokens(source.data(), source.size(), &diagnostics);
+        FlatAst ast;
+        Parser parser(tokens);
+        parser.setStrategy(Parser::Strategy::ExplicitStack);
+        parser.setDiagnostics(&diagnostics);
+        parser.parse(ast);
+        parseTimer.stop();
+        pipeline.tokensScanned += parser.tokenCount();
+        pipeline.addAst(ast);
+        if (diagnostics.hasErrors()) {
+            for (const Diagnostic &diagnostic : diagnostics.items()) {
+                std::fprintf(stderr, "%s:%s\n", qPrintable(path), qPrintable(diagnostic.toString()));
+            }
+            return finish(1);
+        }
+
+        if (cli.isSet(optimize) || cli.isSet(passes)) {
+            PhaseTimer optimizeTimer(&pipeline, "optimize");
+            OptimizationReport changes = optimizeProgram(ast, optimizerOptions);
+            optimizeTimer.stop();
+            if (cli.isSet(report)) {
+                std::fprintf(stderr, "%s", qPrintable(changes.toString()));
+            }
+        }
+
+        if (cli.isSet(emitTm)) {
+            PhaseTimer generateTimer(&pipeline, "generate");
+            TmProgram code = generateTm(ast);
+            generateTimer.stop();
+            out << code.toAssembly();
+            return finish(0);
+        }
+
+        PhaseTimer compileTimer(&pipeline, "compile");
+        BytecodeProgram program = compileProgram(ast);
+        compileTimer.stop();
+        if (cli.isSet(dump)) {
+            out << program.disassemble();
+            return finish(0);
+        }
+
+        if (cli.isSet(bench)) {
+            int runs = qMax(1, cli.value(bench).toInt());
+            VirtualMachine vm;
+            TreeInterpreter walker;
+            double treeTime = timeRuns(runs, values, [&](ListIo &io) { walker.run(ast, io); });
+            double vmTime = timeRuns(runs, values, [&](ListIo &io) { vm.run(program, io); });
+            TmProgram tmCode = generateTm(ast);
+            TmMachine machine;
+            double tmTime = timeRuns(runs, values, [&](ListIo &io) { machine.run(tmCode, io); });
+            out << "tree walk: " << treeTime << " us/run\n"
+                << "bytecode:  " << vmTime << " us/run (" << program.code.size() << " instructions)\n"
+                << "TM:        " << tmTime << " us/run (" << machine.steps() << " steps, "
+                << (tmTime > 0 ? machine.steps() / tmTime : 0.0) << " Msteps/s)\n"
+                << "speedup:   " << (vmTime > 0 ? treeTime / vmTime : 0.0) << "x\n";
+            return finish(0);
+        }
+
+        if (cli.isSet(tm)) {
+            PhaseTimer generateTimer(&pipeline, "generate");
+            TmProgram code = generateTm(ast);
+            generateTimer.stop();
+            runTm(code);
+        } else {
+            PhaseTimer runTimer(&pipeline, "run");
+            if (cli.isSet(tree)) {
+                TreeInterpreter().run(ast, io);
+            } else {
+                VirtualMachine().run(program, io);
+            }
+        }
+        for (qint64 value : listIo.output) {
+            out << value << '\n';
+        }
+    } catch (const std::runtime_error &e) {
+        std::fprintf(stderr, "%s: %s\n", qPrintable(path), e.what());
+        return finish(1);
+    }
+    return finish(0);
+}
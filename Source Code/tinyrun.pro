@@ -0,0 +1,16 @@
+QT = core
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TARGET = tinyrun
+
+include(tinycore.pri)
+
+SOURCES += \
+    tinyrun.cpp
+
+# Default rules for deployment.
+qnx: target.path = /tmp/$${TARGET}/bin
+else: unix:!android: target.path = /opt/$${TARGET}/bin
+!isEmpty(target.path): INSTALLS += target
@@ -0,0 +1,317 @@
+#include "tmcode.h"
+#include <QStringList>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+// Registers as cgen names them
+constexpr quint8 Ac = 0;    // Accumulator
+constexpr quint8 Ac1 = 1;   // Second operand
+constexpr quint8 Gp = 5;    // Base of the variables (always 0)
+constexpr quint8 Mp = 6;    // Top of data memory, temporaries grow down from here
+constexpr quint8 Pc = TmProgram::PcReg;
+
+class TmGenerator {
+public:
+    TmGenerator(const FlatAst &ast, TmProgram &program) : ast(ast), program(program) {
+        // Rejected up front with the same error as compileProgram, rather than loaded as 0
+        for (qsizetype id = 0; id < ast.literals.size(); ++id) {
+            bool ok = false;
+            constants.push_back(ast.literals.text(quint32(id)).toLongLong(&ok));
+            if (!ok) {
+                QString errorMsg = QString("Constant out of range: '%1'").arg(ast.literals.text(quint32(id)));
+                throw std::runtime_error(errorMsg.toStdString());
+            }
+        }
+    }
+
+    void prelude();
+    void sequence(quint32 index);
+    void finish();
+
+private:
+    int emitRO(TmOp op, quint8 r, quint8 s, quint8 t, const QString &comment = QString());
+    int emitRM(TmOp op, quint8 r, qint64 d, quint8 s, const QString &comment = QString());
+    int skip() { return emitRO(TmOp::HALT, 0, 0, 0); }      // Placeholder patched later
+    void patchAbs(int at, TmOp op, quint8 r, int target, const QString &comment); // pc-relative jump to target
+    int here() const { return int(program.code.size()); }
+
+    void expression(quint32 index);
+
+    const FlatAst &ast;
+    TmProgram &program;
+    int tmpOffset = 0;
+    int deepest = 0;    // Lowest tmpOffset reached
+    std::vector<qint64> constants;  // Indexed by literal ID
+
+    // Work stack of expression(), reused between expressions
+    struct Pending {
+        quint32 index;
+        enum Step : quint8 { Left, Right, Combine } next;
+    };
+    std::vector<Pending> pending;
+
+    // Work stack of sequence(), with the jumps waiting for their targets
+    struct Step {
+        enum Kind : quint8 { Sequence, ElseBranch, PatchEnd, RepeatCondition } kind;
+        quint32 index;      // First statement of a sequence, or the if/repeat to finish
+        int at;             // Jump to patch, or the start of a repeat's body
+    };
+    std::vector<Step> steps;
+};
+
+int TmGenerator::emitRO(TmOp op, quint8 r, quint8 s, quint8 t, const QString &comment) {
+    program.code.append(TmInstruction{op, r, s, t, 0});
+    program.comments.append(comment);
+    return here() - 1;
+}
+
+int TmGenerator::emitRM(TmOp op, quint8 r, qint64 d, quint8 s, const QString &comment) {
+    program.code.append(TmInstruction{op, r, s, 0, d});
+    program.comments.append(comment);
+    return here() - 1;
+}
+
+void TmGenerator::patchAbs(int at, TmOp op, quint8 r, int target, const QString &comment) {
+    program.code[at] = TmInstruction{op, r, Pc, 0, qint64(target) - (at + 1)};
+    program.comments[at] = comment;
+}
+
+void TmGenerator::prelude() {
+    emitRM(TmOp::LD, Mp, 0, Ac, "load maxaddress from location 0");
+    emitRM(TmOp::ST, Ac, 0, Ac, "clear location 0");
+}
+
+void TmGenerator::finish() {
+    emitRO(TmOp::HALT, 0, 0, 0, "end of execution");
+    // Variables, plus the temporaries below maxaddress, plus location 0
+    program.dataSize = qMax<qint64>(ast.identifiers.size(), 1) - deepest + 1;
+}
+
+// Iterative, so deeply parenthesized expressions can't exhaust the stack
+void TmGenerator::expression(quint32 index) {
+    pending.push_back({index, Pending::Left});
+    while (!pending.empty()) {
+        Pending &item = pending.back();
+        const AstNode &n = ast.node(item.index);
+        if (n.kind == NodeKind::Const) {
+            emitRM(TmOp::LDC, Ac, constants[n.payload], 0, "load const");
+            pending.pop_back();
+            continue;
+        }
+        if (n.kind == NodeKind::Id) {
+            emitRM(TmOp::LD, Ac, n.payload, Gp, QString("load id value %1").arg(ast.identifiers.text(n.payload)));
+            pending.pop_back();
+            continue;
+        }
+
+        switch (item.next) {
+        case Pending::Left:
+            item.next = Pending::Right;
+            pending.push_back({n.children[0], Pending::Left});
+            continue;
+        case Pending::Right:
+            emitRM(TmOp::ST, Ac, tmpOffset--, Mp, "op: push left");
+            deepest = qMin(deepest, tmpOffset);
+            item.next = Pending::Combine;
+            pending.push_back({n.children[1], Pending::Left});
+            continue;
+        case Pending::Combine:
+            break;
+        }
+        pending.pop_back();
+
+        emitRM(TmOp::LD, Ac1, ++tmpOffset, Mp, "op: load left");
+        switch (n.op) {
+        case TokenType::PLUS: emitRO(TmOp::ADD, Ac, Ac1, Ac, "op +"); break;
+        case TokenType::MINUS: emitRO(TmOp::SUB, Ac, Ac1, Ac, "op -"); break;
+        case TokenType::MULT: emitRO(TmOp::MUL, Ac, Ac1, Ac, "op *"); break;
+        case TokenType::DIV: emitRO(TmOp::DIV, Ac, Ac1, Ac, "op /"); break;
+        default: {
+            bool less = n.op == TokenType::LESSTHAN;
+            if (less) {
+                // left - right can overflow when the signs differ, but then the sign of left decides
+                emitRM(TmOp::JGE, Ac1, 2, Pc, "op <: br if left >= 0");
+                emitRM(TmOp::JGE, Ac, 6, Pc, "left < 0 <= right: true");
+                emitRM(TmOp::LDA, Pc, 1, Pc, "both negative: subtract");
+                emitRM(TmOp::JLT, Ac, 2, Pc, "right < 0 <= left: false");
+            }
+            emitRO(TmOp::SUB, Ac, Ac1, Ac, less ? "op <" : "op ==");
+            emitRM(less ? TmOp::JLT : TmOp::JEQ, Ac, 2, Pc, "br if true");
+            emitRM(TmOp::LDC, Ac, 0, Ac, "false case");
+            emitRM(TmOp::LDA, Pc, 1, Pc, "unconditional jmp");
+            emitRM(TmOp::LDC, Ac, 1, Ac, "true case");
+            break;
+        }
+        }
+    }
+}
+
+// Iterative too, so deeply nested ifs and repeats can't exhaust the stack
+void TmGenerator::sequence(quint32 index) {
+    steps.push_back({Step::Sequence, index, 0});
+    while (!steps.empty()) {
+        Step step = steps.back();
+        steps.pop_back();
+        if (step.kind == Step::PatchEnd) {
+            patchAbs(step.at, TmOp::LDA, Pc, here(), "jmp to end");
+            continue;
+        }
+        if (step.index == FlatAst::NoNode) {
+            continue;   // End of a sequence
+        }
+        const AstNode &n = ast.node(step.index);
+        switch (step.kind) {
+        case Step::Sequence:
+            steps.push_back({Step::Sequence, n.sibling, 0});
+            switch (n.kind) {
+            case NodeKind::Assign:
+                expression(n.children[0]);
+                emitRM(TmOp::ST, Ac, n.payload, Gp, QString("assign: store value to %1").arg(ast.identifiers.text(n.payload)));
+                break;
+            case NodeKind::Read:
+                emitRO(TmOp::IN, Ac, 0, 0, "read integer value");
+                emitRM(TmOp::ST, Ac, n.payload, Gp, QString("read: store value to %1").arg(ast.identifiers.text(n.payload)));
+                break;
+            case NodeKind::Write:
+                expression(n.children[0]);
+                emitRO(TmOp::OUT, Ac, 0, 0, "write ac");
+                break;
+            case NodeKind::If:
+                expression(n.children[0]);
+                steps.push_back({Step::ElseBranch, step.index, skip()});
+                steps.push_back({Step::Sequence, n.childCount > 1 ? n.children[1] : FlatAst::NoNode, 0});
+                break;
+            case NodeKind::Repeat:
+                steps.push_back({Step::RepeatCondition, step.index, here()});
+                steps.push_back({Step::Sequence, n.children[0], 0});
+                break;
+            default:
+                break;
+            }
+            break;
+        case Step::ElseBranch: {
+            int toEnd = skip();
+            patchAbs(step.at, TmOp::JEQ, Ac, here(), "if: jmp to else");
+            steps.push_back({Step::PatchEnd, step.index, toEnd});
+            steps.push_back({Step::Sequence, n.childCount > 2 ? n.children[2] : FlatAst::NoNode, 0});
+            break;
+        }
+        case Step::RepeatCondition:
+            expression(n.children[1]);
+            emitRM(TmOp::JEQ, Ac, step.at - (here() + 1), Pc, "repeat: jmp back to body");
+            break;
+        case Step::PatchEnd:
+            break;
+        }
+    }
+}
+
+// Parse "r,s,t" or "r,d(s)" after the opcode
+bool parseOperands(const QString &text, bool registerOnly, TmInstruction &in) {
+    auto reg = [](const QString &part, quint8 &value) {
+        bool ok = false;
+        int n = part.trimmed().toInt(&ok);
+        value = quint8(n);
+        return ok && n >= 0 && n <= TmProgram::PcReg;
+    };
+    QStringList parts = text.split(',');
+    if (registerOnly) {
+        return parts.size() == 3 && reg(parts[0], in.r) && reg(parts[1], in.s) && reg(parts[2], in.t);
+    }
+    if (parts.size() != 2 || !reg(parts[0], in.r)) {
+        return false;
+    }
+    QString address = parts[1].trimmed();
+    qsizetype open = address.indexOf('(');
+    if (open < 0 || !address.endsWith(')')) {
+        return false;
+    }
+    bool ok = false;
+    in.d = address.left(open).trimmed().toLongLong(&ok);
+    return ok && reg(address.mid(open + 1, address.size() - open - 2), in.s);
+}
+
+} // namespace
+
+const char *tmOpName(TmOp op) {
+    static const char *const names[] = {
+        "HALT", "IN", "OUT", "ADD", "SUB", "MUL", "DIV",
+        "LD", "ST", "LDA", "LDC", "JLT", "JLE", "JGE", "JGT", "JEQ", "JNE"
+    };
+    return names[int(op)];
+}
+
+TmProgram generateTm(const FlatAst &ast) {
+    TmProgram program;
+    TmGenerator generator(ast, program);
+    generator.prelude();
+    generator.sequence(ast.root);
+    generator.finish();
+    return program;
+}
+
+QString TmProgram::toAssembly() const {
+    QString text = "* TINY compilation to TM code\n";
+    for (qsizetype loc = 0; loc < code.size(); ++loc) {
+        const TmInstruction &in = code[loc];
+        QString operands = isRegisterOnly(in.op) ? QString("%1,%2,%3").arg(in.r).arg(in.s).arg(in.t)
+                                                 : QString("%1,%2(%3)").arg(in.r).arg(in.d).arg(in.s);
+        QString line = QString("%1:  %2  %3").arg(loc, 3).arg(tmOpName(in.op), 5).arg(operands);
+        if (loc < comments.size() && !comments[loc].isEmpty()) {
+            line += "\t" + comments[loc];
+        }
+        text += line + '\n';
+    }
+    return text;
+}
+
+TmProgram TmProgram::assemble(const QString &text) {
+    TmProgram program;
+    QStringList lines = text.split('\n');
+    for (qsizetype number = 0; number < lines.size(); ++number) {
+        QString line = lines[number].trimmed();
+        if (line.isEmpty() || line.startsWith('*')) {
+            continue;
+        }
+        auto fail = [&](const char *what) {
+            QString errorMsg = QString("line %1: %2").arg(number + 1).arg(what);
+            throw std::runtime_error(errorMsg.toStdString());
+        };
+
+        qsizetype colon = line.indexOf(':');
+        bool ok = false;
+        int loc = colon < 0 ? -1 : line.left(colon).trimmed().toInt(&ok);
+        if (!ok || loc < 0) {
+            fail("expected 'location:'");
+        }
+        if (loc >= InstructionMemory) {
+            fail("location outside instruction memory");  // Gaps are filled, so this bounds the allocation
+        }
+        QStringList fields = line.mid(colon + 1).simplified().split(' ');
+        if (fields.size() < 2) {
+            fail("missing opcode or operands");
+        }
+        int op = 0;
+        while (op <= int(TmOp::JNE) && fields[0] != tmOpName(TmOp(op))) {
+            ++op;
+        }
+        if (op > int(TmOp::JNE)) {
+            fail("unknown opcode");
+        }
+        TmInstruction in{TmOp(op), 0, 0, 0, 0};
+        if (!parseOperands(fields[1], isRegisterOnly(in.op), in)) {
+            fail("bad operands");
+        }
+
+        // Unlisted locations hold HALT, as in the textbook simulator
+        while (program.code.size() <= loc) {
+            program.code.append(TmInstruction{TmOp::HALT, 0, 0, 0, 0});
+            program.comments.append(QString());
+        }
+        program.code[loc] = in;
+        program.comments[loc] = fields.mid(2).join(' ');
+    }
+    return program;
+}
@@ -0,0 +1,52 @@
+#ifndef TMCODE_H
+#define TMCODE_H
+
+#include "flatast.h"
+#include <QList>
+#include <QString>
+
+// Instruction set of Louden's TM (Tiny Machine): eight registers, reg[7] is
+// the program counter. Register-only (RO) instructions use r, s, t; register-
+// memory (RM) instructions address d + reg[s].
+enum class TmOp : quint8 {
+    HALT, IN, OUT, ADD, SUB, MUL, DIV,          // RO
+    LD, ST,                                     // RM: reg[r] = dMem[a], dMem[a] = reg[r]
+    LDA, LDC,                                   // RM: reg[r] = a, reg[r] = d
+    JLT, JLE, JGE, JGT, JEQ, JNE                // RM: if (reg[r] op 0) reg[7] = a
+};
+
+inline bool isRegisterOnly(TmOp op) { return op <= TmOp::DIV; }
+const char *tmOpName(TmOp op);
+
+struct TmInstruction {
+    TmOp op;
+    quint8 r, s, t;
+    qint64 d;   // Wide enough for any TINY constant
+};
+
+struct TmProgram {
+    static constexpr int PcReg = 7;
+    static constexpr int InstructionMemory = 1 << 22; // Locations assemble() accepts, like IADDR_SIZE
+
+    QList<TmInstruction> code;
+    QList<QString> comments;    // Per instruction, may be empty
+    qint64 dataSize = 0;        // Data memory the program needs, 0 if unknown
+
+    // Textbook listing: "  5:     LDC  0,3(0)   comment", one line per location
+    QString toAssembly() const;
+
+    // Read a listing in the same format ('*' lines are comments, locations may
+    // come in any order, gaps are HALT). Throws std::runtime_error on bad lines
+    // and on locations outside the instruction memory.
+    static TmProgram assemble(const QString &text);
+};
+
+// Generate TM code for a parsed program the way Louden's cgen does: variables
+// live at their identifier ID in data memory, expression temporaries are
+// pushed below the top of memory (reg 6), and the program halts at the end.
+// Unlike cgen, < checks the operands' signs before subtracting, so it gives
+// the same answer as the other engines when left - right would overflow.
+// Throws std::runtime_error if a constant doesn't fit in 64 bits.
+TmProgram generateTm(const FlatAst &ast);
+
+#endif // TMCODE_H
@@ -0,0 +1,151 @@
+#include "tmmachine.h"
+#include "bytecode.h"
+#include "vm.h"
+#include <QStringList>
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+
+[[noreturn]] void machineError(const char *what, qint64 location) {
+    QString errorMsg = QString("TM: %1 at location %2").arg(what).arg(location);
+    throw std::runtime_error(errorMsg.toStdString());
+}
+
+} // namespace
+
+void TmMachine::run(const TmProgram &program, ProgramIo &io) {
+    code.assign(program.code.begin(), program.code.end());
+    memory.assign(size_t(qMax(qMax(dataSize, program.dataSize), qint64(1))), 0);
+    memory[0] = qint64(memory.size()) - 1;
+    stepCount = 0;
+
+    if (profile) {
+        profile->executed = QList<quint64>(code.size(), 0);
+        profile->jumpsTaken = QList<quint64>(code.size(), 0);
+        profile->lastTarget = QList<qint64>(code.size(), 0);
+        try {
+            execute<true>(io);
+        } catch (...) {
+            profile->steps = stepCount; // Still describes the run up to the error
+            throw;
+        }
+        profile->steps = stepCount;
+    } else {
+        execute<false>(io);
+    }
+}
+
+template <bool Profiling>
+void TmMachine::execute(ProgramIo &io) {
+    qint64 reg[8] = {};
+    const TmInstruction *instructions = code.data();
+    const qint64 codeSize = qint64(code.size());
+    qint64 *dMem = memory.data();
+    const qint64 memorySize = qint64(memory.size());
+    const quint64 limit = stepLimit ? stepLimit : ~quint64(0);
+
+    auto address = [&](const TmInstruction &in, qint64 pc) {
+        qint64 a = wrappingAdd(in.d, reg[in.s]);
+        if (a < 0 || a >= memorySize) {
+            machineError("data memory access out of range", pc);
+        }
+        return a;
+    };
+
+    while (true) {
+        qint64 pc = reg[TmProgram::PcReg];
+        if (pc < 0 || pc >= codeSize) {
+            machineError("pc outside instruction memory", pc);
+        }
+        if (++stepCount > limit) {
+            machineError("step limit reached", pc);
+        }
+        const TmInstruction &in = instructions[pc];
+        reg[TmProgram::PcReg] = pc + 1;
+
+        switch (in.op) {
+        case TmOp::HALT: return;
+        case TmOp::IN: reg[in.r] = io.read(); break;
+        case TmOp::OUT: io.write(reg[in.r]); break;
+        case TmOp::ADD: reg[in.r] = wrappingAdd(reg[in.s], reg[in.t]); break;
+        case TmOp::SUB: reg[in.r] = wrappingSub(reg[in.s], reg[in.t]); break;
+        case TmOp::MUL: reg[in.r] = wrappingMul(reg[in.s], reg[in.t]); break;
+        case TmOp::DIV:
+            if (reg[in.t] == 0) {
+                throw std::runtime_error("Division by zero");
+            }
+            reg[in.r] = wrappingDiv(reg[in.s], reg[in.t]);
+            break;
+        case TmOp::LD: reg[in.r] = dMem[address(in, pc)]; break;
+        case TmOp::ST: dMem[address(in, pc)] = reg[in.r]; break;
+        case TmOp::LDA: reg[in.r] = wrappingAdd(in.d, reg[in.s]); break;
+        case TmOp::LDC: reg[in.r] = in.d; break;
+        case TmOp::JLT: if (reg[in.r] < 0) reg[TmProgram::PcReg] = wrappingAdd(in.d, reg[in.s]); break;
+        case TmOp::JLE: if (reg[in.r] <= 0) reg[TmProgram::PcReg] = wrappingAdd(in.d, reg[in.s]); break;
+        case TmOp::JGE: if (reg[in.r] >= 0) reg[TmProgram::PcReg] = wrappingAdd(in.d, reg[in.s]); break;
+        case TmOp::JGT: if (reg[in.r] > 0) reg[TmProgram::PcReg] = wrappingAdd(in.d, reg[in.s]); break;
+        case TmOp::JEQ: if (reg[in.r] == 0) reg[TmProgram::PcReg] = wrappingAdd(in.d, reg[in.s]); break;
+        case TmOp::JNE: if (reg[in.r] != 0) reg[TmProgram::PcReg] = wrappingAdd(in.d, reg[in.s]); break;
+        }
+
+        if (Profiling) {
+            profile->executed[pc]++;
+            if (reg[TmProgram::PcReg] != pc + 1) {
+                profile->jumpsTaken[pc]++;
+                profile->lastTarget[pc] = reg[TmProgram::PcReg];
+            }
+        }
+    }
+}
+
+QString TmProfile::report(const TmProgram &program, int top) const {
+    auto describe = [&](qsizetype loc) {
+        const TmInstruction &in = program.code[loc];
+        QString text = QString("%1 %2,").arg(tmOpName(in.op)).arg(in.r);
+        text += isRegisterOnly(in.op) ? QString("%1,%2").arg(in.s).arg(in.t) : QString("%1(%2)").arg(in.d).arg(in.s);
+        if (loc < program.comments.size() && !program.comments[loc].isEmpty()) {
+            text += "  " + program.comments[loc];
+        }
+        return text;
+    };
+
+    QString text = QString("%1 steps\n").arg(steps);
+
+    QList<qsizetype> hottest;
+    for (qsizetype loc = 0; loc < executed.size(); ++loc) {
+        if (executed[loc] > 0) {
+            hottest.append(loc);
+        }
+    }
+    std::stable_sort(hottest.begin(), hottest.end(), [&](qsizetype a, qsizetype b) { return executed[a] > executed[b]; });
+    text += "hottest instructions:\n";
+    for (qsizetype i = 0; i < qMin<qsizetype>(top, hottest.size()); ++i) {
+        qsizetype loc = hottest[i];
+        text += QString("%1  %2  %3\n").arg(executed[loc], 12).arg(loc, 5).arg(describe(loc));
+    }
+
+    // A taken jump back to an earlier location closes a loop (repeat ... until)
+    struct Loop { qsizetype begin, end; quint64 iterations, work; };
+    QList<Loop> loops;
+    for (qsizetype loc = 0; loc < jumpsTaken.size(); ++loc) {
+        if (jumpsTaken[loc] > 0 && lastTarget[loc] >= 0 && lastTarget[loc] <= loc) {
+            Loop loop{qsizetype(lastTarget[loc]), loc, jumpsTaken[loc], 0};
+            for (qsizetype i = loop.begin; i <= loop.end; ++i) {
+                loop.work += executed[i];
+            }
+            loops.append(loop);
+        }
+    }
+    std::stable_sort(loops.begin(), loops.end(), [](const Loop &a, const Loop &b) { return a.work > b.work; });
+    if (!loops.isEmpty()) {
+        text += "loops (back jumps):\n";
+    }
+    for (qsizetype i = 0; i < qMin<qsizetype>(top, loops.size()); ++i) {
+        const Loop &loop = loops[i];
+        text += QString("  %1-%2: %3 iteration(s), %4 step(s) (%5%)\n")
+                    .arg(loop.begin).arg(loop.end).arg(loop.iterations).arg(loop.work)
+                    .arg(steps ? 100.0 * loop.work / steps : 0.0, 0, 'f', 1);
+    }
+    return text;
+}
@@ -0,0 +1,51 @@
+#ifndef TMMACHINE_H
+#define TMMACHINE_H
+
+#include "tmcode.h"
+#include <QList>
+#include <vector>
+
+class ProgramIo;
+
+// Per-location counters collected by TmMachine in profile mode
+struct TmProfile {
+    quint64 steps = 0;
+    QList<quint64> executed;    // Times each location ran
+    QList<quint64> jumpsTaken;  // Times it transferred control elsewhere
+    QList<qint64> lastTarget;   // Where it last jumped to
+
+    // Hottest instructions, then every backward jump (a repeat loop) with its
+    // iteration count and the instructions executed inside it, hottest first
+    QString report(const TmProgram &program, int top = 10) const;
+};
+
+// TM simulator. The program is decoded once into a dense array that the run
+// loop indexes by pc; nothing is parsed while stepping. Semantics follow the
+// textbook machine: reg[7] is the pc and is already incremented when an
+// instruction executes, dMem[0] starts out holding the highest address.
+class TmMachine {
+public:
+    static constexpr qint64 DefaultDataSize = 1024;
+
+    void setDataSize(qint64 size) { dataSize = size; }  // Raised to what the program needs
+    void setStepLimit(quint64 limit) { stepLimit = limit; } // 0 = unlimited
+    void setProfile(TmProfile *target) { profile = target; } // nullptr = off
+
+    // Run until HALT. Throws std::runtime_error on division by zero, a bad
+    // memory access, a pc outside the program or the step limit.
+    void run(const TmProgram &program, ProgramIo &io);
+    quint64 steps() const { return stepCount; }
+
+private:
+    template <bool Profiling>
+    void execute(ProgramIo &io);
+
+    std::vector<TmInstruction> code;
+    std::vector<qint64> memory;
+    qint64 dataSize = DefaultDataSize;
+    quint64 stepLimit = 0;
+    quint64 stepCount = 0;
+    TmProfile *profile = nullptr;
+};
+
+#endif // TMMACHINE_H
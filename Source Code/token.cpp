@@ -1,9 +1,15 @@
 #include "token.h"
+#include "keywords.h"
+#include "scankernels.h"
+#include "diagnostics.h"
+#include <limits>
 #include <stdexcept>
-#include <qmessagebox.h>
 
 // Constructor
-Token::Token(QString value, TokenType type) : value(std::move(value)), type(type) {}
+Token::Token() : type(TokenType::UNKNOWN) {}
+
+Token::Token(QString value, TokenType type, qsizetype offset)
+    : value(std::move(value)), type(type), offset(offset) {}
 
 // Convert token type to string
 QString Token::tokenTypeToString(TokenType type) {
@@ -37,9 +43,30 @@ QString Token::toString() const {
     return value + ", " + tokenTypeToString(type);
 }
 
+// Shared spellings, so tokens with a fixed lexeme never allocate their own string
+const QString &Token::fixedText(TokenType type) {
+    static const QString texts[] = {
+        ";", "if", "then", "else", "end", "repeat", "until", "", ":=", "read", "write",
+        "<", "=", "+", "-", "*", "/", "(", ")", "", ""
+    };
+    return texts[static_cast<int>(type)];
+}
+
+QString CompactToken::text(const char *source) const {
+    const QString &fixed = Token::fixedText(type);
+    if (!fixed.isEmpty()) {
+        return fixed;
+    }
+    return QString::fromUtf8(source + offset, length);
+}
+
+Token CompactToken::toToken(const char *source) const {
+    return Token(text(source), type, offset);
+}
+
 
 
-QList<Token> tokenize(const QString &input) {
+QList<Token> tokenize(const QString &input, Diagnostics *diagnostics) {
     QList<Token> tokens;
     int length = input.length();
     int i = 0;
@@ -65,6 +92,8 @@ QList<Token> tokenize(const QString &input) {
         }
 
 
+        qsizetype start = i;
+
         // Handle single tokens
         if (currentChar == ';') tokens.append(Token(";", TokenType::SEMICOLON));
         else if (currentChar == '<') tokens.append(Token("<", TokenType::LESSTHAN));
@@ -91,16 +120,9 @@ QList<Token> tokenize(const QString &input) {
             }
             i--; // decrement index as it will be incremented by the loop
 
-            // Match against keywords
-            if (word == "if") tokens.append(Token(word, TokenType::IF));
-            else if (word == "then") tokens.append(Token(word, TokenType::THEN));
-            else if (word == "else") tokens.append(Token(word, TokenType::ELSE));
-            else if (word == "end") tokens.append(Token(word, TokenType::END));
-            else if (word == "repeat") tokens.append(Token(word, TokenType::REPEAT));
-            else if (word == "until") tokens.append(Token(word, TokenType::UNTIL));
-            else if (word == "read") tokens.append(Token(word, TokenType::READ));
-            else if (word == "write") tokens.append(Token(word, TokenType::WRITE));
-            else tokens.append(Token(word, TokenType::IDENTIFIER));
+            // Keyword or identifier, via the perfect hash in keywords.h
+            TokenType type = keywordType(word.constData(), word.size());
+            tokens.append(Token(word, type));
         }
 
         // Handle numbers
@@ -117,12 +139,188 @@ QList<Token> tokenize(const QString &input) {
         // Handle unknown tokens
         else {
             QString errorMsg = QString("Unknown token found: '%1' at position %2").arg(currentChar).arg(i);
-            QMessageBox::critical(nullptr, "Tokenization Error", errorMsg);
-            return {}; // Return an empty list to indicate failure
+            if (!diagnostics) {
+                throw std::runtime_error(errorMsg.toStdString());
+            }
+            diagnostics->error(i, errorMsg);
+            i++; // Skip the character and keep scanning
+            continue;
         }
 
+        tokens.last().offset = start;
         i++;
     }
 
     return tokens;
 }
+
+
+namespace {
+
+enum class CharClass { Space, Letter, Digit, Other };
+
+// Character classes for ASCII bytes, matching QChar::isSpace/isLetter/isDigit
+struct AsciiClassTable {
+    CharClass table[128];
+    constexpr AsciiClassTable() : table() {
+        for (int c = 0; c < 128; ++c) {
+            table[c] = CharClass::Other;
+        }
+        for (int c = 'a'; c <= 'z'; ++c) table[c] = CharClass::Letter;
+        for (int c = 'A'; c <= 'Z'; ++c) table[c] = CharClass::Letter;
+        for (int c = '0'; c <= '9'; ++c) table[c] = CharClass::Digit;
+        for (int c : {' ', '\t', '\n', '\v', '\f', '\r'}) table[c] = CharClass::Space;
+    }
+};
+constexpr AsciiClassTable asciiClasses;
+
+// Decode one UTF-8 sequence starting at p; invalid bytes decode as U+FFFD of length 1
+char32_t decodeUtf8(const unsigned char *p, const unsigned char *end, int &length) {
+    unsigned char lead = p[0];
+    int extra = lead >= 0xF0 ? 3 : lead >= 0xE0 ? 2 : lead >= 0xC0 ? 1 : -1;
+    if (extra < 0 || end - p <= extra) {
+        length = 1;
+        return 0xFFFD;
+    }
+    char32_t cp = lead & (0x3F >> extra);
+    for (int k = 1; k <= extra; ++k) {
+        if ((p[k] & 0xC0) != 0x80) {
+            length = 1;
+            return 0xFFFD;
+        }
+        cp = (cp << 6) | (p[k] & 0x3F);
+    }
+    length = extra + 1;
+    return cp;
+}
+
+// Classify the character at p and report its size in bytes
+inline CharClass classify(const unsigned char *p, const unsigned char *end, int &length) {
+    if (*p < 0x80) {
+        length = 1;
+        return asciiClasses.table[*p];
+    }
+    char32_t cp = decodeUtf8(p, end, length);
+    if (cp > 0xFFFF) {
+        return CharClass::Other; // QString holds these as surrogate pairs, which tokenize() rejects
+    }
+    if (QChar::isSpace(cp)) return CharClass::Space;
+    if (QChar::isLetter(cp)) return CharClass::Letter;
+    if (QChar::isDigit(cp)) return CharClass::Digit;
+    return CharClass::Other;
+}
+
+} // namespace
+
+Lexer::Lexer(const char *source, qsizetype size, Diagnostics *diagnostics)
+    : begin(source), end(source + size), cursor(source), kernels(&scanKernels()), diagnostics(diagnostics) {
+    if (size > qsizetype(std::numeric_limits<quint32>::max())) {
+        throw std::runtime_error("Source too large for compact tokens (4 GiB limit)");
+    }
+}
+
+void Lexer::setRange(qsizetype from, qsizetype to) {
+    cursor = begin + from;
+    end = begin + to;
+}
+
+bool Lexer::next(CompactToken &token) {
+    const unsigned char *first = reinterpret_cast<const unsigned char *>(begin);
+    const unsigned char *last = reinterpret_cast<const unsigned char *>(end);
+    const unsigned char *p = reinterpret_cast<const unsigned char *>(cursor);
+
+    // Runs of ASCII whitespace, comment bodies and identifier/digit runs are
+    // measured by the vector kernels; only non-ASCII bytes go through classify()
+    auto skip = [&](const char *(*kernel)(const char *, const char *), const unsigned char *from) {
+        const char *stop = kernel(reinterpret_cast<const char *>(from), end);
+        return reinterpret_cast<const unsigned char *>(stop);
+    };
+    auto produce = [&](const unsigned char *start, const unsigned char *stop, TokenType type) {
+        token = CompactToken{quint32(start - first), quint32(stop - start), type};
+        cursor = reinterpret_cast<const char *>(stop);
+        return true;
+    };
+
+    while (p < last) {
+        int charLength;
+        CharClass cls = classify(p, last, charLength);
+
+        // Skip whitespace
+        if (cls == CharClass::Space) {
+            p = skip(kernels->skipSpace, p + charLength);
+            continue;
+        }
+
+        // Skip comments up to and including the closing brace
+        if (*p == '{') {
+            p = skip(kernels->findCommentEnd, p + 1);
+            if (p < last) {
+                p++;
+            }
+            continue;
+        }
+
+        switch (*p) {
+        case ';': return produce(p, p + 1, TokenType::SEMICOLON);
+        case '<': return produce(p, p + 1, TokenType::LESSTHAN);
+        case '=': return produce(p, p + 1, TokenType::EQUAL);
+        case '+': return produce(p, p + 1, TokenType::PLUS);
+        case '-': return produce(p, p + 1, TokenType::MINUS);
+        case '*': return produce(p, p + 1, TokenType::MULT);
+        case '/': return produce(p, p + 1, TokenType::DIV);
+        case '(': return produce(p, p + 1, TokenType::OPENBRACKET);
+        case ')': return produce(p, p + 1, TokenType::CLOSEDBRACKET);
+        case ':':
+            if (p + 1 < last && p[1] == '=') {
+                return produce(p, p + 2, TokenType::ASSIGN);
+            }
+            break;
+        default:
+            break;
+        }
+
+        // Keywords and identifiers, then numbers: measure the run in place
+        if (cls == CharClass::Letter || cls == CharClass::Digit) {
+            const unsigned char *start = p;
+            auto kernel = cls == CharClass::Digit ? kernels->digitRun : kernels->letterRun;
+            CharClass run = cls;
+            p += charLength;
+            while (true) {
+                p = skip(kernel, p);
+                if (p < last && *p >= 0x80 && classify(p, last, charLength) == run) {
+                    p += charLength; // Non-ASCII letter/digit continues the run
+                    continue;
+                }
+                break;
+            }
+            TokenType type = run == CharClass::Digit
+                                 ? TokenType::NUMBER
+                                 : keywordType(reinterpret_cast<const char *>(start), p - start);
+            return produce(start, p, type);
+        }
+
+        // Handle unknown tokens
+        QString errorMsg = QString("Unknown token found: '%1' at position %2")
+                               .arg(QString::fromUtf8(reinterpret_cast<const char *>(p), charLength))
+                               .arg(qsizetype(p - first));
+        if (!diagnostics) {
+            cursor = reinterpret_cast<const char *>(p);
+            throw std::runtime_error(errorMsg.toStdString());
+        }
+        diagnostics->error(p - first, errorMsg);
+        p += charLength; // Skip the character and keep scanning
+    }
+
+    cursor = end;
+    return false;
+}
+
+QList<CompactToken> tokenizeCompact(const char *source, qsizetype size, Diagnostics *diagnostics) {
+    QList<CompactToken> tokens;
+    Lexer lexer(source, size, diagnostics);
+    CompactToken token;
+    while (lexer.next(token)) {
+        tokens.append(token);
+    }
+    return tokens;
+}
@@ -5,7 +5,7 @@
 #include <QList>
 
 // Define token types
-enum class TokenType {
+enum class TokenType : quint8 {
     SEMICOLON, IF, THEN, ELSE, END, REPEAT, UNTIL, IDENTIFIER, ASSIGN, READ, WRITE,
     LESSTHAN, EQUAL, PLUS, MINUS, MULT, DIV, OPENBRACKET, CLOSEDBRACKET, NUMBER, UNKNOWN
 };
@@ -15,13 +15,55 @@ class Token {
 public:
     QString value;
     TokenType type;
+    qsizetype offset = -1;                   // Where the lexeme starts in the source, -1 if unknown
 
-    Token(QString value, TokenType type);
+    Token();                                 // Empty UNKNOWN token, also used for end of input
+    Token(QString value, TokenType type, qsizetype offset = -1);
     QString toString() const;
     static QString tokenTypeToString(TokenType type);
+    static const QString &fixedText(TokenType type); // Spelling of keywords/punctuation, else empty
 };
 
-// Function to tokenize input
-QList<Token> tokenize(const QString &input);
+// Compact token that points back into the source bytes instead of owning its text
+struct CompactToken {
+    quint32 offset;   // Byte offset of the lexeme in the source
+    quint32 length;   // Lexeme length in bytes
+    TokenType type;
+
+    QString text(const char *source) const;     // Materialize the lexeme on demand
+    Token toToken(const char *source) const;
+};
+static_assert(sizeof(CompactToken) <= 16, "CompactToken should stay within 16 bytes");
+
+class Diagnostics;
+struct ScanKernels;
+
+// Function to tokenize input. Unknown characters throw, or are reported to
+// diagnostics and skipped when one is given.
+QList<Token> tokenize(const QString &input, Diagnostics *diagnostics = nullptr);
+
+// Incremental scanner over UTF-8 bytes: each next() call scans just far enough
+// to produce one token, so callers never need the whole token list in memory.
+class Lexer {
+public:
+    Lexer(const char *source, qsizetype size, Diagnostics *diagnostics = nullptr);
+
+    bool next(CompactToken &token); // False at end of input; unknown characters as in tokenize()
+    const char *source() const { return begin; }
+
+    // Scan only the bytes [from, to); offsets stay relative to the whole source
+    void setRange(qsizetype from, qsizetype to);
+
+private:
+    const char *begin;
+    const char *end;
+    const char *cursor;
+    const ScanKernels *kernels;
+    Diagnostics *diagnostics;
+};
+
+// Tokenize UTF-8 bytes (e.g. a memory-mapped SourceBuffer) without copying any
+// lexeme. Produces the same token stream as tokenize(); error positions are byte offsets.
+QList<CompactToken> tokenizeCompact(const char *source, qsizetype size, Diagnostics *diagnostics = nullptr);
 
 #endif // TOKEN_H
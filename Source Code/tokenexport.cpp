@@ -0,0 +1,143 @@
+#include "tokenexport.h"
+#include <QFile>
+#include <charconv>
+#include <cstdio>
+
+namespace {
+
+const char BinaryMagic[8] = {'T', 'I', 'N', 'Y', 'T', 'O', 'K', 1};
+
+// Type names as bytes, converted once
+const QByteArray &typeName(TokenType type) {
+    static const QList<QByteArray> names = [] {
+        QList<QByteArray> list;
+        for (int t = 0; t <= int(TokenType::UNKNOWN); ++t) {
+            list.append(Token::tokenTypeToString(TokenType(t)).toLatin1());
+        }
+        return list;
+    }();
+    return names[int(type)];
+}
+
+void appendNumber(QByteArray &out, quint32 value) {
+    char digits[10];
+    auto result = std::to_chars(digits, digits + sizeof(digits), value);
+    out.append(digits, result.ptr - digits);
+}
+
+void appendLittleEndian(QByteArray &out, quint32 value) {
+    char bytes[4] = {char(value), char(value >> 8), char(value >> 16), char(value >> 24)};
+    out.append(bytes, 4);
+}
+
+// Lexemes are identifiers, numbers and punctuation, but escape anyway
+void appendJsonString(QByteArray &out, const char *text, qsizetype length) {
+    out.append('"');
+    for (qsizetype i = 0; i < length; ++i) {
+        char c = text[i];
+        if (c == '"' || c == '\\') {
+            out.append('\\');
+        }
+        out.append(c);
+    }
+    out.append('"');
+}
+
+} // namespace
+
+bool parseTokenFormat(const QString &name, TokenFormat &format) {
+    if (name == "text") {
+        format = TokenFormat::Text;
+    } else if (name == "jsonl") {
+        format = TokenFormat::JsonLines;
+    } else if (name == "binary") {
+        format = TokenFormat::Binary;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+QString tokenFormatSuffix(TokenFormat format) {
+    switch (format) {
+    case TokenFormat::Text: return ".tokens.txt";
+    case TokenFormat::JsonLines: return ".tokens.jsonl";
+    case TokenFormat::Binary: return ".tokens.bin";
+    }
+    return QString();
+}
+
+TokenWriter::TokenWriter(QIODevice &device, TokenFormat format) : device(device), format(format) {
+    buffer.reserve(BufferSize + 256);
+    if (format == TokenFormat::Binary) {
+        buffer.append(BinaryMagic, sizeof(BinaryMagic));
+    }
+}
+
+TokenWriter::~TokenWriter() {
+    flush();
+}
+
+void TokenWriter::write(const CompactToken &token, const char *source) {
+    const char *text = source + token.offset;
+    switch (format) {
+    case TokenFormat::Text:
+        buffer.append(text, token.length);
+        buffer.append(", ", 2);
+        buffer.append(typeName(token.type));
+        buffer.append('\n');
+        break;
+    case TokenFormat::JsonLines:
+        buffer.append("{\"type\":\"", 9);
+        buffer.append(typeName(token.type));
+        buffer.append("\",\"text\":", 9);
+        appendJsonString(buffer, text, token.length);
+        buffer.append(",\"offset\":", 10);
+        appendNumber(buffer, token.offset);
+        buffer.append(",\"length\":", 10);
+        appendNumber(buffer, token.length);
+        buffer.append("}\n", 2);
+        break;
+    case TokenFormat::Binary:
+        buffer.append(char(token.type));
+        appendLittleEndian(buffer, token.offset);
+        appendLittleEndian(buffer, token.length);
+        break;
+    }
+    if (buffer.size() >= BufferSize) {
+        flush();
+    }
+}
+
+bool TokenWriter::finish() {
+    flush();
+    return ok;
+}
+
+void TokenWriter::flush() {
+    if (!buffer.isEmpty()) {
+        ok = device.write(buffer) == buffer.size() && ok;
+        buffer.resize(0); // Keeps the capacity
+    }
+}
+
+bool exportTokens(const QString &path, TokenFormat format,
+                  const QList<CompactToken> &tokens, const char *source) {
+    QFile file;
+    bool opened;
+    if (path == "-") {
+        opened = file.open(stdout, QIODevice::WriteOnly);
+    } else {
+        file.setFileName(path);
+        opened = file.open(QIODevice::WriteOnly | QIODevice::Truncate);
+    }
+    if (!opened) {
+        return false;
+    }
+
+    TokenWriter writer(file, format);
+    for (const CompactToken &token : tokens) {
+        writer.write(token, source);
+    }
+    return writer.finish() && file.flush();
+}
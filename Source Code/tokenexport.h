@@ -0,0 +1,48 @@
+#ifndef TOKENEXPORT_H
+#define TOKENEXPORT_H
+
+#include "token.h"
+#include <QByteArray>
+
+class QIODevice;
+
+// Output formats for scanned tokens
+enum class TokenFormat {
+    Text,       // "lexeme, TYPE" per line, as the scanner has always written
+    JsonLines,  // {"type":"IDENTIFIER","text":"x","offset":4,"length":1} per line
+    Binary      // Header, then one fixed-size record per token (see TokenWriter)
+};
+
+bool parseTokenFormat(const QString &name, TokenFormat &format); // "text", "jsonl" or "binary"
+QString tokenFormatSuffix(TokenFormat format);                    // e.g. ".tokens.jsonl"
+
+// Streams tokens to a device through one large buffer, formatting straight
+// from the source bytes instead of building a QString per token.
+//
+// Binary layout, little-endian: the 8-byte magic "TINYTOK\1", then per token
+// a 9-byte record {quint8 type; quint32 offset; quint32 length}, where type is
+// the TokenType value and offset/length locate the lexeme in the UTF-8 source.
+class TokenWriter {
+public:
+    static constexpr qsizetype BufferSize = 1 << 16;
+
+    TokenWriter(QIODevice &device, TokenFormat format);
+    ~TokenWriter();
+
+    void write(const CompactToken &token, const char *source);
+    bool finish();              // Flush; false if any write failed
+
+private:
+    void flush();
+
+    QIODevice &device;
+    TokenFormat format;
+    QByteArray buffer;
+    bool ok = true;
+};
+
+// Write tokens to path, or to stdout when path is "-"
+bool exportTokens(const QString &path, TokenFormat format,
+                  const QList<CompactToken> &tokens, const char *source);
+
+#endif // TOKENEXPORT_H
@@ -0,0 +1,53 @@
+#include "tokenstream.h"
+
+bool ListTokenSource::next(Token &token) {
+    if (index >= tokens.size()) {
+        return false;
+    }
+    token = tokens[index++];
+    return true;
+}
+
+bool CompactTokenSource::next(Token &token) {
+    if (index >= stop) {
+        return false;
+    }
+    token = tokens[index++].toToken(source);
+    return true;
+}
+
+bool LexerTokenSource::next(Token &token) {
+    CompactToken compact;
+    if (!lexer.next(compact)) {
+        return false;
+    }
+    token = compact.toToken(lexer.source());
+    return true;
+}
+
+bool CancellableTokenSource::next(Token &token) {
+    return !cancelled.load(std::memory_order_relaxed) && source.next(token);
+}
+
+const Token &TokenStream::peek(int ahead) {
+    static const Token endOfInput;
+
+    while (count <= ahead && !exhausted) {
+        if (source.next(ring[(head + count) % Lookahead])) {
+            count++;
+        } else {
+            exhausted = true;
+        }
+    }
+    return ahead < count ? ring[(head + ahead) % Lookahead] : endOfInput;
+}
+
+void TokenStream::advance() {
+    peek();
+    if (count == 0) {
+        return; // Already at the end
+    }
+    head = (head + 1) % Lookahead;
+    count--;
+    consumed++;
+}
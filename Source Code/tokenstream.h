@@ -0,0 +1,88 @@
+#ifndef TOKENSTREAM_H
+#define TOKENSTREAM_H
+
+#include "token.h"
+#include <atomic>
+
+// Something the parser can pull tokens from, one at a time
+class TokenSource {
+public:
+    virtual ~TokenSource() = default;
+    virtual bool next(Token &token) = 0; // False once the input is exhausted
+};
+
+// Replays an already scanned token list
+class ListTokenSource : public TokenSource {
+public:
+    explicit ListTokenSource(const QList<Token> &tokens) : tokens(tokens) {}
+    bool next(Token &token) override;
+
+private:
+    QList<Token> tokens; // Implicitly shared, so this doesn't copy the tokens
+    qsizetype index = 0;
+};
+
+// Replays tokens from tokenizeCompact(), materializing each one as it is pulled
+class CompactTokenSource : public TokenSource {
+public:
+    CompactTokenSource(const QList<CompactToken> &tokens, const char *source)
+        : tokens(tokens), source(source), stop(tokens.size()) {}
+    // Only tokens [from, to) of the list
+    CompactTokenSource(const QList<CompactToken> &tokens, const char *source, qsizetype from, qsizetype to)
+        : tokens(tokens), source(source), index(from), stop(to) {}
+    bool next(Token &token) override;
+
+private:
+    QList<CompactToken> tokens;
+    const char *source;
+    qsizetype index = 0;
+    qsizetype stop;
+};
+
+// Scans on demand straight from UTF-8 bytes, one token per pull
+class LexerTokenSource : public TokenSource {
+public:
+    LexerTokenSource(const char *source, qsizetype size, Diagnostics *diagnostics = nullptr)
+        : lexer(source, size, diagnostics) {}
+    bool next(Token &token) override;
+
+private:
+    Lexer lexer;
+};
+
+// Passes tokens through until cancelled is set, then reports the end of
+// input, so a parse that is no longer wanted finishes after at most one more token
+class CancellableTokenSource : public TokenSource {
+public:
+    CancellableTokenSource(TokenSource &source, const std::atomic<bool> &cancelled)
+        : source(source), cancelled(cancelled) {}
+    bool next(Token &token) override;
+
+private:
+    TokenSource &source;
+    const std::atomic<bool> &cancelled;
+};
+
+// Fixed-size lookahead ring in front of a TokenSource. Only the tokens the
+// parser can still look at are held, so memory doesn't grow with the input.
+class TokenStream {
+public:
+    static constexpr int Lookahead = 4;
+
+    explicit TokenStream(TokenSource &source) : source(source) {}
+
+    const Token &peek(int ahead = 0); // ahead < Lookahead; empty UNKNOWN token past the end
+    void advance();
+    bool atEnd() { peek(); return count == 0; }
+    int position() const { return consumed; } // Index of the current token in the input
+
+private:
+    TokenSource &source;
+    Token ring[Lookahead];
+    int head = 0;     // Ring slot of the current token
+    int count = 0;    // Buffered tokens starting at head
+    int consumed = 0;
+    bool exhausted = false;
+};
+
+#endif // TOKENSTREAM_H
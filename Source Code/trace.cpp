@@ -0,0 +1,4 @@
+#include "trace.h"
+#include <QtGlobal>
+
+std::atomic<int> currentTraceLevel{qEnvironmentVariableIntValue("TINY_TRACE")};
@@ -0,0 +1,39 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <QDebug>
+#include <atomic>
+
+// How much the parser and the tools log through qDebug()
+enum class TraceLevel {
+    Off,
+    Phases,     // One line per pipeline phase, with its time
+    Statements, // Every statement linked into a sequence
+    Tokens      // Every token the parser matches
+};
+
+// Trace statements above TINY_TRACE_LEVEL are compiled out, arguments and
+// all; set it with DEFINES += TINY_TRACE_LEVEL=<n>. Release builds default to
+// 0, so hot paths carry no logging code at all.
+#ifndef TINY_TRACE_LEVEL
+#ifdef QT_NO_DEBUG
+#define TINY_TRACE_LEVEL 0
+#else
+#define TINY_TRACE_LEVEL 3
+#endif
+#endif
+
+// Level in effect at run time, up to the compiled-in maximum. Starts at the
+// TINY_TRACE environment variable (0 to 3), Off if it isn't set.
+extern std::atomic<int> currentTraceLevel;
+
+inline void setTraceLevel(TraceLevel level) { currentTraceLevel.store(int(level), std::memory_order_relaxed); }
+
+inline bool traceEnabled(TraceLevel level) {
+    return int(level) <= TINY_TRACE_LEVEL && int(level) <= currentTraceLevel.load(std::memory_order_relaxed);
+}
+
+// TINY_TRACE(TraceLevel::Tokens) << ...; evaluates nothing after it unless the level is enabled
+#define TINY_TRACE(level) if (!traceEnabled(level)) {} else qDebug()
+
+#endif // TRACE_H
@@ -0,0 +1,254 @@
+#include "treeexport.h"
+#include "astcache.h"
+#include "flatast.h"
+#include "treelayout.h"
+#include <QIODevice>
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <vector>
+
+namespace {
+
+constexpr qsizetype BufferSize = 1 << 16;
+constexpr qreal Margin = 10;    // Around the whole drawing, so edge strokes aren't cut
+
+// Collects output in one buffer and hands it to the device in large writes
+class ExportBuffer {
+public:
+    explicit ExportBuffer(QIODevice &device) : device(device) { buffer.reserve(BufferSize + 256); }
+
+    ExportBuffer &operator<<(const char *text) { buffer.append(text); return check(); }
+    ExportBuffer &operator<<(const QByteArray &bytes) { buffer.append(bytes); return check(); }
+    ExportBuffer &operator<<(char c) { buffer.append(c); return check(); }
+    ExportBuffer &operator<<(quint32 value) {
+        char digits[10];
+        auto result = std::to_chars(digits, digits + sizeof(digits), value);
+        buffer.append(digits, result.ptr - digits);
+        return check();
+    }
+    // Coordinates to a tenth of a unit, without a trailing ".0"
+    ExportBuffer &operator<<(qreal value) {
+        qreal tenths = std::round(value * 10);
+        char digits[32];
+        auto result = std::to_chars(digits, digits + sizeof(digits), tenths == 0 ? 0.0 : tenths / 10,
+                                    std::chars_format::fixed, 1);
+        qsizetype length = result.ptr - digits;
+        if (digits[length - 1] == '0') {
+            length -= 2;
+        }
+        buffer.append(digits, length);
+        return check();
+    }
+
+    bool finish() {
+        flush();
+        return ok;
+    }
+
+private:
+    ExportBuffer &check() {
+        if (buffer.size() >= BufferSize) {
+            flush();
+        }
+        return *this;
+    }
+    void flush() {
+        if (!buffer.isEmpty()) {
+            ok = device.write(buffer) == buffer.size() && ok;
+            buffer.resize(0); // Keeps the capacity
+        }
+    }
+
+    QIODevice &device;
+    QByteArray buffer;
+    bool ok = true;
+};
+
+// Display names are quoted in DOT and are character data in SVG
+QByteArray escaped(const QString &name, bool xml) {
+    QByteArray text = name.toUtf8();
+    QByteArray out;
+    out.reserve(text.size() + 8);
+    for (qsizetype i = 0; i < text.size(); ++i) {
+        char c = text[i];
+        if (xml && c == '&') {
+            out.append("&amp;");
+        } else if (xml && c == '<') {
+            out.append("&lt;");
+        } else if (xml && c == '>') {
+            out.append("&gt;");
+        } else if (!xml && (c == '"' || c == '\\')) {
+            out.append('\\');
+            out.append(c);
+        } else {
+            out.append(c);
+        }
+    }
+    return out;
+}
+
+// Same shape as dumpAstTree's walk; Tree needs node(index) and displayName(index)
+template <class Tree>
+bool writeDotTree(const Tree &tree, quint32 root, QIODevice &device) {
+    ExportBuffer out(device);
+    out << "digraph ast {\n"
+           "  node [fontname=\"Helvetica\", fontsize=12];\n";
+    std::vector<quint32> stack;
+    if (root != FlatAst::NoNode) {
+        stack.push_back(root);
+    }
+    while (!stack.empty()) {
+        quint32 index = stack.back();
+        stack.pop_back();
+        const AstNode &n = tree.node(index);
+        out << "  n" << index << " [label=\"" << escaped(tree.displayName(index), false)
+            << (isStatementKind(n.kind) ? "\", shape=box];\n" : "\", shape=ellipse];\n");
+
+        if (n.sibling != FlatAst::NoNode) {
+            out << "  { rank=same; n" << index << " -> n" << n.sibling << " [arrowhead=none]; }\n";
+            stack.push_back(n.sibling);
+        }
+        // Edges in child order, which Graphviz keeps left to right
+        for (quint32 c = 0; c < n.childCount; ++c) {
+            if (n.children[c] != FlatAst::NoNode) { // Sequences emptied by error recovery
+                out << "  n" << index << " -> n" << n.children[c] << ";\n";
+            }
+        }
+        for (quint32 c = n.childCount; c-- > 0;) {
+            if (n.children[c] != FlatAst::NoNode) {
+                stack.push_back(n.children[c]);
+            }
+        }
+    }
+    out << "}\n";
+    return out.finish();
+}
+
+// Everything drawn for placement i: its box, the edge up to its parent and the
+// link from the previous statement
+QRectF drawnExtent(const QList<TreeLayout::Placement> &placements, int i) {
+    const TreeLayout::Placement &p = placements[i];
+    QRectF extent(p.x - p.width / 2, p.y - p.height / 2, p.width, p.height);
+    if (p.parent >= 0) {
+        const TreeLayout::Placement &parent = placements[p.parent];
+        extent = extent.united(QRectF(QPointF(std::min(parent.x, p.x), parent.y + parent.height / 2),
+                                      QPointF(std::max(parent.x, p.x), p.y)));
+    }
+    if (p.previous >= 0) {
+        extent.setLeft(std::min(extent.left(), placements[p.previous].x));
+    }
+    return extent;
+}
+
+// Rows that can draw into the vertical range of area: a row's boxes reach at
+// most half a statement below it, and its edges up to the row above
+void rowsIn(const TreeLayout &layout, const QRectF &area, int &first, int &last) {
+    qreal rowHeight = layout.rowHeight();
+    first = std::max(0, int(std::ceil((area.top() - TreeLayout::StatementHeight / 2) / rowHeight)));
+    last = std::min(layout.rowCount() - 1, int(std::floor(area.bottom() / rowHeight)) + 1);
+}
+
+} // namespace
+
+bool parseTreeFormat(const QString &name, TreeFormat &format) {
+    if (name == "text") {
+        format = TreeFormat::Text;
+    } else if (name == "dot") {
+        format = TreeFormat::Dot;
+    } else if (name == "svg") {
+        format = TreeFormat::Svg;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+QString treeFormatSuffix(TreeFormat format) {
+    switch (format) {
+    case TreeFormat::Text: return ".ast.txt";
+    case TreeFormat::Dot: return ".ast.dot";
+    case TreeFormat::Svg: return ".ast.svg";
+    }
+    return QString();
+}
+
+bool writeDot(const FlatAst &ast, QIODevice &device) {
+    return writeDotTree(ast, ast.root, device);
+}
+
+bool writeDot(const AstImage &image, QIODevice &device) {
+    return writeDotTree(image, image.root(), device);
+}
+
+bool writeSvg(const TreeLayout &layout, const FlatAst &ast, QIODevice &device, const QRectF &area) {
+    QRectF view = area.isNull() ? layout.bounds().adjusted(-Margin, -Margin, Margin, Margin) : area;
+    ExportBuffer out(device);
+    out << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+        << "<svg xmlns=\"http://www.w3.org/2000/svg\" viewBox=\"" << view.x() << ' ' << view.y() << ' '
+        << view.width() << ' ' << view.height() << "\" width=\"" << view.width() << "\" height=\""
+        << view.height() << "\">\n"
+        << "<style>rect,circle{fill:none;stroke:#000}line{stroke:#000}"
+           "text{font:12px sans-serif;text-anchor:middle;dominant-baseline:central}</style>\n";
+
+    const QList<TreeLayout::Placement> &placements = layout.placements();
+    int first, last;
+    rowsIn(layout, view, first, last);
+    for (int row = first; row <= last; ++row) {
+        int begin, end;
+        layout.rowRange(row, view.left(), view.right(), begin, end);
+        for (int i = begin; i < end; ++i) {
+            const TreeLayout::Placement &p = placements[i];
+            if (ast.isStatement(p.index)) {
+                out << "<rect x=\"" << p.x - p.width / 2 << "\" y=\"" << p.y - p.height / 2 << "\" width=\""
+                    << p.width << "\" height=\"" << p.height << "\"/>\n";
+            } else {
+                out << "<circle cx=\"" << p.x << "\" cy=\"" << p.y << "\" r=\"" << p.width / 2 << "\"/>\n";
+            }
+            out << "<text x=\"" << p.x << "\" y=\"" << p.y << "\">" << escaped(ast.displayName(p.index), true) << "</text>\n";
+
+            // Edge down from the parent, and the link from the previous statement, as in the scene
+            if (p.parent >= 0) {
+                const TreeLayout::Placement &parent = placements[p.parent];
+                out << "<line x1=\"" << parent.x << "\" y1=\"" << parent.y + parent.height / 2 << "\" x2=\""
+                    << p.x << "\" y2=\"" << p.y - p.height / 2 << "\"/>\n";
+            }
+            if (p.previous >= 0) {
+                const TreeLayout::Placement &previous = placements[p.previous];
+                out << "<line x1=\"" << previous.x + previous.width / 2 << "\" y1=\"" << p.y << "\" x2=\""
+                    << p.x - p.width / 2 << "\" y2=\"" << p.y << "\"/>\n";
+            }
+        }
+    }
+    out << "</svg>\n";
+    return out.finish();
+}
+
+QList<QRectF> svgPages(const TreeLayout &layout, qreal pageWidth, qreal pageHeight) {
+    QList<QRectF> pages;
+    if (layout.placements().isEmpty() || pageWidth <= 0 || pageHeight <= 0) {
+        return pages;
+    }
+    QRectF drawing = layout.bounds().adjusted(-Margin, -Margin, Margin, Margin);
+    const QList<TreeLayout::Placement> &placements = layout.placements();
+    for (qreal top = drawing.top(); top < drawing.bottom(); top += pageHeight) {
+        for (qreal left = drawing.left(); left < drawing.right(); left += pageWidth) {
+            QRectF page(left, top, std::min(pageWidth, drawing.right() - left),
+                        std::min(pageHeight, drawing.bottom() - top));
+            int first, last;
+            rowsIn(layout, page, first, last);
+            bool used = false;
+            for (int row = first; row <= last && !used; ++row) {
+                int begin, end;
+                layout.rowRange(row, page.left(), page.right(), begin, end);
+                for (int i = begin; i < end && !used; ++i) {
+                    used = drawnExtent(placements, i).intersects(page);
+                }
+            }
+            if (used) {
+                pages.append(page);
+            }
+        }
+    }
+    return pages;
+}
@@ -0,0 +1,41 @@
+#ifndef TREEEXPORT_H
+#define TREEEXPORT_H
+
+#include <QList>
+#include <QRectF>
+#include <QString>
+
+class AstImage;
+class FlatAst;
+class QIODevice;
+class TreeLayout;
+
+// Output formats for parsed syntax trees
+enum class TreeFormat {
+    Text,   // Indented display names, as tinyc has always written
+    Dot,    // Graphviz digraph
+    Svg     // Drawn like the GUI scene, from a TreeLayout
+};
+
+bool parseTreeFormat(const QString &name, TreeFormat &format); // "text", "dot" or "svg"
+QString treeFormatSuffix(TreeFormat format);                   // e.g. ".ast.dot"
+
+// Stream a tree as Graphviz DOT in one pre-order walk over the flat nodes,
+// with no layout and no per-node state (the walk's stack only grows with the
+// nesting depth). Node n<i> is node i of the tree; statements are boxes,
+// expressions ellipses; each child sequence hangs from its parent by its first
+// statement, and statements of a sequence are chained on one rank.
+bool writeDot(const FlatAst &ast, QIODevice &device);
+bool writeDot(const AstImage &image, QIODevice &device);
+
+// Stream ast, laid out by TreeLayout::compute(ast, ...), or the part of it
+// inside area, as one SVG document. Only the position table and the nodes are
+// read; nothing is built per node, and a page only visits the rows and
+// placements it can show.
+bool writeSvg(const TreeLayout &layout, const FlatAst &ast, QIODevice &device, const QRectF &area = QRectF());
+
+// Cut the drawing into pages of at most pageWidth x pageHeight, row by row
+// from the top left, leaving out pages with nothing on them
+QList<QRectF> svgPages(const TreeLayout &layout, qreal pageWidth, qreal pageHeight);
+
+#endif // TREEEXPORT_H
@@ -0,0 +1,319 @@
+#include "treelayout.h"
+#include "flatast.h"
+#include "syntaxtree.h"
+#include <algorithm>
+#include <cmath>
+
+// Nodes are numbered breadth first, so every node's children are contiguous
+// and every descendant has a larger index than its ancestors: the bottom-up
+// pass is a reverse sweep and the top-down pass a forward one, with no
+// recursion however deep the tree is.
+
+namespace {
+
+// How number() reads each kind of tree: the GUI's display tree, and the flat
+// AST the SVG export lays out without building one
+struct DisplayTree {
+    using Node = const SyntaxTreeNode *;
+    static constexpr Node None = nullptr;
+
+    Node next(Node n) const { return n->sibling; }
+    bool isStatement(Node n) const { return isStatementKind(n->kind); }
+    bool hasChildren(Node n) const { return !n->children.isEmpty(); }
+    Node at(const TreeLayout::Placement &p) const { return p.node; }
+    void set(TreeLayout::Placement &p, Node n) const { p.node = n; p.index = FlatAst::NoNode; }
+    template <class F>
+    void forEachChild(Node n, F f) const {
+        for (const SyntaxTreeNode *child : n->children) {
+            f(child);
+        }
+    }
+};
+
+struct FlatTree {
+    using Node = quint32;
+    static constexpr Node None = FlatAst::NoNode;
+    const FlatAst &ast;
+
+    Node next(Node n) const { return ast.node(n).sibling; }
+    bool isStatement(Node n) const { return ast.isStatement(n); }
+    bool hasChildren(Node n) const {
+        bool any = false;
+        forEachChild(n, [&](Node) { any = true; });
+        return any;
+    }
+    Node at(const TreeLayout::Placement &p) const { return p.index; }
+    void set(TreeLayout::Placement &p, Node n) const { p.node = nullptr; p.index = n; }
+    template <class F>
+    void forEachChild(Node n, F f) const {
+        const AstNode &node = ast.node(n);
+        for (quint32 c = 0; c < node.childCount; ++c) {
+            if (node.children[c] != FlatAst::NoNode) { // Sequences emptied by error recovery
+                f(node.children[c]);
+            }
+        }
+    }
+};
+
+} // namespace
+
+void TreeLayout::clear() {
+    items.resize(0);
+    work.clear();
+    rowStarts.assign(1, 0);
+    extent = QRectF();
+}
+
+qsizetype TreeLayout::memoryUsage() const {
+    return items.capacity() * qsizetype(sizeof(Placement)) + qsizetype(work.capacity() * sizeof(Work)) +
+           qsizetype(rowStarts.capacity() * sizeof(int));
+}
+
+void TreeLayout::compute(const SyntaxTreeNode *root, qreal xSpacing, qreal ySpacing) {
+    clear();
+    gap = xSpacing;
+    rowSpacing = ySpacing;
+    if (root) {
+        number(DisplayTree(), root);
+        position();
+    }
+}
+
+void TreeLayout::compute(const FlatAst &ast, qreal xSpacing, qreal ySpacing) {
+    clear();
+    gap = xSpacing;
+    rowSpacing = ySpacing;
+    if (ast.root != FlatAst::NoNode) {
+        number(FlatTree{ast}, ast.root);
+        position();
+    }
+}
+
+// Number the nodes. A node's layout children are the statements of all of
+// its child sequences, in order; only each sequence's head gets an edge.
+template <class Tree>
+void TreeLayout::number(const Tree &tree, typename Tree::Node root) {
+    work.push_back(Work{-1, 0, 0, 0, -1, 0, 0, 0, 0, 0});
+    for (int i = 0; i < int(work.size()); ++i) {
+        int first = int(work.size());
+        work[i].firstChild = first;
+        qreal y = i == 0 ? 0 : items[i - 1].y + rowSpacing;
+
+        auto addSequence = [&](typename Tree::Node head, int edge) {
+            int previous = -1;
+            for (typename Tree::Node n = head; n != Tree::None; n = tree.next(n)) {
+                int index = int(work.size());
+                work.push_back(Work{i, 0, 0, index - first, -1, index, 0, 0, 0, 0});
+                bool statement = tree.isStatement(n);
+                qreal width = statement ? StatementWidth : ExpressionDiameter;
+                qreal height = statement ? StatementHeight : ExpressionDiameter;
+                items.append(Placement{nullptr, 0, y, width, height, previous < 0 ? edge : -1, previous,
+                                       0, 0, 0, 0, tree.hasChildren(n)});
+                tree.set(items.last(), n);
+                previous = index - 1;
+            }
+        };
+        if (i == 0) {
+            addSequence(root, -1);
+        } else {
+            tree.forEachChild(tree.at(items[i - 1]), [&](typename Tree::Node child) {
+                addSequence(child, i - 1);
+            });
+        }
+        work[i].childCount = int(work.size()) - first;
+    }
+}
+
+void TreeLayout::position() {
+    // First walk, bottom-up: place each node's children relative to one
+    // another, pushing subtrees apart along their contours, then centre the
+    // node over them. A node's prelim is provisional until its parent
+    // positions it next to its left sibling.
+    for (int v = int(work.size()) - 1; v >= 0; --v) {
+        Work &node = work[v];
+        if (node.childCount == 0) {
+            continue;
+        }
+        int first = node.firstChild;
+        int last = first + node.childCount - 1;
+        int defaultAncestor = first;
+        for (int w = first; w <= last; ++w) {
+            if (w > first) {
+                qreal prelim = work[w - 1].prelim + distance(w - 1, w);
+                if (work[w].childCount > 0) {
+                    work[w].mod = prelim - work[w].prelim;
+                }
+                work[w].prelim = prelim;
+            }
+            defaultAncestor = apportion(w, defaultAncestor);
+        }
+        executeShifts(v);
+        work[v].prelim = (work[first].prelim + work[last].prelim) / 2;
+    }
+
+    // Second walk, top-down: a node's x is its prelim plus the mods of all
+    // its ancestors
+    for (int v = 1; v < int(work.size()); ++v) {
+        int p = work[v].parent;
+        qreal parentX = p == 0 ? work[0].prelim : items[p - 1].x;
+        qreal modSum = parentX - work[p].prelim + work[p].mod;
+        Placement &placement = items[v - 1];
+        placement.x = work[v].prelim + modSum;
+
+        QRectF box(placement.x - placement.width / 2, placement.y - placement.height / 2,
+                   placement.width, placement.height);
+        extent = v == 1 ? box : extent.united(box);
+        placement.spanLeft = box.left();
+        placement.spanRight = box.right();
+        placement.spanBottom = box.bottom();
+
+        // Every row of the breadth-first order shares one y
+        if (v > 1 && placement.y != items[v - 2].y) {
+            rowStarts.push_back(v - 1);
+        }
+    }
+    rowStarts.push_back(int(items.size()));
+
+    // Subtree extents, bottom-up
+    for (int v = int(work.size()) - 1; v > 0; --v) {
+        int p = work[v].parent;
+        if (p > 0) {
+            const Placement &child = items[v - 1];
+            Placement &parent = items[p - 1];
+            parent.spanLeft = std::min(parent.spanLeft, child.spanLeft);
+            parent.spanRight = std::max(parent.spanRight, child.spanRight);
+            parent.spanBottom = std::max(parent.spanBottom, child.spanBottom);
+        }
+    }
+}
+
+int TreeLayout::rowAt(qreal y) const {
+    int row = int(std::floor(y / rowSpacing + 0.5));
+    return std::clamp(row, 0, std::max(0, rowCount() - 1));
+}
+
+qreal TreeLayout::parentX(int index) const {
+    int p = work[index + 1].parent;
+    return p > 0 ? items[p - 1].x : items[index].x;
+}
+
+void TreeLayout::rowRange(int row, qreal left, qreal right, int &begin, int &end) const {
+    // Boxes in a row don't overlap and edges between two rows don't cross, so
+    // both the right ends and the left ends of "box plus edge up" increase
+    // along the row
+    int first = rowBegin(row);
+    int last = rowEnd(row);
+    auto rightEnd = [&](int i) { return std::max(items[i].x + items[i].width / 2, parentX(i)); };
+    auto leftEnd = [&](int i) { return std::min(items[i].x - items[i].width / 2, parentX(i)); };
+
+    int lo = first, hi = last;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (rightEnd(mid) < left) lo = mid + 1; else hi = mid;
+    }
+    begin = lo;
+
+    hi = last;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (leftEnd(mid) <= right) lo = mid + 1; else hi = mid;
+    }
+
+    // One more for the link from the last visible statement to the next one
+    end = std::min(lo + 1, last);
+}
+
+int TreeLayout::firstAtOrAfter(int row, int from, qreal x) const {
+    auto it = std::lower_bound(items.begin() + from, items.begin() + rowEnd(row), x,
+                               [](const Placement &p, qreal value) { return p.x < value; });
+    return int(it - items.begin());
+}
+
+int TreeLayout::nextLeft(int v) const {
+    return work[v].childCount > 0 ? work[v].firstChild : work[v].thread;
+}
+
+int TreeLayout::nextRight(int v) const {
+    return work[v].childCount > 0 ? work[v].firstChild + work[v].childCount - 1 : work[v].thread;
+}
+
+// Smallest centre-to-centre distance between two nodes on the same row
+qreal TreeLayout::distance(int left, int right) const {
+    return (items[left - 1].width + items[right - 1].width) / 2 + gap;
+}
+
+// Walk the right contour of the subtrees left of v against v's left contour
+// and shift v's subtree right wherever they come too close
+int TreeLayout::apportion(int v, int defaultAncestor) {
+    if (work[v].number == 0) {
+        return defaultAncestor;
+    }
+
+    int innerRight = v;
+    int outerRight = v;
+    int innerLeft = v - 1;
+    int outerLeft = work[work[v].parent].firstChild;
+    qreal sumInnerRight = work[innerRight].mod;
+    qreal sumOuterRight = work[outerRight].mod;
+    qreal sumInnerLeft = work[innerLeft].mod;
+    qreal sumOuterLeft = work[outerLeft].mod;
+
+    while (nextRight(innerLeft) >= 0 && nextLeft(innerRight) >= 0) {
+        innerLeft = nextRight(innerLeft);
+        innerRight = nextLeft(innerRight);
+        outerLeft = nextLeft(outerLeft);
+        outerRight = nextRight(outerRight);
+        work[outerRight].ancestor = v;
+
+        qreal shift = (work[innerLeft].prelim + sumInnerLeft) - (work[innerRight].prelim + sumInnerRight)
+                      + distance(innerLeft, innerRight);
+        if (shift > 0) {
+            int ancestor = work[innerLeft].ancestor;
+            if (work[ancestor].parent != work[v].parent) {
+                ancestor = defaultAncestor;
+            }
+            moveSubtree(ancestor, v, shift);
+            sumInnerRight += shift;
+            sumOuterRight += shift;
+        }
+        sumInnerLeft += work[innerLeft].mod;
+        sumInnerRight += work[innerRight].mod;
+        sumOuterLeft += work[outerLeft].mod;
+        sumOuterRight += work[outerRight].mod;
+    }
+
+    // Thread the shorter contour onto the longer one so later walks stay linear
+    if (nextRight(innerLeft) >= 0 && nextRight(outerRight) < 0) {
+        work[outerRight].thread = nextRight(innerLeft);
+        work[outerRight].mod += sumInnerLeft - sumOuterRight;
+    }
+    if (nextLeft(innerRight) >= 0 && nextLeft(outerLeft) < 0) {
+        work[outerLeft].thread = nextLeft(innerRight);
+        work[outerLeft].mod += sumInnerRight - sumOuterLeft;
+        defaultAncestor = v;
+    }
+    return defaultAncestor;
+}
+
+// Shift right's subtree, spreading the move over the siblings in between
+// (applied later by executeShifts)
+void TreeLayout::moveSubtree(int left, int right, qreal shift) {
+    qreal subtrees = work[right].number - work[left].number;
+    work[right].change -= shift / subtrees;
+    work[right].shift += shift;
+    work[left].change += shift / subtrees;
+    work[right].prelim += shift;
+    work[right].mod += shift;
+}
+
+void TreeLayout::executeShifts(int v) {
+    qreal shift = 0;
+    qreal change = 0;
+    int first = work[v].firstChild;
+    for (int w = first + work[v].childCount - 1; w >= first; --w) {
+        work[w].prelim += shift;
+        work[w].mod += shift;
+        change += work[w].change;
+        shift += work[w].shift + change;
+    }
+}
@@ -0,0 +1,102 @@
+#ifndef TREELAYOUT_H
+#define TREELAYOUT_H
+
+#include <QList>
+#include <QRectF>
+#include <vector>
+
+class FlatAst;
+class SyntaxTreeNode;
+
+// Computes scene coordinates for every node of a display tree in O(n)
+// (Walker's algorithm with Buchheim's linear-time refinements), so drawing
+// never has to measure subtrees. Children hang below their parent; the
+// statements of a sequence sit side by side on one row, linked left to right.
+class TreeLayout {
+public:
+    // Node sizes the renderer draws with; the layout keeps their boxes apart
+    static constexpr qreal StatementWidth = 80;   // Rectangles
+    static constexpr qreal StatementHeight = 40;
+    static constexpr qreal ExpressionDiameter = 40; // Circles
+
+    // Spacing the GUI and the SVG export lay trees out with
+    static constexpr qreal DefaultXSpacing = 20;
+    static constexpr qreal DefaultYSpacing = 60;
+
+    // One laid-out node. Entries are ordered row by row, and left to right
+    // within a row, so parents always come before their children.
+    struct Placement {
+        const SyntaxTreeNode *node; // Null when laid out from a FlatAst
+        qreal x, y;         // Centre of the node
+        qreal width, height;
+        int parent;         // Entry drawn with an edge down to this one, -1 if none
+        int previous;       // Previous statement in the same sequence, -1 if none
+        qreal spanLeft, spanRight, spanBottom; // Extent of the node and everything below it
+        quint32 index;      // Node in the FlatAst, when laid out from one
+        bool hasChildren;
+    };
+
+    // Lay out the sequence starting at root. xSpacing is the smallest gap
+    // between neighbouring boxes on a row, ySpacing the distance between rows.
+    void compute(const SyntaxTreeNode *root, qreal xSpacing, qreal ySpacing);
+    // Same layout straight from the flat nodes, without building a display tree
+    void compute(const FlatAst &ast, qreal xSpacing, qreal ySpacing);
+    void clear();
+    qsizetype memoryUsage() const; // Bytes held by the table and the reused working state
+
+    const QList<Placement> &placements() const { return items; }
+    QRectF bounds() const { return extent; }   // Union of every node's box
+
+    // Spatial lookup for drawing only what is visible. Rows are ySpacing apart
+    // starting at y = 0; each row is a contiguous run of placements.
+    int rowCount() const { return int(rowStarts.size()) - 1; }
+    int rowBegin(int row) const { return rowStarts[row]; }
+    int rowEnd(int row) const { return rowStarts[row + 1]; }
+    int rowAt(qreal y) const;   // Nearest row, clamped to the valid range
+    qreal rowHeight() const { return rowSpacing; }
+
+    // Entries [begin, end) of a row whose box, edge up to the parent or link to
+    // the previous statement may reach into the x range [left, right]. O(log n).
+    void rowRange(int row, qreal left, qreal right, int &begin, int &end) const;
+
+    // First entry in [from, rowEnd(row)) whose centre is at or right of x
+    int firstAtOrAfter(int row, int from, qreal x) const;
+
+private:
+    // Per-node working state of the algorithm. Index 0 is a virtual root that
+    // owns the top-level sequence; index i + 1 belongs to items[i].
+    struct Work {
+        int parent;
+        int firstChild;
+        int childCount;
+        int number;         // Position among the parent's children
+        int thread;
+        int ancestor;
+        qreal prelim;
+        qreal mod;
+        qreal change;
+        qreal shift;
+    };
+
+    template <class Tree>
+    void number(const Tree &tree, typename Tree::Node root);
+    void position();
+
+    int nextLeft(int v) const;
+    int nextRight(int v) const;
+    qreal distance(int left, int right) const;
+    int apportion(int v, int defaultAncestor);
+    void moveSubtree(int left, int right, qreal shift);
+    void executeShifts(int v);
+
+    qreal parentX(int index) const;  // Centre of the node above, or its own for the top row
+
+    QList<Placement> items;
+    std::vector<Work> work;     // Reused between layouts
+    std::vector<int> rowStarts{0};
+    qreal gap = 0;
+    qreal rowSpacing = 1;
+    QRectF extent;
+};
+
+#endif // TREELAYOUT_H
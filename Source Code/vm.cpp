@@ -0,0 +1,222 @@
+#include "vm.h"
+#include <QTextStream>
+#include <stdexcept>
+
+#if defined(__GNUC__) || defined(__clang__)
+#define TINY_THREADED_DISPATCH 1
+#endif
+
+qint64 StreamIo::read() {
+    qint64 value;
+    in >> value;
+    if (in.status() != QTextStream::Ok) {
+        throw std::runtime_error("read: no more input");
+    }
+    return value;
+}
+
+void StreamIo::write(qint64 value) {
+    out << value << '\n';
+}
+
+qint64 ListIo::read() {
+    if (next >= input.size()) {
+        throw std::runtime_error("read: no more input");
+    }
+    return input[next++];
+}
+
+namespace {
+
+[[noreturn]] void divisionByZero() {
+    throw std::runtime_error("Division by zero");
+}
+
+} // namespace
+
+void VirtualMachine::run(const BytecodeProgram &program, ProgramIo &io) {
+    frame.assign(program.frameSize, 0);
+    std::copy(program.constants.begin(), program.constants.end(), frame.begin() + program.constantBase);
+    qint64 *slot = frame.data();
+
+#ifdef TINY_THREADED_DISPATCH
+    // Indexed by Opcode
+    static const void *const handlers[] = {
+        &&op_add, &&op_sub, &&op_mul, &&op_div, &&op_less, &&op_equal, &&op_move,
+        &&op_read, &&op_write, &&op_jump, &&op_jz, &&op_jnlt, &&op_jneq, &&op_halt
+    };
+
+    threaded.resize(program.code.size());
+    for (qsizetype i = 0; i < program.code.size(); ++i) {
+        const Instruction &in = program.code[i];
+        threaded[i] = Threaded{handlers[int(in.op)], in.a, in.b, in.c};
+    }
+    const Threaded *base = threaded.data();
+    const Threaded *ip = base;
+
+#define DISPATCH() goto *ip->handler
+#define NEXT() do { ++ip; DISPATCH(); } while (0)
+
+    DISPATCH();
+op_add:   slot[ip->a] = wrappingAdd(slot[ip->b], slot[ip->c]); NEXT();
+op_sub:   slot[ip->a] = wrappingSub(slot[ip->b], slot[ip->c]); NEXT();
+op_mul:   slot[ip->a] = wrappingMul(slot[ip->b], slot[ip->c]); NEXT();
+op_div:
+    if (slot[ip->c] == 0) {
+        divisionByZero();
+    }
+    slot[ip->a] = wrappingDiv(slot[ip->b], slot[ip->c]);
+    NEXT();
+op_less:  slot[ip->a] = slot[ip->b] < slot[ip->c]; NEXT();
+op_equal: slot[ip->a] = slot[ip->b] == slot[ip->c]; NEXT();
+op_move:  slot[ip->a] = slot[ip->b]; NEXT();
+op_read:  slot[ip->a] = io.read(); NEXT();
+op_write: io.write(slot[ip->a]); NEXT();
+op_jump:  ip = base + ip->a; DISPATCH();
+op_jz:    ip = slot[ip->a] == 0 ? base + ip->b : ip + 1; DISPATCH();
+op_jnlt:  ip = !(slot[ip->a] < slot[ip->b]) ? base + ip->c : ip + 1; DISPATCH();
+op_jneq:  ip = slot[ip->a] != slot[ip->b] ? base + ip->c : ip + 1; DISPATCH();
+op_halt:  return;
+
+#undef NEXT
+#undef DISPATCH
+#else
+    const Instruction *base = program.code.constData();
+    const Instruction *ip = base;
+    while (true) {
+        switch (ip->op) {
+        case Opcode::Add: slot[ip->a] = wrappingAdd(slot[ip->b], slot[ip->c]); break;
+        case Opcode::Sub: slot[ip->a] = wrappingSub(slot[ip->b], slot[ip->c]); break;
+        case Opcode::Mul: slot[ip->a] = wrappingMul(slot[ip->b], slot[ip->c]); break;
+        case Opcode::Div:
+            if (slot[ip->c] == 0) {
+                divisionByZero();
+            }
+            slot[ip->a] = wrappingDiv(slot[ip->b], slot[ip->c]);
+            break;
+        case Opcode::Less: slot[ip->a] = slot[ip->b] < slot[ip->c]; break;
+        case Opcode::Equal: slot[ip->a] = slot[ip->b] == slot[ip->c]; break;
+        case Opcode::Move: slot[ip->a] = slot[ip->b]; break;
+        case Opcode::Read: slot[ip->a] = io.read(); break;
+        case Opcode::Write: io.write(slot[ip->a]); break;
+        case Opcode::Jump: ip = base + ip->a; continue;
+        case Opcode::JumpIfZero: ip = slot[ip->a] == 0 ? base + ip->b : ip + 1; continue;
+        case Opcode::JumpUnlessLess: ip = !(slot[ip->a] < slot[ip->b]) ? base + ip->c : ip + 1; continue;
+        case Opcode::JumpUnlessEqual: ip = slot[ip->a] != slot[ip->b] ? base + ip->c : ip + 1; continue;
+        case Opcode::Halt: return;
+        }
+        ++ip;
+    }
+#endif
+}
+
+void TreeInterpreter::run(const FlatAst &tree, ProgramIo &programIo) {
+    ast = &tree;
+    io = &programIo;
+    variables.assign(tree.identifiers.size(), 0);
+    statements.clear();     // A failed run may have left work behind
+    sequence(tree.root);
+}
+
+// Runs off a stack of continuations, so deeply nested ifs and repeats can't
+// exhaust the stack: the rest of each enclosing sequence, and the condition
+// of each repeat being run
+void TreeInterpreter::sequence(quint32 index) {
+    statements.push_back({index, false});
+    while (!statements.empty()) {
+        Continuation next = statements.back();
+        statements.pop_back();
+        if (next.index == FlatAst::NoNode) {
+            continue;
+        }
+        const AstNode &n = ast->node(next.index);
+        if (next.repeatCondition) {
+            if (evaluate(n.children[1]) == 0) {
+                statements.push_back({next.index, true});
+                statements.push_back({n.children[0], false});
+            }
+            continue;
+        }
+
+        statements.push_back({n.sibling, false});
+        switch (n.kind) {
+        case NodeKind::Assign:
+            variables[n.payload] = evaluate(n.children[0]);
+            break;
+        case NodeKind::Read:
+            variables[n.payload] = io->read();
+            break;
+        case NodeKind::Write:
+            io->write(evaluate(n.children[0]));
+            break;
+        case NodeKind::If:
+            if (evaluate(n.children[0]) != 0) {
+                statements.push_back({n.childCount > 1 ? n.children[1] : FlatAst::NoNode, false});
+            } else if (n.childCount > 2) {
+                statements.push_back({n.children[2], false});
+            }
+            break;
+        case NodeKind::Repeat:
+            statements.push_back({next.index, true});
+            statements.push_back({n.children[0], false});
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+// Post-order with an explicit stack, so long operator chains can't exhaust the stack
+qint64 TreeInterpreter::evaluate(quint32 index) {
+    pending.push_back({index, false});
+    while (!pending.empty()) {
+        Pending &item = pending.back();
+        const AstNode &n = ast->node(item.index);
+        if (n.kind == NodeKind::Id) {
+            values.push_back(variables[n.payload]);
+            pending.pop_back();
+            continue;
+        }
+        if (n.kind == NodeKind::Const) {
+            bool ok = false;
+            values.push_back(ast->constantValue(item.index, &ok));
+            pending.pop_back();
+            if (!ok) {
+                pending.clear();
+                values.clear();
+                QString errorMsg = QString("Constant out of range: '%1'").arg(ast->literals.text(n.payload));
+                throw std::runtime_error(errorMsg.toStdString());
+            }
+            continue;
+        }
+        if (!item.expanded) {
+            item.expanded = true;
+            pending.push_back({n.children[1], false});
+            pending.push_back({n.children[0], false});
+            continue;
+        }
+        pending.pop_back();
+
+        qint64 right = values.back();
+        values.pop_back();
+        qint64 &left = values.back(); // Replaced by the result
+        switch (n.op) {
+        case TokenType::PLUS: left = wrappingAdd(left, right); break;
+        case TokenType::MINUS: left = wrappingSub(left, right); break;
+        case TokenType::MULT: left = wrappingMul(left, right); break;
+        case TokenType::DIV:
+            if (right == 0) {
+                pending.clear();
+                values.clear();
+                divisionByZero();
+            }
+            left = wrappingDiv(left, right);
+            break;
+        case TokenType::LESSTHAN: left = left < right; break;
+        default: left = left == right; break;
+        }
+    }
+    qint64 result = values.back();
+    values.pop_back();
+    return result;
+}
@@ -0,0 +1,98 @@
+#ifndef VM_H
+#define VM_H
+
+#include "bytecode.h"
+#include <QList>
+#include <vector>
+
+class QTextStream;
+
+// Where read takes its numbers from and where write sends them
+class ProgramIo {
+public:
+    virtual ~ProgramIo() = default;
+    virtual qint64 read() = 0;          // Throws std::runtime_error when input runs out
+    virtual void write(qint64 value) = 0;
+};
+
+// Reads whitespace-separated integers from one stream, writes one per line to another
+class StreamIo : public ProgramIo {
+public:
+    StreamIo(QTextStream &in, QTextStream &out) : in(in), out(out) {}
+    qint64 read() override;
+    void write(qint64 value) override;
+
+private:
+    QTextStream &in;
+    QTextStream &out;
+};
+
+// Fixed input list; output is collected (used by tests and benchmarks)
+class ListIo : public ProgramIo {
+public:
+    explicit ListIo(const QList<qint64> &input) : input(input) {}
+    qint64 read() override;
+    void write(qint64 value) override { output.append(value); }
+
+    QList<qint64> output;
+
+private:
+    QList<qint64> input;
+    qsizetype next = 0;
+};
+
+// Executes bytecode with threaded dispatch: the program is first translated
+// into handler addresses (computed goto), so each instruction ends in its
+// own indirect jump to the next handler. Falls back to a switch loop on
+// compilers without labels-as-values. The machine keeps its frame between
+// runs, so repeated runs don't allocate.
+class VirtualMachine {
+public:
+    // Runs to completion; throws std::runtime_error on division by zero or missing input
+    void run(const BytecodeProgram &program, ProgramIo &io);
+
+    qint64 variable(quint32 id) const { return frame[id]; } // After run()
+
+private:
+    struct Threaded {
+        const void *handler;
+        quint32 a, b, c;
+    };
+
+    std::vector<qint64> frame;
+    std::vector<Threaded> threaded;
+};
+
+// Reference interpreter that evaluates the flat AST directly, walking
+// statements and expressions with explicit stacks. Same semantics as the VM;
+// kept simple as a baseline for benchmarks and cross-checks.
+class TreeInterpreter {
+public:
+    void run(const FlatAst &ast, ProgramIo &io);
+    qint64 variable(quint32 id) const { return variables[id]; }
+
+private:
+    void sequence(quint32 index);
+    qint64 evaluate(quint32 index);
+
+    const FlatAst *ast = nullptr;
+    ProgramIo *io = nullptr;
+    std::vector<qint64> variables;
+
+    // Work stack of sequence()
+    struct Continuation {
+        quint32 index;          // First statement of a sequence still to run ...
+        bool repeatCondition;   // ... or the repeat whose condition is next
+    };
+    std::vector<Continuation> statements;
+
+    // Working stacks of evaluate(), reused between expressions
+    struct Pending {
+        quint32 index;
+        bool expanded;      // Operands already pushed
+    };
+    std::vector<Pending> pending;
+    std::vector<qint64> values;     // Operands evaluated so far
+};
+
+#endif // VM_H